@@ -0,0 +1,399 @@
+//---------------------------------------------------------------------------------------
+// Intersection kernels over seeded workload classes.
+//
+//     Benchmark [--seed N] [--repeats N] [--sizes N,N,...] [--workloads name,...]
+//               [--kernels scalar,exact,result,batch,mixed] [--precision float|double]
+//               [--json file]
+//
+// Every sample runs a kernel over the whole pair array (several times for
+// small arrays), percentiles are taken over the samples' ns per pair.
+// The JSON output is stable in layout and order, so two runs can be diffed.
+// The mixed kernel exists for double only; its fallback column is the share
+// of pairs recomputed in double.
+//---------------------------------------------------------------------------------------
+#include "Workload.h"
+#include "Segment3.h"
+#include "Segment3Batch.h"
+#include "Segment3Mixed.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+struct Options
+{
+    std::uint64_t            Seed    = 12345;
+    std::size_t              Repeats = 11;
+    std::vector<std::size_t> Sizes   = { 1 << 10, 1 << 14, 1 << 18, 1 << 21 };
+    std::vector<Workload>    Workloads;
+    std::vector<std::string> Kernels = { "scalar", "exact", "result", "batch", "mixed" };
+    bool                     Float   = true;
+    bool                     Double  = true;
+    std::string              Json;
+};
+
+//---------------------------------------------------------------------------------------
+struct Result
+{
+    const char* Workload       = nullptr;
+    const char* Precision      = nullptr;
+    std::string Kernel;
+    std::size_t Size           = 0;
+    std::size_t Hits           = 0;
+    double      Fallback       = 0;
+    double      Min            = 0;
+    double      P50            = 0;
+    double      P90            = 0;
+    double      P99            = 0;
+    double      Max            = 0;
+    double      PairsPerSecond = 0;
+};
+
+//---------------------------------------------------------------------------------------
+// Every sample covers at least this many pairs, so clock resolution does not
+// matter for cache-resident sizes
+constexpr std::size_t SamplePairs = 1 << 18;
+
+//---------------------------------------------------------------------------------------
+static std::vector<std::string> Split
+(
+    const std::string& list
+)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+        if (!item.empty())
+            items.push_back(item);
+
+    return items;
+}
+
+//---------------------------------------------------------------------------------------
+static double Percentile
+(
+    const std::vector<double>& sorted,
+    double fraction
+)
+{
+    const double position = fraction * (sorted.size() - 1);
+    const std::size_t low = static_cast<std::size_t>(position);
+    const std::size_t high = std::min(low + 1, sorted.size() - 1);
+
+    return sorted[low] + (sorted[high] - sorted[low]) * (position - low);
+}
+
+//---------------------------------------------------------------------------------------
+// Runs kernel() samples times and fills the timing part of the result
+template<typename TKernel>
+static void Measure
+(
+    Result& result,
+    std::size_t repeats,
+    TKernel&& kernel
+)
+{
+    const std::size_t passes = std::max<std::size_t>(1, SamplePairs / result.Size);
+
+    // Warm-up, also faults the result pages in
+    kernel();
+
+    std::vector<double> samples;
+    for (std::size_t sample = 0; sample < repeats; ++sample)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t pass = 0; pass < passes; ++pass)
+            kernel();
+
+        const std::chrono::duration<double, std::nano> duration =
+            std::chrono::steady_clock::now() - start;
+
+        samples.push_back(duration.count() / (passes * result.Size));
+    }
+
+    std::sort(samples.begin(), samples.end());
+    result.Min = samples.front();
+    result.P50 = Percentile(samples, 0.5);
+    result.P90 = Percentile(samples, 0.9);
+    result.P99 = Percentile(samples, 0.99);
+    result.Max = samples.back();
+    result.PairsPerSecond = 1e9 / result.P50;
+}
+
+//---------------------------------------------------------------------------------------
+// Mixed precision takes double segments, float runs skip it
+static bool MeasureMixed
+(
+    Result& result,
+    std::size_t repeats,
+    const std::vector<Segment3<double>>& first,
+    const std::vector<Segment3<double>>& second,
+    std::size_t& hits
+)
+{
+    const std::size_t size = result.Size;
+
+    Segment3MixedBatch   mixedFirst (first .data(), size);
+    Segment3MixedBatch   mixedSecond(second.data(), size);
+    Vector3Batch<double> points(size);
+    std::size_t          fallbacks = 0;
+
+    Measure(result, repeats, [&] {
+        fallbacks = mixedFirst.Intersection(mixedSecond, points);
+    });
+
+    for (std::size_t i = 0; i < size; ++i)
+        hits += points.Get(i).IsValid();
+
+    result.Fallback = static_cast<double>(fallbacks) / size;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+static bool MeasureMixed
+(
+    Result&,
+    std::size_t,
+    const std::vector<Segment3<float>>&,
+    const std::vector<Segment3<float>>&,
+    std::size_t&
+)
+{
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+static void Run
+(
+    const Options& options,
+    const char* precision,
+    std::vector<Result>& results
+)
+{
+    std::vector<Segment3<TFloat>> first;
+    std::vector<Segment3<TFloat>> second;
+    std::vector<Vector3<TFloat>>  points;
+    std::vector<Segment3Result<TFloat>> outcomes;
+
+    for (Workload workload : options.Workloads)
+        for (std::size_t size : options.Sizes)
+        {
+            GenerateWorkload(workload, size, options.Seed, first, second);
+            points.resize(size);
+            outcomes.resize(size);
+
+            Segment3Batch<TFloat> batchFirst (first .data(), size);
+            Segment3Batch<TFloat> batchSecond(second.data(), size);
+            Vector3Batch<TFloat>  batchPoints(size);
+
+            for (const std::string& kernel : options.Kernels)
+            {
+                Result result = { WorkloadName(workload), precision, kernel, size };
+                std::size_t hits = 0;
+
+                if (kernel == "scalar")
+                {
+                    Measure(result, options.Repeats, [&] {
+                        for (std::size_t i = 0; i < size; ++i)
+                            points[i] = first[i].Intersection(second[i]);
+                    });
+
+                    for (const Vector3<TFloat>& point : points)
+                        hits += point.IsValid();
+                }
+                else if (kernel == "exact")
+                {
+                    Measure(result, options.Repeats, [&] {
+                        for (std::size_t i = 0; i < size; ++i)
+                            points[i] = first[i].IntersectionExact(second[i]);
+                    });
+
+                    for (const Vector3<TFloat>& point : points)
+                        hits += point.IsValid();
+                }
+                else if (kernel == "result")
+                {
+                    Measure(result, options.Repeats, [&] {
+                        for (std::size_t i = 0; i < size; ++i)
+                            outcomes[i] = first[i].IntersectionResult(second[i]);
+                    });
+
+                    for (const Segment3Result<TFloat>& outcome : outcomes)
+                        hits += outcome.IsHit();
+                }
+                else if (kernel == "batch")
+                {
+                    Measure(result, options.Repeats, [&] {
+                        batchFirst.Intersection(batchSecond, batchPoints);
+                    });
+
+                    for (std::size_t i = 0; i < size; ++i)
+                        hits += batchPoints.Get(i).IsValid();
+                }
+                else if (kernel == "mixed")
+                {
+                    if (!MeasureMixed(result, options.Repeats, first, second, hits))
+                        continue;
+                }
+
+                result.Hits = hits;
+                results.push_back(result);
+
+                std::cout << std::left
+                          << std::setw(13) << result.Workload
+                          << std::setw(7)  << result.Precision
+                          << std::setw(11) << result.Kernel
+                          << std::right
+                          << std::setw(9)  << result.Size
+                          << std::setw(9)  << result.Hits
+                          << std::fixed << std::setprecision(2)
+                          << std::setw(9)  << result.Min
+                          << std::setw(9)  << result.P50
+                          << std::setw(9)  << result.P90
+                          << std::setw(9)  << result.P99
+                          << std::setw(10) << result.PairsPerSecond / 1e6
+                          << std::setw(9)  << result.Fallback * 100
+                          << '\n';
+            }
+        }
+}
+
+//---------------------------------------------------------------------------------------
+static void WriteJson
+(
+    const Options& options,
+    const std::vector<Result>& results,
+    std::ostream& out
+)
+{
+    out << std::setprecision(6)
+        << "{\n"
+        << "  \"seed\": " << options.Seed << ",\n"
+        << "  \"repeats\": " << options.Repeats << ",\n"
+        << "  \"results\": [\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        out << "    { "
+            << "\"workload\": \"" << result.Workload << "\", "
+            << "\"precision\": \"" << result.Precision << "\", "
+            << "\"kernel\": \"" << result.Kernel << "\", "
+            << "\"size\": " << result.Size << ", "
+            << "\"hits\": " << result.Hits << ", "
+            << "\"fallback\": " << result.Fallback << ", "
+            << "\"ns_per_pair\": { "
+            << "\"min\": " << result.Min << ", "
+            << "\"p50\": " << result.P50 << ", "
+            << "\"p90\": " << result.P90 << ", "
+            << "\"p99\": " << result.P99 << ", "
+            << "\"max\": " << result.Max << " }, "
+            << "\"pairs_per_second\": " << result.PairsPerSecond
+            << " }" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+
+    out << "  ]\n"
+        << "}\n";
+}
+
+//---------------------------------------------------------------------------------------
+static bool Parse
+(
+    int argc,
+    char* argv[],
+    Options& options
+)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+
+        const std::string value = argv[++i];
+
+        if (arg == "--seed")
+            options.Seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--repeats")
+            options.Repeats = std::max<std::size_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+        else if (arg == "--json")
+            options.Json = value;
+        else if (arg == "--kernels")
+            options.Kernels = Split(value);
+        else if (arg == "--precision") {
+            options.Float  = value == "float";
+            options.Double = value == "double";
+        }
+        else if (arg == "--sizes") {
+            options.Sizes.clear();
+            for (const std::string& size : Split(value))
+                options.Sizes.push_back(std::max<std::size_t>(1, std::strtoull(size.c_str(), nullptr, 10)));
+        }
+        else if (arg == "--workloads") {
+            for (const std::string& name : Split(value)) {
+                std::size_t index = 0;
+                while (index < WorkloadCount && name != WorkloadName(static_cast<Workload>(index)))
+                    ++index;
+                if (index == WorkloadCount)
+                    return false;
+                options.Workloads.push_back(static_cast<Workload>(index));
+            }
+        }
+        else
+            return false;
+    }
+
+    if (options.Workloads.empty())
+        for (std::size_t index = 0; index < WorkloadCount; ++index)
+            options.Workloads.push_back(static_cast<Workload>(index));
+
+    return options.Float || options.Double;
+}
+
+//---------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!Parse(argc, argv, options)) {
+        std::cerr << "Usage: Benchmark [--seed N] [--repeats N] [--sizes N,N,...]\n"
+                     "                 [--workloads disjoint,skew,parallel,collinear,point,axis-aligned,intersecting,mixed]\n"
+                     "                 [--kernels scalar,exact,result,batch,mixed] [--precision float|double]\n"
+                     "                 [--json file]\n";
+        return 1;
+    }
+
+    std::cout << std::left
+              << std::setw(13) << "workload"
+              << std::setw(7)  << "type"
+              << std::setw(11) << "kernel"
+              << std::right
+              << std::setw(9)  << "size"
+              << std::setw(9)  << "hits"
+              << std::setw(9)  << "min ns"
+              << std::setw(9)  << "p50 ns"
+              << std::setw(9)  << "p90 ns"
+              << std::setw(9)  << "p99 ns"
+              << std::setw(10) << "Mpairs/s"
+              << std::setw(9)  << "fallb %"
+              << '\n';
+
+    std::vector<Result> results;
+    if (options.Float)
+        Run<float>(options, "float", results);
+    if (options.Double)
+        Run<double>(options, "double", results);
+
+    if (!options.Json.empty()) {
+        std::ofstream file(options.Json);
+        WriteJson(options, results, file);
+    }
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include "Segment3.h"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Classes of segment pairs, each one mostly exercising a single branch of
+// Segment3::Intersection
+enum class Workload
+{
+    Disjoint,     // bounding boxes do not overlap
+    Skew,         // boxes overlap, lines are skew
+    Parallel,     // boxes overlap, lines are parallel
+    Collinear,    // same line, overlapping
+    Point,        // one of the segments is a point on the other one
+    AxisAligned,  // crossing segments parallel to coordinate axes
+    Intersecting, // crossing segments in general position
+    Mixed,        // every pair of a random one of the classes above
+};
+
+constexpr std::size_t WorkloadCount = 8;
+
+//---------------------------------------------------------------------------------------
+const char* WorkloadName(Workload workload);
+
+//---------------------------------------------------------------------------------------
+// Fills first and second with count pairs of the given class. The same seed
+// always gives the same pairs, for float and double alike.
+template<typename TFloat>
+void GenerateWorkload(
+    Workload workload,
+    std::size_t count,
+    std::uint64_t seed,
+    std::vector<Segment3<TFloat>>& first,
+    std::vector<Segment3<TFloat>>& second
+);
+
+//---------------------------------------------------------------------------------------
+inline const char* WorkloadName
+(
+    Workload workload
+)
+{
+    switch (workload)
+    {
+    case Workload::Disjoint:     return "disjoint";
+    case Workload::Skew:         return "skew";
+    case Workload::Parallel:     return "parallel";
+    case Workload::Collinear:    return "collinear";
+    case Workload::Point:        return "point";
+    case Workload::AxisAligned:  return "axis-aligned";
+    case Workload::Intersecting: return "intersecting";
+    case Workload::Mixed:        return "mixed";
+    }
+
+    return "";
+}
+
+//---------------------------------------------------------------------------------------
+// Coordinates are generated in double and rounded once, so both precisions
+// see the same geometry. Points lie in [0, 1)^3, direction halves in [0.05, 0.25).
+template<typename TFloat>
+inline void GenerateWorkload
+(
+    Workload workload,
+    std::size_t count,
+    std::uint64_t seed,
+    std::vector<Segment3<TFloat>>& first,
+    std::vector<Segment3<TFloat>>& second
+)
+{
+    std::mt19937_64 engine(seed ^ (static_cast<std::uint64_t>(workload) << 56));
+    std::uniform_real_distribution<double> unit(0., 1.);
+    std::uniform_real_distribution<double> length(0.05, 0.25);
+    std::uniform_int_distribution<int>     axis(0, 2);
+    std::uniform_int_distribution<int>     kind(0, static_cast<int>(Workload::Mixed) - 1);
+
+    auto point = [&]() {
+        return Vector3D(unit(engine), unit(engine), unit(engine));
+    };
+    auto direction = [&]() {
+        Vector3D v;
+        do
+            v = Vector3D(unit(engine) - 0.5, unit(engine) - 0.5, unit(engine) - 0.5);
+        while (v.SizeSquared() < 1e-2);
+        return v.Normalize() * length(engine);
+    };
+    auto segment = [](const Vector3D& start, const Vector3D& end) {
+        return Segment3<TFloat>(
+            { static_cast<TFloat>(start.X), static_cast<TFloat>(start.Y), static_cast<TFloat>(start.Z) },
+            { static_cast<TFloat>(end  .X), static_cast<TFloat>(end  .Y), static_cast<TFloat>(end  .Z) }
+        );
+    };
+
+    first .resize(count);
+    second.resize(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Vector3D center = point();
+        const Vector3D u = direction();
+        const Vector3D w = direction();
+
+        // The class of a mixed pair is random, so no branch predictor learns it
+        switch (workload == Workload::Mixed ? static_cast<Workload>(kind(engine)) : workload)
+        {
+        case Workload::Disjoint: {
+            Vector3D shift;
+            (axis(engine) == 0 ? shift.X : shift.Y) = 2;
+            first [i] = segment(center - u, center + u);
+            second[i] = segment(center + shift - w, center + shift + w);
+            break;
+        }
+        case Workload::Skew: {
+            // Offset along the common normal, small enough to keep the boxes overlapping
+            Vector3D normal = Vector3D::CrossProduct(u, w);
+            normal.Normalize() *= 0.01 * (1 + unit(engine));
+            first [i] = segment(center - u, center + u);
+            second[i] = segment(center + normal - w, center + normal + w);
+            break;
+        }
+        case Workload::Parallel: {
+            Vector3D side = Vector3D::CrossProduct(u, w);
+            side.Normalize() *= 0.01 * (1 + unit(engine));
+            first [i] = segment(center - u, center + u);
+            second[i] = segment(center + side - u * 0.5, center + side + u * 1.5);
+            break;
+        }
+        case Workload::Collinear:
+            first [i] = segment(center - u, center + u);
+            second[i] = segment(center, center + u * 2);
+            break;
+
+        case Workload::Point: {
+            const Vector3D on = center + u * (2 * unit(engine) - 1);
+            first [i] = segment(center - u, center + u);
+            second[i] = segment(on, on);
+            break;
+        }
+        case Workload::AxisAligned: {
+            const int a = axis(engine);
+            const int b = (a + 1 + axis(engine) % 2) % 3;
+            Vector3D along[3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+            const Vector3D p = along[a] * length(engine);
+            const Vector3D q = along[b] * length(engine);
+            first [i] = segment(center - p, center + p);
+            second[i] = segment(center - q, center + q);
+            break;
+        }
+        case Workload::Intersecting: {
+            const double k = unit(engine);
+            const double t = unit(engine);
+            first [i] = segment(center - u * k, center + u * (1 - k));
+            second[i] = segment(center - w * t, center + w * (1 - t));
+            break;
+        }
+        case Workload::Mixed:
+            break;
+        }
+    }
+}
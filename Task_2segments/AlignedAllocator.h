@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+//---------------------------------------------------------------------------------------
+template <typename T, std::size_t Alignment = 64>
+class AlignedAllocator
+{
+    static_assert(
+        Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+        "AlignedAllocator requires power of two alignment"
+    );
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+public:
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t count);
+
+    void deallocate(T* pointer, std::size_t count) noexcept;
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+//---------------------------------------------------------------------------------------
+template<typename T, std::size_t Alignment>
+inline T* AlignedAllocator<T, Alignment>::allocate
+(
+    std::size_t count
+)
+{
+    return static_cast<T*>(
+        ::operator new(count * sizeof(T), std::align_val_t(Alignment))
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T, std::size_t Alignment>
+inline void AlignedAllocator<T, Alignment>::deallocate
+(
+    T* pointer,
+    std::size_t
+)
+noexcept
+{
+    ::operator delete(pointer, std::align_val_t(Alignment));
+}
@@ -0,0 +1,269 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Monotonic memory for the results and temporaries of one frame of queries.
+// Allocation bumps a pointer, freeing is a no-op except for the most recent
+// allocation, and Reset() drops everything at once.
+// When a frame overflowed the first block, Reset() replaces all the blocks
+// with a single one of their total size, so a frame that needs no more memory
+// than the previous one makes no heap allocations at all.
+// Containers using the arena must be destroyed before Reset().
+class FrameArena
+{
+public:
+    explicit FrameArena(std::size_t capacity = 64 * 1024);
+
+    FrameArena(const FrameArena&) = delete;
+
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    ~FrameArena();
+
+    void* Allocate(
+        std::size_t bytes,
+        std::size_t alignment = alignof(std::max_align_t)
+    );
+
+    void Deallocate(
+        void* pointer,
+        std::size_t bytes
+    ) noexcept;
+
+    void Reset();
+
+    // Bytes handed out since the last Reset
+    std::size_t Used() const;
+
+    // Bytes held in blocks
+    std::size_t Capacity() const;
+
+    // Blocks taken from the heap over the lifetime of the arena
+    std::size_t Allocations() const;
+
+private:
+    struct Block {
+        Block*      Next;
+        std::size_t Size;
+    };
+
+    static constexpr std::size_t Alignment = 64;
+    static constexpr std::size_t Header    = (sizeof(Block) + Alignment - 1) / Alignment * Alignment;
+
+    void Grow(std::size_t bytes);
+
+    void Release();
+
+private:
+    Block*      Head   = nullptr; // newest block, older ones follow
+    char*       Top    = nullptr;
+    char*       Limit  = nullptr;
+    std::size_t Before = 0;       // bytes used in the blocks after Head
+    std::size_t Total  = 0;
+    std::size_t Count  = 0;
+};
+
+//---------------------------------------------------------------------------------------
+// Standard allocator over a FrameArena, e.g. for ArenaVector outputs of
+// Segment3BVH, Segment3Grid and Segment3SweepAndPrune queries
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+public:
+    ArenaAllocator(FrameArena& arena) noexcept;
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept;
+
+    T* allocate(std::size_t count);
+
+    void deallocate(T* pointer, std::size_t count) noexcept;
+
+    FrameArena& Arena() const;
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return Owner == &other.Arena(); }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return Owner != &other.Arena(); }
+
+private:
+    FrameArena* Owner;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//---------------------------------------------------------------------------------------
+inline FrameArena::FrameArena
+(
+    std::size_t capacity
+)
+{
+    Grow(capacity);
+}
+
+//---------------------------------------------------------------------------------------
+inline FrameArena::~FrameArena()
+{
+    Release();
+}
+
+//---------------------------------------------------------------------------------------
+inline void* FrameArena::Allocate
+(
+    std::size_t bytes,
+    std::size_t alignment
+)
+{
+    std::size_t padding = (alignment - reinterpret_cast<std::size_t>(Top) % alignment) % alignment;
+
+    if (padding + bytes > static_cast<std::size_t>(Limit - Top)) {
+        Grow(bytes + (alignment > Alignment ? alignment : 0));
+        padding = (alignment - reinterpret_cast<std::size_t>(Top) % alignment) % alignment;
+    }
+
+    char* pointer = Top + padding;
+    Top = pointer + bytes;
+    return pointer;
+}
+
+//---------------------------------------------------------------------------------------
+// Only the last allocation is given back, which is enough for the scratch
+// buffers of a query released before its result grows further
+inline void FrameArena::Deallocate
+(
+    void* pointer,
+    std::size_t bytes
+)
+noexcept
+{
+    if (static_cast<char*>(pointer) + bytes == Top)
+        Top = static_cast<char*>(pointer);
+}
+
+//---------------------------------------------------------------------------------------
+inline void FrameArena::Reset()
+{
+    if (Head->Next != nullptr) {
+        const std::size_t total = Total;
+        Release();
+        Grow(total);
+    }
+
+    Top    = reinterpret_cast<char*>(Head) + Header;
+    Before = 0;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t FrameArena::Used() const
+{
+    return Before + static_cast<std::size_t>(Top - reinterpret_cast<char*>(Head) - Header);
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t FrameArena::Capacity() const
+{
+    return Total;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t FrameArena::Allocations() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+// New head block of at least the given size and twice the previous one
+inline void FrameArena::Grow
+(
+    std::size_t bytes
+)
+{
+    std::size_t size = (bytes + Alignment - 1) / Alignment * Alignment;
+    if (Head != nullptr) {
+        Before += static_cast<std::size_t>(Top - reinterpret_cast<char*>(Head) - Header);
+        size = size > 2 * Head->Size ? size : 2 * Head->Size;
+    }
+
+    Block* block = static_cast<Block*>(::operator new(Header + size, std::align_val_t(Alignment)));
+    block->Next = Head;
+    block->Size = size;
+
+    Head   = block;
+    Top    = reinterpret_cast<char*>(block) + Header;
+    Limit  = Top + size;
+    Total += size;
+    ++Count;
+}
+
+//---------------------------------------------------------------------------------------
+inline void FrameArena::Release()
+{
+    while (Head != nullptr) {
+        Block* next = Head->Next;
+        ::operator delete(Head, std::align_val_t(Alignment));
+        Head = next;
+    }
+
+    Top    = nullptr;
+    Limit  = nullptr;
+    Before = 0;
+    Total  = 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline ArenaAllocator<T>::ArenaAllocator
+(
+    FrameArena& arena
+)
+noexcept :
+    Owner(&arena)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+    template<typename U>
+inline ArenaAllocator<T>::ArenaAllocator
+(
+    const ArenaAllocator<U>& other
+)
+noexcept :
+    Owner(&other.Arena())
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline T* ArenaAllocator<T>::allocate
+(
+    std::size_t count
+)
+{
+    return static_cast<T*>(Owner->Allocate(count * sizeof(T), alignof(T)));
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline void ArenaAllocator<T>::deallocate
+(
+    T* pointer,
+    std::size_t count
+)
+noexcept
+{
+    Owner->Deallocate(pointer, count * sizeof(T));
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline FrameArena& ArenaAllocator<T>::Arena() const
+{
+    return *Owner;
+}
@@ -0,0 +1,642 @@
+#pragma once
+#include "Vector3.h"
+#include "WideInteger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+//---------------------------------------------------------------------------------------
+// Exact sign predicates in the style of J. R. Shewchuk, "Adaptive Precision
+// Floating-Point Arithmetic and Fast Robust Geometric Predicates" (1997).
+// Every predicate is first evaluated in plain double together with a static
+// error bound. Near zero it is refined in the stages of the paper: the exact
+// value for the rounded differences, then a first-order correction by their
+// roundoff tails, and only then the fully exact value with floating-point
+// expansions. Float input is widened to double, which is exact. Overflow and
+// underflow are not handled.
+// Integer input is evaluated directly in WideInteger, which has room for the
+// exact values, so there is no filter, no rounding and no overflow.
+class Predicates
+{
+public:
+    // Sign of det[a - d; b - d; c - d], zero iff the points are coplanar
+    template<typename TFloat>
+    static int Orient3D(
+        const Vector3<TFloat>& a,
+        const Vector3<TFloat>& b,
+        const Vector3<TFloat>& c,
+        const Vector3<TFloat>& d
+    );
+
+    // Sign of component axis (0: X, 1: Y, 2: Z) of (b - a) x (d - c). With
+    // c == a this is the 2D orientation of a, b, d projected along axis.
+    template<typename TFloat>
+    static int Cross(
+        const Vector3<TFloat>& a,
+        const Vector3<TFloat>& b,
+        const Vector3<TFloat>& c,
+        const Vector3<TFloat>& d,
+        int axis
+    );
+
+private:
+    // Nonoverlapping expansion: an exact sum of up to N doubles, ordered by
+    // increasing magnitude, zero components eliminated
+    template<int N>
+    struct Expansion {
+        double Terms[N];
+        int    Size;
+
+        int Sign() const;
+    };
+
+    static int Sign(double value);
+
+    static Expansion<1> Term(double a);
+
+    static Expansion<2> Difference(double a, double b);
+
+    static double DifferenceTail(double a, double b, double difference);
+
+    template<int N>
+    static double Estimate(const Expansion<N>& e);
+
+    template<int N, int M>
+    static Expansion<N + M> Sum(const Expansion<N>& e, const Expansion<M>& f);
+
+    template<int N>
+    static Expansion<N> Negate(const Expansion<N>& e);
+
+    template<int N, int M>
+    static Expansion<2 * N * M> Product(const Expansion<N>& e, const Expansion<M>& f);
+
+    static int Sum(int elength, const double* e, int flength, const double* f, double* h);
+
+    static int Scale(int elength, const double* e, double b, double* h);
+
+    static int Cross2(
+        double ax, double ay, double bx, double by,
+        double cx, double cy, double dx, double dy
+    );
+
+    static int Orient3DAdaptive(
+        const double* a,
+        const double* b,
+        const double* c,
+        const double* d,
+        double permanent
+    );
+
+private:
+    // Half an ulp of 1, the unit roundoff of Shewchuk's error bounds
+    static constexpr double Epsilon = 1.1102230246251565e-16;
+
+    static constexpr double ResultBound    = (3. + 8. * Epsilon) * Epsilon;
+    static constexpr double Cross2Bound    = (3. + 16. * Epsilon) * Epsilon;
+    static constexpr double Cross2BoundB   = (2. + 12. * Epsilon) * Epsilon;
+    static constexpr double Cross2BoundC   = (9. + 64. * Epsilon) * Epsilon * Epsilon;
+    static constexpr double Orient3DBound  = (7. + 56. * Epsilon) * Epsilon;
+    static constexpr double Orient3DBoundB = (3. + 28. * Epsilon) * Epsilon;
+    static constexpr double Orient3DBoundC = (26. + 288. * Epsilon) * Epsilon * Epsilon;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline int Predicates::Orient3D
+(
+    const Vector3<TFloat>& a,
+    const Vector3<TFloat>& b,
+    const Vector3<TFloat>& c,
+    const Vector3<TFloat>& d
+)
+{
+    if constexpr (std::is_integral_v<TFloat>) {
+        using Wide = WideIntegerFor<TFloat>;
+
+        const Wide adx = Wide(a.X) - Wide(d.X);
+        const Wide ady = Wide(a.Y) - Wide(d.Y);
+        const Wide adz = Wide(a.Z) - Wide(d.Z);
+        const Wide bdx = Wide(b.X) - Wide(d.X);
+        const Wide bdy = Wide(b.Y) - Wide(d.Y);
+        const Wide bdz = Wide(b.Z) - Wide(d.Z);
+        const Wide cdx = Wide(c.X) - Wide(d.X);
+        const Wide cdy = Wide(c.Y) - Wide(d.Y);
+        const Wide cdz = Wide(c.Z) - Wide(d.Z);
+
+        const Wide determinant =
+            adz * (bdx * cdy - cdx * bdy) +
+            bdz * (cdx * ady - adx * cdy) +
+            cdz * (adx * bdy - bdx * ady);
+
+        return determinant.Sign();
+    }
+    else {
+        const double adx = static_cast<double>(a.X) - d.X;
+        const double ady = static_cast<double>(a.Y) - d.Y;
+        const double adz = static_cast<double>(a.Z) - d.Z;
+        const double bdx = static_cast<double>(b.X) - d.X;
+        const double bdy = static_cast<double>(b.Y) - d.Y;
+        const double bdz = static_cast<double>(b.Z) - d.Z;
+        const double cdx = static_cast<double>(c.X) - d.X;
+        const double cdy = static_cast<double>(c.Y) - d.Y;
+        const double cdz = static_cast<double>(c.Z) - d.Z;
+
+        const double bdxcdy = bdx * cdy;
+        const double cdxbdy = cdx * bdy;
+        const double cdxady = cdx * ady;
+        const double adxcdy = adx * cdy;
+        const double adxbdy = adx * bdy;
+        const double bdxady = bdx * ady;
+
+        const double determinant =
+            adz * (bdxcdy - cdxbdy) +
+            bdz * (cdxady - adxcdy) +
+            cdz * (adxbdy - bdxady);
+
+        const double permanent =
+            (std::abs(bdxcdy) + std::abs(cdxbdy)) * std::abs(adz) +
+            (std::abs(cdxady) + std::abs(adxcdy)) * std::abs(bdz) +
+            (std::abs(adxbdy) + std::abs(bdxady)) * std::abs(cdz);
+
+        const double bound = Orient3DBound * permanent;
+        if (determinant > bound)
+            return 1;
+        if (-determinant > bound)
+            return -1;
+
+        const double pa[3] = { a.X, a.Y, a.Z };
+        const double pb[3] = { b.X, b.Y, b.Z };
+        const double pc[3] = { c.X, c.Y, c.Z };
+        const double pd[3] = { d.X, d.Y, d.Z };
+
+        return Orient3DAdaptive(pa, pb, pc, pd, permanent);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline int Predicates::Cross
+(
+    const Vector3<TFloat>& a,
+    const Vector3<TFloat>& b,
+    const Vector3<TFloat>& c,
+    const Vector3<TFloat>& d,
+    int axis
+)
+{
+    // Component X of a cross product lives in the YZ plane, and so on
+    TFloat Vector3<TFloat>::* const axes[3] = {
+        &Vector3<TFloat>::X,
+        &Vector3<TFloat>::Y,
+        &Vector3<TFloat>::Z,
+    };
+    TFloat Vector3<TFloat>::* const u = axes[(axis + 1) % 3];
+    TFloat Vector3<TFloat>::* const v = axes[(axis + 2) % 3];
+
+    if constexpr (std::is_integral_v<TFloat>) {
+        using Wide = WideIntegerFor<TFloat>;
+
+        const Wide p = Wide(b.*u) - Wide(a.*u);
+        const Wide q = Wide(d.*v) - Wide(c.*v);
+        const Wide r = Wide(b.*v) - Wide(a.*v);
+        const Wide s = Wide(d.*u) - Wide(c.*u);
+
+        return (p * q - r * s).Sign();
+    }
+    else
+        return Cross2(a.*u, a.*v, b.*u, b.*v, c.*u, c.*v, d.*u, d.*v);
+}
+
+//---------------------------------------------------------------------------------------
+// Sign of (b - a) x (d - c) in the plane, the error bound is the one of
+// Shewchuk's orient2d, which has the same shape
+inline int Predicates::Cross2
+(
+    double ax, double ay, double bx, double by,
+    double cx, double cy, double dx, double dy
+)
+{
+    const double p = bx - ax;
+    const double q = dy - cy;
+    const double r = by - ay;
+    const double s = dx - cx;
+
+    const double left  = p * q;
+    const double right = r * s;
+    const double determinant = left - right;
+
+    // Rounding keeps the sign of a difference and of a product, so the sign
+    // is exact when the terms have opposite signs or one of them is zero
+    if ((left > 0. && right <= 0.) || (left < 0. && right >= 0.) || left == 0.)
+        return Sign(determinant);
+
+    const double sum = std::abs(left) + std::abs(right);
+    double bound = Cross2Bound * sum;
+    if (determinant > bound)
+        return 1;
+    if (-determinant > bound)
+        return -1;
+
+    // Exact for the rounded differences
+    const Expansion<4> rounded = Sum(Product(Term(p), Term(q)), Negate(Product(Term(r), Term(s))));
+    double estimate = Estimate(rounded);
+
+    bound = Cross2BoundB * sum;
+    if (estimate >= bound || -estimate >= bound)
+        return Sign(estimate);
+
+    const double pTail = DifferenceTail(bx, ax, p);
+    const double qTail = DifferenceTail(dy, cy, q);
+    const double rTail = DifferenceTail(by, ay, r);
+    const double sTail = DifferenceTail(dx, cx, s);
+
+    if (pTail == 0. && qTail == 0. && rTail == 0. && sTail == 0.)
+        return rounded.Sign();
+
+    // Corrected by the difference tails
+    bound = Cross2BoundC * sum + ResultBound * std::abs(estimate);
+    estimate += (p * qTail + q * pTail) - (r * sTail + s * rTail);
+    if (estimate >= bound || -estimate >= bound)
+        return Sign(estimate);
+
+    const Expansion<16> exact = Sum(
+        Product(Difference(bx, ax), Difference(dy, cy)),
+        Negate(Product(Difference(by, ay), Difference(dx, cx)))
+    );
+
+    return exact.Sign();
+}
+
+//---------------------------------------------------------------------------------------
+inline int Predicates::Orient3DAdaptive
+(
+    const double* a,
+    const double* b,
+    const double* c,
+    const double* d,
+    double permanent
+)
+{
+    const double adx = a[0] - d[0];
+    const double ady = a[1] - d[1];
+    const double adz = a[2] - d[2];
+    const double bdx = b[0] - d[0];
+    const double bdy = b[1] - d[1];
+    const double bdz = b[2] - d[2];
+    const double cdx = c[0] - d[0];
+    const double cdy = c[1] - d[1];
+    const double cdz = c[2] - d[2];
+
+    // Exact for the rounded differences
+    const Expansion<4> bc = Sum(Product(Term(bdx), Term(cdy)), Negate(Product(Term(cdx), Term(bdy))));
+    const Expansion<4> ca = Sum(Product(Term(cdx), Term(ady)), Negate(Product(Term(adx), Term(cdy))));
+    const Expansion<4> ab = Sum(Product(Term(adx), Term(bdy)), Negate(Product(Term(bdx), Term(ady))));
+
+    const Expansion<24> rounded = Sum(
+        Sum(Product(bc, Term(adz)), Product(ca, Term(bdz))),
+        Product(ab, Term(cdz))
+    );
+    double estimate = Estimate(rounded);
+
+    double bound = Orient3DBoundB * permanent;
+    if (estimate >= bound || -estimate >= bound)
+        return Sign(estimate);
+
+    const double adxTail = DifferenceTail(a[0], d[0], adx);
+    const double adyTail = DifferenceTail(a[1], d[1], ady);
+    const double adzTail = DifferenceTail(a[2], d[2], adz);
+    const double bdxTail = DifferenceTail(b[0], d[0], bdx);
+    const double bdyTail = DifferenceTail(b[1], d[1], bdy);
+    const double bdzTail = DifferenceTail(b[2], d[2], bdz);
+    const double cdxTail = DifferenceTail(c[0], d[0], cdx);
+    const double cdyTail = DifferenceTail(c[1], d[1], cdy);
+    const double cdzTail = DifferenceTail(c[2], d[2], cdz);
+
+    if (adxTail == 0. && adyTail == 0. && adzTail == 0. &&
+        bdxTail == 0. && bdyTail == 0. && bdzTail == 0. &&
+        cdxTail == 0. && cdyTail == 0. && cdzTail == 0.)
+        return rounded.Sign();
+
+    // Corrected by the difference tails
+    bound = Orient3DBoundC * permanent + ResultBound * std::abs(estimate);
+    estimate +=
+        (adz * ((bdx * cdyTail + cdy * bdxTail) - (bdy * cdxTail + cdx * bdyTail)) +
+            adzTail * (bdx * cdy - bdy * cdx)) +
+        (bdz * ((cdx * adyTail + ady * cdxTail) - (cdy * adxTail + adx * cdyTail)) +
+            bdzTail * (cdx * ady - cdy * adx)) +
+        (cdz * ((adx * bdyTail + bdy * adxTail) - (ady * bdxTail + bdx * adyTail)) +
+            cdzTail * (adx * bdy - ady * bdx));
+    if (estimate >= bound || -estimate >= bound)
+        return Sign(estimate);
+
+    // Exact
+    const Expansion<2> adxExact = Difference(a[0], d[0]);
+    const Expansion<2> adyExact = Difference(a[1], d[1]);
+    const Expansion<2> adzExact = Difference(a[2], d[2]);
+    const Expansion<2> bdxExact = Difference(b[0], d[0]);
+    const Expansion<2> bdyExact = Difference(b[1], d[1]);
+    const Expansion<2> bdzExact = Difference(b[2], d[2]);
+    const Expansion<2> cdxExact = Difference(c[0], d[0]);
+    const Expansion<2> cdyExact = Difference(c[1], d[1]);
+    const Expansion<2> cdzExact = Difference(c[2], d[2]);
+
+    const Expansion<16> bcExact = Sum(Product(bdxExact, cdyExact), Negate(Product(cdxExact, bdyExact)));
+    const Expansion<16> caExact = Sum(Product(cdxExact, adyExact), Negate(Product(adxExact, cdyExact)));
+    const Expansion<16> abExact = Sum(Product(adxExact, bdyExact), Negate(Product(bdxExact, adyExact)));
+
+    return Sum(
+        Sum(Product(adzExact, bcExact), Product(bdzExact, caExact)),
+        Product(cdzExact, abExact)
+    ).Sign();
+}
+
+//---------------------------------------------------------------------------------------
+template<int N>
+inline int Predicates::Expansion<N>::Sign() const
+{
+    // The last component is the largest one and carries the sign
+    if (Size == 0 || Terms[Size - 1] == 0.)
+        return 0;
+
+    return Terms[Size - 1] > 0. ? 1 : -1;
+}
+
+//---------------------------------------------------------------------------------------
+inline int Predicates::Sign
+(
+    double value
+)
+{
+    return (value > 0.) - (value < 0.);
+}
+
+//---------------------------------------------------------------------------------------
+inline Predicates::Expansion<1> Predicates::Term
+(
+    double a
+)
+{
+    Expansion<1> result = { { a }, a != 0. ? 1 : 0 };
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+// Two-Diff: a - b as an exact two-component expansion
+inline Predicates::Expansion<2> Predicates::Difference
+(
+    double a,
+    double b
+)
+{
+    const double x = a - b;
+    const double y = DifferenceTail(a, b, x);
+
+    Expansion<2> result;
+    result.Size = 0;
+    if (y != 0.)
+        result.Terms[result.Size++] = y;
+    if (x != 0.)
+        result.Terms[result.Size++] = x;
+
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+// Roundoff of difference = a - b, so that a - b == difference + tail exactly
+inline double Predicates::DifferenceTail
+(
+    double a,
+    double b,
+    double difference
+)
+{
+    const double bvirt  = a - difference;
+    const double avirt  = difference + bvirt;
+    const double bround = bvirt - b;
+    const double around = a - avirt;
+
+    return around + bround;
+}
+
+//---------------------------------------------------------------------------------------
+template<int N>
+inline double Predicates::Estimate
+(
+    const Expansion<N>& e
+)
+{
+    double sum = 0.;
+    for (int i = 0; i < e.Size; ++i)
+        sum += e.Terms[i];
+
+    return sum;
+}
+
+//---------------------------------------------------------------------------------------
+template<int N, int M>
+inline Predicates::Expansion<N + M> Predicates::Sum
+(
+    const Expansion<N>& e,
+    const Expansion<M>& f
+)
+{
+    Expansion<N + M> result;
+    result.Size = Sum(e.Size, e.Terms, f.Size, f.Terms, result.Terms);
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+template<int N>
+inline Predicates::Expansion<N> Predicates::Negate
+(
+    const Expansion<N>& e
+)
+{
+    Expansion<N> result = e;
+    for (int i = 0; i < e.Size; ++i)
+        result.Terms[i] = -e.Terms[i];
+
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+template<int N, int M>
+inline Predicates::Expansion<2 * N * M> Predicates::Product
+(
+    const Expansion<N>& e,
+    const Expansion<M>& f
+)
+{
+    Expansion<2 * N * M> result;
+    result.Size = 0;
+
+    // Partial sums go back and forth between result and partial, the order
+    // is chosen so that the last one lands in result
+    const int count = std::min(f.Size, M);
+    double    scaled [2 * N];
+    double    partial[2 * N * M];
+    double*   target = (count % 2) ? result.Terms : partial;
+    double*   source = (count % 2) ? partial : result.Terms;
+
+    for (int i = 0; i < count; ++i) {
+        if (i == 0)
+            result.Size = Scale(e.Size, e.Terms, f.Terms[i], target);
+        else {
+            const int size = Scale(e.Size, e.Terms, f.Terms[i], scaled);
+            result.Size = Sum(result.Size, source, size, scaled, target);
+        }
+        std::swap(source, target);
+    }
+
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+// Shewchuk's fast_expansion_sum_zeroelim
+inline int Predicates::Sum
+(
+    int elength,
+    const double* e,
+    int flength,
+    const double* f,
+    double* h
+)
+{
+    if (elength == 0 || flength == 0) {
+        const double* source = elength == 0 ? f : e;
+        const int     length = elength == 0 ? flength : elength;
+        std::copy(source, source + length, h);
+        return length;
+    }
+
+    auto twoSum = [](double a, double b, double& x, double& y) {
+        x = a + b;
+        const double bvirt = x - a;
+        const double avirt = x - bvirt;
+        y = (a - avirt) + (b - bvirt);
+    };
+
+    int eindex = 0;
+    int findex = 0;
+    int hindex = 0;
+
+    double enow = e[0];
+    double fnow = f[0];
+    double q;
+    double qnew;
+    double hh;
+
+    if ((fnow > enow) == (fnow > -enow)) {
+        q = enow;
+        enow = ++eindex < elength ? e[eindex] : 0.;
+    } else {
+        q = fnow;
+        fnow = ++findex < flength ? f[findex] : 0.;
+    }
+
+    if (eindex < elength && findex < flength)
+    {
+        // Fast-Two-Sum is enough for the first step
+        if ((fnow > enow) == (fnow > -enow)) {
+            qnew = enow + q;
+            hh = q - (qnew - enow);
+            enow = ++eindex < elength ? e[eindex] : 0.;
+        } else {
+            qnew = fnow + q;
+            hh = q - (qnew - fnow);
+            fnow = ++findex < flength ? f[findex] : 0.;
+        }
+        q = qnew;
+        if (hh != 0.)
+            h[hindex++] = hh;
+
+        while (eindex < elength && findex < flength) {
+            if ((fnow > enow) == (fnow > -enow)) {
+                twoSum(q, enow, qnew, hh);
+                enow = ++eindex < elength ? e[eindex] : 0.;
+            } else {
+                twoSum(q, fnow, qnew, hh);
+                fnow = ++findex < flength ? f[findex] : 0.;
+            }
+            q = qnew;
+            if (hh != 0.)
+                h[hindex++] = hh;
+        }
+    }
+
+    while (eindex < elength) {
+        twoSum(q, enow, qnew, hh);
+        enow = ++eindex < elength ? e[eindex] : 0.;
+        q = qnew;
+        if (hh != 0.)
+            h[hindex++] = hh;
+    }
+
+    while (findex < flength) {
+        twoSum(q, fnow, qnew, hh);
+        fnow = ++findex < flength ? f[findex] : 0.;
+        q = qnew;
+        if (hh != 0.)
+            h[hindex++] = hh;
+    }
+
+    if (q != 0. || hindex == 0)
+        h[hindex++] = q;
+
+    return hindex;
+}
+
+//---------------------------------------------------------------------------------------
+// Shewchuk's scale_expansion_zeroelim; the product error term is taken from
+// fma, which is exact, instead of Dekker's splitting
+inline int Predicates::Scale
+(
+    int elength,
+    const double* e,
+    double b,
+    double* h
+)
+{
+    if (elength == 0)
+        return 0;
+
+    auto twoProduct = [](double a, double b, double& x, double& y) {
+        x = a * b;
+        y = std::fma(a, b, -x);
+    };
+
+    int hindex = 0;
+    double q;
+    double hh;
+
+    twoProduct(e[0], b, q, hh);
+    if (hh != 0.)
+        h[hindex++] = hh;
+
+    for (int i = 1; i < elength; ++i)
+    {
+        double product1;
+        double product0;
+        twoProduct(e[i], b, product1, product0);
+
+        // Two-Sum
+        const double sum   = q + product0;
+        const double bvirt = sum - q;
+        const double avirt = sum - bvirt;
+        hh = (q - avirt) + (product0 - bvirt);
+        if (hh != 0.)
+            h[hindex++] = hh;
+
+        // Fast-Two-Sum
+        q  = product1 + sum;
+        hh = sum - (q - product1);
+        if (hh != 0.)
+            h[hindex++] = hh;
+    }
+
+    if (q != 0. || hindex == 0)
+        h[hindex++] = q;
+
+    return hindex;
+}
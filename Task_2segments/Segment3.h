@@ -1,10 +1,12 @@
 #pragma once
 #include "Vector3.h"
+#include "Segment3Trace.h"
+#include "Segment3Result.h"
+#include "Predicates.h"
+#include "Vector3Rational.h"
 #include <algorithm>
-
-#ifdef _LOG
-#include <iostream>
-#endif // _LOG
+#include <cstdint>
+#include <type_traits>
 
 //---------------------------------------------------------------------------------------
 template <typename TFloat>
@@ -40,11 +42,38 @@ public:
 
     bool AABBOverlap(const Segment3<TFloat>& other) const;
 
+    static bool BoxesOverlap(
+        const Segment3<TFloat>& first,
+        const Segment3<TFloat>& second
+    );
+
     bool Intersect(const Vector3<TFloat>& point) const;
 
     Vector3<TFloat> Intersection(const Vector3<TFloat>& point) const;
 
     Vector3<TFloat> Intersection(const Segment3<TFloat>& other) const;
+
+    // Same tests reporting every decision to tracer, see Segment3Trace.h
+    template<typename TTracer>
+    bool Intersect(const Vector3<TFloat>& point, TTracer&& tracer) const;
+
+    template<typename TTracer>
+    Vector3<TFloat> Intersection(const Vector3<TFloat>& point, TTracer&& tracer) const;
+
+    template<typename TTracer>
+    Vector3<TFloat> Intersection(const Segment3<TFloat>& other, TTracer&& tracer) const;
+
+    // Classification by exact predicates instead of eps, see Predicates.h;
+    // for exactly coplanar input only
+    Vector3<TFloat> IntersectionExact(const Segment3<TFloat>& other) const;
+
+    // Same classification on integer coordinates with the point as an exact
+    // rational, see Vector3Rational.h
+    Vector3Rational<TFloat> IntersectionRational(const Segment3<TFloat>& other) const;
+
+    // Intersection with the outcome, the line parameters and the shared part
+    // of collinear segments, see Segment3Result.h
+    Segment3Result<TFloat> IntersectionResult(const Segment3<TFloat>& other) const;
 };
 
 //---------------------------------------------------------------------------------------
@@ -145,9 +174,18 @@ inline bool Segment3<TFloat>::AABBOverlap
 )
 const
 {
-    Segment3<TFloat> first  = this->ToAABB();
-    Segment3<TFloat> second = other.ToAABB();
+    return BoxesOverlap(this->ToAABB(), other.ToAABB());
+}
 
+//---------------------------------------------------------------------------------------
+// Boxes are expected in ToAABB() form: Start is the minimum, End is the maximum
+template<typename TFloat>
+inline bool Segment3<TFloat>::BoxesOverlap
+(
+    const Segment3<TFloat>& first,
+    const Segment3<TFloat>& second
+)
+{
     return (
         first .Start.X <= second.End.X &&
         first .Start.Y <= second.End.Y &&
@@ -166,15 +204,46 @@ inline bool Segment3<TFloat>::Intersect
 )
 const
 {
-#ifdef _LOG
-    std::cout << "Segment-point intersection:\n";
-#endif // _LOG
+    return Intersect(point, Segment3NullTracer());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Vector3<TFloat> Segment3<TFloat>::Intersection
+(
+    const Vector3<TFloat>& point
+)
+const
+{
+    return Intersection(point, Segment3NullTracer());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Vector3<TFloat> Segment3<TFloat>::Intersection
+(
+    const Segment3<TFloat>& other
+)
+const
+{
+    return Intersection(other, Segment3NullTracer());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TTracer>
+inline bool Segment3<TFloat>::Intersect
+(
+    const Vector3<TFloat>& point,
+    TTracer&& tracer
+)
+const
+{
+    tracer(Segment3Step::SegmentPoint);
 
     // One or more pairs of projections do not intersect
     if (!this->AABBOverlap(point)) {
-#ifdef _LOG
-        std::cout << "Point is outside the bounding box\n";
-#endif // _LOG
+        tracer(Segment3Step::PointOutsideAABB);
         return false;
     }
 
@@ -184,58 +253,63 @@ const
         point - this->Start
     ).SizeSquared()) > Vector3<TFloat>::eps)
     {
-#ifdef _LOG
-        std::cout << "Point is not on the line\n";
-#endif // _LOG
-       return false;
+        tracer(Segment3Step::PointOffLine);
+        return false;
     }
 
+    tracer(Segment3Step::PointOnSegment);
     return true;
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
+    template<typename TTracer>
 inline Vector3<TFloat> Segment3<TFloat>::Intersection
 (
-    const Vector3<TFloat>& point
+    const Vector3<TFloat>& point,
+    TTracer&& tracer
 )
 const
 {
-    return Intersect(point) ? point : Vector3<TFloat>(NAN);
+    static_assert(
+        std::is_floating_point_v<TFloat>,
+        "Segment3::Intersection requires floating point type, see IntersectionRational"
+    );
+
+    return Intersect(point, tracer) ? point : Vector3<TFloat>(NAN);
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
+    template<typename TTracer>
 inline Vector3<TFloat> Segment3<TFloat>::Intersection
 (
-    const Segment3<TFloat>& other
+    const Segment3<TFloat>& other,
+    TTracer&& tracer
 )
 const
 {
-#ifdef _LOG
-    std::cout << "Segments intersection:\n";
-#endif // _LOG
+    static_assert(
+        std::is_floating_point_v<TFloat>,
+        "Segment3::Intersection requires floating point type, see IntersectionRational"
+    );
+
+    tracer(Segment3Step::Segments);
 
     if (this->IsPoint()) {
-#ifdef _LOG
-        std::cout << "Segment 1 is point\n";
-#endif // _LOG
-        return other.Intersection(this->Start);
+        tracer(Segment3Step::FirstIsPoint);
+        return other.Intersection(this->Start, tracer);
     }
 
     if (other.IsPoint()) {
-#ifdef _LOG
-        std::cout << "Segment 2 is point\n";
-#endif // _LOG
-        return this->Intersection(other.Start);
+        tracer(Segment3Step::SecondIsPoint);
+        return this->Intersection(other.Start, tracer);
     }
 
     // One or more pairs of projections do not intersect
     if (!this->AABBOverlap(other))
     {
-#ifdef _LOG
-        std::cout << "Bounding boxes do not overlap\n";
-#endif // _LOG
+        tracer(Segment3Step::AABBReject);
         return Vector3<TFloat>(NAN);
     }
 
@@ -251,9 +325,7 @@ const
             crossV
         )) > Vector3<TFloat>::eps)
         {
-#ifdef _LOG
-            std::cout << "Skew lines\n";
-#endif // _LOG
+            tracer(Segment3Step::Skew);
             return Vector3<TFloat>(NAN);
         }
         // => on the same plane
@@ -267,16 +339,12 @@ const
                 thisV
             ).SizeSquared()) > Vector3<TFloat>::eps)
             {
-#ifdef _LOG
-                std::cout << "Parallel lines\n";
-#endif // _LOG
+                tracer(Segment3Step::Parallel);
                 return Vector3<TFloat>(NAN);
             }
             // => same line
 
-#ifdef _LOG
-            std::cout << "Same line\n";
-#endif // _LOG
+            tracer(Segment3Step::SameLine);
             return (
                 this->AABBOverlap(other.Start) ?
                 other.Start : other.End
@@ -333,42 +401,313 @@ const
     }
 
     double t = (
-        thisV.*U * (other.Start.*V - this->Start.*V) -
-        thisV.*V * (other.Start.*U - this->Start.*U)
+        Unfused(thisV.*U * (other.Start.*V - this->Start.*V)) -
+        Unfused(thisV.*V * (other.Start.*U - this->Start.*U))
         ) / (
-        thisV.*V * otherV.*U - otherV.*V * thisV.*U
+        Unfused(thisV.*V * otherV.*U) - Unfused(otherV.*V * thisV.*U)
     );
 
     double k = (
-        otherV.*U * t + other.Start.*U - this->Start.*U
+        Unfused(otherV.*U * t) + other.Start.*U - this->Start.*U
         ) / (
         thisV.*U
     );
 
-#ifdef _LOG
-    if (U == &Vector3<TFloat>::X)
-        std::cout << "U: X\n";
-    else if (U == &Vector3<TFloat>::Y)
-        std::cout << "U: Y\n";
-    else
-        std::cout << "U: Z\n";
-
-    if (V == &Vector3<TFloat>::X)
-        std::cout << "V: X\n";
-    else if (V == &Vector3<TFloat>::Y)
-        std::cout << "V: Y\n";
-    else
-        std::cout << "V: Z\n";
-
-    std::cout << "t: " << t << " " << "k: " << k << "\n";
-#endif // _LOG
-
-    if (t < 0. || 1. < t || k < 0. || 1. < k)
+    const char u = U == &Vector3<TFloat>::X ? 'X' : (U == &Vector3<TFloat>::Y ? 'Y' : 'Z');
+    const char v = V == &Vector3<TFloat>::X ? 'X' : (V == &Vector3<TFloat>::Y ? 'Y' : 'Z');
+
+    // Written so that NaN, left when the projections on the chosen plane are
+    // parallel, is out of range as well and never reported as Solved
+    if (!(0. <= t && t <= 1. && 0. <= k && k <= 1.)) {
+        tracer(Segment3Step::OutOfRange, u, v, t, k);
         return Vector3<TFloat>(NAN);
+    }
 
+    tracer(Segment3Step::Solved, u, v, t, k);
     return other.Start + t * otherV;
 }
 
+//---------------------------------------------------------------------------------------
+// Point segments, skew, parallel and same line are told apart by exact signs,
+// so the answer does not depend on the coordinate scale: segments are coplanar
+// only when Orient3D is exactly zero, parallel only when every component of
+// thisV x otherV is. Coplanar crossing lines are projected along a nonzero
+// component of the cross product and tested with 2D orientations, which keep
+// their signs under the projection. Only the returned point is rounded.
+// This suits input that is exactly coplanar where it should be, e.g. lattice
+// or planar data. A crossing whose coordinates were rounded is almost never
+// exactly coplanar and is reported as skew, a point rounded onto a segment
+// as a miss. Near-coplanar and parallel pairs push Orient3D into its exact
+// stages and cost about ten times Intersection.
+template<typename TFloat>
+inline Vector3<TFloat> Segment3<TFloat>::IntersectionExact
+(
+    const Segment3<TFloat>& other
+)
+const
+{
+    static_assert(
+        std::is_floating_point_v<TFloat>,
+        "Segment3::IntersectionExact requires floating point type, see IntersectionRational"
+    );
+
+    const Vector3<TFloat>& a = this->Start;
+    const Vector3<TFloat>& b = this->End;
+    const Vector3<TFloat>& c = other.Start;
+    const Vector3<TFloat>& d = other.End;
+
+    auto same = [](const Vector3<TFloat>& first, const Vector3<TFloat>& second) {
+        return first.X == second.X && first.Y == second.Y && first.Z == second.Z;
+    };
+    auto collinear = [](
+        const Vector3<TFloat>& p,
+        const Vector3<TFloat>& q,
+        const Vector3<TFloat>& r
+    ) {
+        return
+            Predicates::Cross(p, q, p, r, 0) == 0 &&
+            Predicates::Cross(p, q, p, r, 1) == 0 &&
+            Predicates::Cross(p, q, p, r, 2) == 0;
+    };
+
+    // Boxes overlap, with selects: on random input a branch here mispredicts
+    auto overlap = [](TFloat p, TFloat q, TFloat r, TFloat s) {
+        return (std::max(p, q) >= std::min(r, s)) & (std::max(r, s) >= std::min(p, q));
+    };
+    if (!(overlap(a.X, b.X, c.X, d.X) & overlap(a.Y, b.Y, c.Y, d.Y) & overlap(a.Z, b.Z, c.Z, d.Z)))
+        return Vector3<TFloat>(NAN);
+
+    // Point segments
+    if (same(a, b))
+        return collinear(c, d, a) ? a : Vector3<TFloat>(NAN);
+
+    if (same(c, d))
+        return collinear(a, b, c) ? c : Vector3<TFloat>(NAN);
+
+    // Skew
+    if (Predicates::Orient3D(a, b, c, d) != 0)
+        return Vector3<TFloat>(NAN);
+
+    const int cross[3] = {
+        Predicates::Cross(a, b, c, d, 0),
+        Predicates::Cross(a, b, c, d, 1),
+        Predicates::Cross(a, b, c, d, 2),
+    };
+
+    // Parallel or same line; collinear segments with overlapping boxes overlap
+    if (cross[0] == 0 && cross[1] == 0 && cross[2] == 0)
+    {
+        if (!collinear(a, b, c))
+            return Vector3<TFloat>(NAN);
+
+        if (this->AABBOverlap(c))
+            return c;
+        if (this->AABBOverlap(d))
+            return d;
+        return a;
+    }
+
+    // Lines intersect, project along the largest exactly nonzero component
+    const Vector3<TFloat> thisV  = this->ToVector();
+    const Vector3<TFloat> otherV = other.ToVector();
+    const Vector3<TFloat> crossV = thisV.Cross(otherV);
+    const Vector3<TFloat> tCross = (c - a).Cross(thisV);
+
+    const TFloat crossAxes [3] = { crossV.X, crossV.Y, crossV.Z };
+    const TFloat tCrossAxes[3] = { tCross.X, tCross.Y, tCross.Z };
+
+    int axis = -1;
+    for (int i = 0; i < 3; ++i)
+        if (cross[i] != 0 && (axis < 0 || std::abs(crossAxes[i]) > std::abs(crossAxes[axis])))
+            axis = i;
+
+    if (Predicates::Cross(a, b, a, c, axis) * Predicates::Cross(a, b, a, d, axis) > 0 ||
+        Predicates::Cross(c, d, c, a, axis) * Predicates::Cross(c, d, c, b, axis) > 0)
+        return Vector3<TFloat>(NAN);
+
+    // The segments do cross, keep the rounded parameter on the segment
+    TFloat t = crossAxes[axis] != 0 ? tCrossAxes[axis] / crossAxes[axis] : TFloat(0);
+    t = std::min(std::max(t, TFloat(0)), TFloat(1));
+
+    return c + otherV * t;
+}
+
+//---------------------------------------------------------------------------------------
+// IntersectionExact for integer coordinates. The predicates are exact in
+// WideInteger, and so is the crossing point: with t = num / den the point
+// c + otherV * t is (c * den + otherV * num) / den, where num and den are
+// components of (c - a) x thisV and thisV x otherV along the projection axis.
+template<typename TFloat>
+inline Vector3Rational<TFloat> Segment3<TFloat>::IntersectionRational
+(
+    const Segment3<TFloat>& other
+)
+const
+{
+    static_assert(
+        std::is_integral_v<TFloat>,
+        "Segment3::IntersectionRational requires integer type"
+    );
+
+    using Wide = WideIntegerFor<TFloat>;
+
+    const Vector3<TFloat>& a = this->Start;
+    const Vector3<TFloat>& b = this->End;
+    const Vector3<TFloat>& c = other.Start;
+    const Vector3<TFloat>& d = other.End;
+
+    auto collinear = [](
+        const Vector3<TFloat>& p,
+        const Vector3<TFloat>& q,
+        const Vector3<TFloat>& r
+    ) {
+        return
+            Predicates::Cross(p, q, p, r, 0) == 0 &&
+            Predicates::Cross(p, q, p, r, 1) == 0 &&
+            Predicates::Cross(p, q, p, r, 2) == 0;
+    };
+
+    auto overlap = [](TFloat p, TFloat q, TFloat r, TFloat s) {
+        return std::max(p, q) >= std::min(r, s) && std::max(r, s) >= std::min(p, q);
+    };
+    if (!(overlap(a.X, b.X, c.X, d.X) && overlap(a.Y, b.Y, c.Y, d.Y) && overlap(a.Z, b.Z, c.Z, d.Z)))
+        return Vector3Rational<TFloat>();
+
+    // Point segments
+    if (a == b)
+        return collinear(c, d, a) ? Vector3Rational<TFloat>(a) : Vector3Rational<TFloat>();
+
+    if (c == d)
+        return collinear(a, b, c) ? Vector3Rational<TFloat>(c) : Vector3Rational<TFloat>();
+
+    // Skew
+    if (Predicates::Orient3D(a, b, c, d) != 0)
+        return Vector3Rational<TFloat>();
+
+    const int cross[3] = {
+        Predicates::Cross(a, b, c, d, 0),
+        Predicates::Cross(a, b, c, d, 1),
+        Predicates::Cross(a, b, c, d, 2),
+    };
+
+    // Parallel or same line; collinear segments with overlapping boxes overlap
+    if (cross[0] == 0 && cross[1] == 0 && cross[2] == 0)
+    {
+        if (!collinear(a, b, c))
+            return Vector3Rational<TFloat>();
+
+        if (this->AABBOverlap(c))
+            return Vector3Rational<TFloat>(c);
+        if (this->AABBOverlap(d))
+            return Vector3Rational<TFloat>(d);
+        return Vector3Rational<TFloat>(a);
+    }
+
+    // Lines intersect, any exactly nonzero component will do
+    const int axis = cross[0] != 0 ? 0 : cross[1] != 0 ? 1 : 2;
+
+    if (Predicates::Cross(a, b, a, c, axis) * Predicates::Cross(a, b, a, d, axis) > 0 ||
+        Predicates::Cross(c, d, c, a, axis) * Predicates::Cross(c, d, c, b, axis) > 0)
+        return Vector3Rational<TFloat>();
+
+    const Wide thisV [3] = { Wide(b.X) - Wide(a.X), Wide(b.Y) - Wide(a.Y), Wide(b.Z) - Wide(a.Z) };
+    const Wide otherV[3] = { Wide(d.X) - Wide(c.X), Wide(d.Y) - Wide(c.Y), Wide(d.Z) - Wide(c.Z) };
+    const Wide ca    [3] = { Wide(c.X) - Wide(a.X), Wide(c.Y) - Wide(a.Y), Wide(c.Z) - Wide(a.Z) };
+
+    const int u = (axis + 1) % 3;
+    const int v = (axis + 2) % 3;
+    const Wide numerator   = ca[u] * thisV[v] - ca[v] * thisV[u];
+    const Wide denominator = thisV[u] * otherV[v] - thisV[v] * otherV[u];
+
+    return Vector3Rational<TFloat>(
+        Wide(c.X) * denominator + otherV[0] * numerator,
+        Wide(c.Y) * denominator + otherV[1] * numerator,
+        Wide(c.Z) * denominator + otherV[2] * numerator,
+        denominator
+    );
+}
+
+//---------------------------------------------------------------------------------------
+// Same decisions as Intersection, read back through Segment3ResultTracer
+template<typename TFloat>
+inline Segment3Result<TFloat> Segment3<TFloat>::IntersectionResult
+(
+    const Segment3<TFloat>& other
+)
+const
+{
+    static_assert(
+        std::is_floating_point_v<TFloat>,
+        "Segment3::IntersectionResult requires floating point type, see IntersectionRational"
+    );
+
+    Segment3ResultTracer tracer;
+    const Vector3<TFloat> point = Intersection(other, tracer);
+
+    const TFloat nan = NAN;
+    Segment3Result<TFloat> result = { Segment3Outcome::AABBReject, nan, nan, nan, point };
+
+    // Parameter of a point on the line of a segment, 0 for a point segment
+    auto parameter = [](const Segment3<TFloat>& segment, const Vector3<TFloat>& at) {
+        const Vector3<TFloat> direction = segment.ToVector();
+        const TFloat size = direction.SizeSquared();
+        return size == 0 ? TFloat(0) : (at - segment.Start).Dot(direction) / size;
+    };
+
+    switch (tracer.Last)
+    {
+    case Segment3Step::Solved:
+    case Segment3Step::OutOfRange:
+        result.Outcome = tracer.Last == Segment3Step::Solved ?
+            Segment3Outcome::Crossing :
+            Segment3Outcome::OutOfRange;
+        result.K    = static_cast<TFloat>(tracer.K);
+        result.T    = static_cast<TFloat>(tracer.T);
+        result.KEnd = result.K;
+        break;
+
+    case Segment3Step::SameLine:
+    {
+        const TFloat first  = parameter(*this, other.Start);
+        const TFloat second = parameter(*this, other.End);
+
+        result.Outcome = Segment3Outcome::Overlap;
+        result.K       = std::max(TFloat(0), std::min(first, second));
+        result.KEnd    = std::max(result.K, std::min(TFloat(1), std::max(first, second)));
+        result.Point   = this->Start + this->ToVector() * result.K;
+        result.T       = parameter(other, result.Point);
+        break;
+    }
+
+    case Segment3Step::PointOnSegment:
+        result.Outcome = Segment3Outcome::PointOn;
+        result.K       = parameter(*this, point);
+        result.T       = parameter(other, point);
+        result.KEnd    = result.K;
+        break;
+
+    case Segment3Step::PointOutsideAABB:
+    case Segment3Step::PointOffLine:
+        result.Outcome = Segment3Outcome::PointOff;
+        break;
+
+    case Segment3Step::Skew:
+        result.Outcome = Segment3Outcome::Skew;
+        break;
+
+    case Segment3Step::Parallel:
+        result.Outcome = Segment3Outcome::Parallel;
+        break;
+
+    default:
+        break;
+    }
+
+    return result;
+}
+
 //---------------------------------------------------------------------------------------
 using Segment3F = Segment3<float>;
 using Segment3D = Segment3<double>;
+using Segment3I = Segment3<std::int32_t>;
+using Segment3L = Segment3<std::int64_t>;
@@ -0,0 +1,713 @@
+#pragma once
+#include "ArenaAllocator.h"
+#include "Segment3.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Bounding volume hierarchy over Segment3::ToAABB() boxes. The tree keeps a
+// pointer to the segments it was built from, they must outlive it.
+// Queries only do the broad phase, AABBOverlap and Intersection of the
+// segments themselves stay the narrow phase.
+template <typename TFloat>
+class Segment3BVH
+{
+public:
+    struct Node {
+        Segment3<TFloat> Box;
+        std::uint32_t    Child; // first of two consecutive children
+        std::uint32_t    First; // first entry in Indices for leaves
+        std::uint32_t    Count; // 0 for internal nodes
+    };
+
+    static constexpr std::size_t LeafSize = 4;
+
+public:
+    Segment3BVH() = default;
+
+    Segment3BVH(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    // Boxes in Segment3::ToAABB() form computed beforehand, e.g. the box array
+    // of a Segment3MappedFile, are used in place and must outlive the tree.
+    // With nullptr boxes the tree computes and keeps its own.
+    Segment3BVH(
+        const Segment3<TFloat>* segments,
+        const Segment3<TFloat>* boxes,
+        std::size_t count
+    );
+
+    void Build(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    void Build(
+        const Segment3<TFloat>* segments,
+        const Segment3<TFloat>* boxes,
+        std::size_t count
+    );
+
+    std::size_t Size() const;
+
+    const Segment3<TFloat>& Segment(std::size_t index) const;
+
+    const Segment3<TFloat>& Box(std::size_t index) const;
+
+    const std::vector<Node>& Nodes() const;
+
+    const std::vector<std::uint32_t>& Indices() const;
+
+    // Calls callback(index) for every segment whose box overlaps the given box
+    template<typename TCallback>
+    void Query(
+        const Segment3<TFloat>& box,
+        TCallback&& callback
+    ) const;
+
+    // Nearest hit along query, the one with the smallest parameter on it,
+    // false if query hits nothing
+    bool FirstHit(
+        const Segment3<TFloat>& query,
+        Segment3RayHit<TFloat>& hit
+    ) const;
+
+    // The count nearest hits along query written over the contents of hits,
+    // sorted; with the default count all of them
+    template<typename TAllocator>
+    void OrderedHits(
+        const Segment3<TFloat>& query,
+        std::vector<Segment3RayHit<TFloat>, TAllocator>& hits,
+        std::size_t count = std::numeric_limits<std::size_t>::max()
+    ) const;
+
+    // Calls callback(i, j), i < j, once for every pair of segments whose boxes
+    // overlap: the pairs SelfIntersections() tests, in no particular order
+    template<typename TCallback>
+    void VisitPairs(TCallback&& callback) const;
+
+    std::vector<Segment3Hit<TFloat>> SelfIntersections() const;
+
+    // Same hits written over the contents of hits. The traversal needs no heap
+    // memory, so with an ArenaVector or a vector kept between frames repeated
+    // queries allocate nothing once the buffer is large enough.
+    template<typename TAllocator>
+    void SelfIntersections(std::vector<Segment3Hit<TFloat>, TAllocator>& hits) const;
+
+    // Same hits with every Segment3::Intersection call reported to tracer,
+    // see Segment3Trace.h and Segment3Stats.h
+    template<typename TAllocator, typename TTracer>
+    void SelfIntersections(
+        std::vector<Segment3Hit<TFloat>, TAllocator>& hits,
+        TTracer&& tracer
+    ) const;
+
+    static Segment3<TFloat> Merge(
+        const Segment3<TFloat>& first,
+        const Segment3<TFloat>& second
+    );
+
+private:
+    template<typename TVisit, typename TBound>
+    void AlongSegment(
+        const Segment3<TFloat>& query,
+        TVisit&& visit,
+        TBound&& bound
+    ) const;
+
+    static TFloat Enter(
+        const Segment3<TFloat>& box,
+        const Segment3<TFloat>& query
+    );
+
+    template<typename THits, typename TIntersect>
+    void CollectHits(
+        THits& hits,
+        TIntersect&& intersect
+    ) const;
+
+    template<typename TCallback>
+    void SelfPairs(
+        std::uint32_t first,
+        std::uint32_t second,
+        TCallback&& callback
+    ) const;
+
+private:
+    const Segment3<TFloat>*       Segments = nullptr;
+    std::size_t                   Count    = 0;
+    const Segment3<TFloat>*       External = nullptr; // boxes passed to Build, if any
+    std::vector<Segment3<TFloat>> Boxes;
+    std::vector<Node>             Tree;
+    std::vector<std::uint32_t>    Order;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3BVH<TFloat>::Segment3BVH
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    Build(segments, count);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3BVH<TFloat>::Segment3BVH
+(
+    const Segment3<TFloat>* segments,
+    const Segment3<TFloat>* boxes,
+    std::size_t count
+)
+{
+    Build(segments, boxes, count);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3BVH<TFloat>::Build
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    Build(segments, nullptr, count);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3BVH<TFloat>::Build
+(
+    const Segment3<TFloat>* segments,
+    const Segment3<TFloat>* boxes,
+    std::size_t count
+)
+{
+    Segments = segments;
+    External = boxes;
+    Count    = count;
+
+    if (External)
+        Boxes.clear();
+    else {
+        Boxes.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+            Boxes[i] = segments[i].ToAABB();
+    }
+
+    Order.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+        Order[i] = static_cast<std::uint32_t>(i);
+
+    Tree.clear();
+    if (count == 0)
+        return;
+
+    Tree.reserve(2 * (count / LeafSize + 1));
+    Tree.push_back({ {}, 0, 0, static_cast<std::uint32_t>(count) });
+
+    // Top-down median split along the widest axis of the centroid bounds,
+    // centroids are kept doubled (Start + End) to avoid the scaling
+    std::vector<std::uint32_t> pending(1, 0);
+    while (!pending.empty())
+    {
+        const std::uint32_t index = pending.back();
+        pending.pop_back();
+
+        const std::uint32_t first = Tree[index].First;
+        const std::uint32_t size  = Tree[index].Count;
+
+        Segment3<TFloat> box      = Box(Order[first]);
+        Segment3<TFloat> centroid = { box.Start + box.End, box.Start + box.End };
+        for (std::uint32_t i = first + 1; i < first + size; ++i) {
+            const Segment3<TFloat>& other = Box(Order[i]);
+            const Vector3<TFloat> center = other.Start + other.End;
+
+            box      = Merge(box, other);
+            centroid = Merge(centroid, { center, center });
+        }
+        Tree[index].Box = box;
+
+        if (size <= LeafSize)
+            continue;
+
+        const Vector3<TFloat> extent = centroid.ToVector();
+        TFloat Vector3<TFloat>::* axis = &Vector3<TFloat>::X;
+        if (extent.Y > extent.*axis) axis = &Vector3<TFloat>::Y;
+        if (extent.Z > extent.*axis) axis = &Vector3<TFloat>::Z;
+
+        const std::uint32_t half = size / 2;
+        std::nth_element(
+            Order.begin() + first,
+            Order.begin() + first + half,
+            Order.begin() + first + size,
+            [this, axis](std::uint32_t a, std::uint32_t b) {
+                return Box(a).Start.*axis + Box(a).End.*axis <
+                       Box(b).Start.*axis + Box(b).End.*axis;
+            }
+        );
+
+        const std::uint32_t child = static_cast<std::uint32_t>(Tree.size());
+        Tree[index].Child = child;
+        Tree[index].Count = 0;
+
+        Tree.push_back({ {}, 0, first,        half        });
+        Tree.push_back({ {}, 0, first + half, size - half });
+
+        pending.push_back(child + 1);
+        pending.push_back(child);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3BVH<TFloat>::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>& Segment3BVH<TFloat>::Segment
+(
+    std::size_t index
+)
+const
+{
+    return Segments[index];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>& Segment3BVH<TFloat>::Box
+(
+    std::size_t index
+)
+const
+{
+    return External ? External[index] : Boxes[index];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<typename Segment3BVH<TFloat>::Node>& Segment3BVH<TFloat>::Nodes() const
+{
+    return Tree;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<std::uint32_t>& Segment3BVH<TFloat>::Indices() const
+{
+    return Order;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TCallback>
+inline void Segment3BVH<TFloat>::Query
+(
+    const Segment3<TFloat>& box,
+    TCallback&& callback
+)
+const
+{
+    if (Tree.empty())
+        return;
+
+    std::uint32_t stack[64];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+
+    while (depth > 0)
+    {
+        const Node& node = Tree[stack[--depth]];
+        if (!Segment3<TFloat>::BoxesOverlap(node.Box, box))
+            continue;
+
+        if (node.Count == 0) {
+            stack[depth++] = node.Child;
+            stack[depth++] = node.Child + 1;
+            continue;
+        }
+
+        for (std::uint32_t i = node.First; i < node.First + node.Count; ++i)
+            if (Segment3<TFloat>::BoxesOverlap(Box(Order[i]), box))
+                callback(static_cast<std::size_t>(Order[i]));
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3BVH<TFloat>::FirstHit
+(
+    const Segment3<TFloat>& query,
+    Segment3RayHit<TFloat>& hit
+)
+const
+{
+    bool found = false;
+
+    AlongSegment(query,
+        [this, &query, &hit, &found](std::size_t index)
+        {
+            const Segment3Result<TFloat> result = query.IntersectionResult(Segments[index]);
+            if (!result.IsHit())
+                return;
+
+            const Segment3RayHit<TFloat> candidate = { index, result.K, result.Point };
+            if (!found || candidate < hit) {
+                hit   = candidate;
+                found = true;
+            }
+        },
+        [&hit, &found]() {
+            return found ? hit.T : std::numeric_limits<TFloat>::infinity();
+        }
+    );
+
+    return found;
+}
+
+//---------------------------------------------------------------------------------------
+// Up to count hits are kept sorted while walking, so once count are found
+// the walk skips everything that starts beyond the last of them
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3BVH<TFloat>::OrderedHits
+(
+    const Segment3<TFloat>& query,
+    std::vector<Segment3RayHit<TFloat>, TAllocator>& hits,
+    std::size_t count
+)
+const
+{
+    hits.clear();
+    if (count == 0)
+        return;
+
+    const bool all = count == std::numeric_limits<std::size_t>::max();
+
+    AlongSegment(query,
+        [this, &query, &hits, count, all](std::size_t index)
+        {
+            const Segment3Result<TFloat> result = query.IntersectionResult(Segments[index]);
+            if (!result.IsHit())
+                return;
+
+            const Segment3RayHit<TFloat> candidate = { index, result.K, result.Point };
+            if (all) {
+                hits.push_back(candidate);
+                return;
+            }
+
+            if (hits.size() == count && !(candidate < hits.back()))
+                return;
+
+            hits.insert(std::upper_bound(hits.begin(), hits.end(), candidate), candidate);
+            if (hits.size() > count)
+                hits.pop_back();
+        },
+        [&hits, count, all]() {
+            return !all && hits.size() == count ?
+                hits.back().T : std::numeric_limits<TFloat>::infinity();
+        }
+    );
+
+    if (all)
+        std::sort(hits.begin(), hits.end());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TCallback>
+inline void Segment3BVH<TFloat>::VisitPairs
+(
+    TCallback&& callback
+)
+const
+{
+    if (Tree.empty())
+        return;
+
+    SelfPairs(0, 0, [&callback](std::size_t i, std::size_t j) {
+        if (i > j)
+            std::swap(i, j);
+
+        callback(i, j);
+    });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> Segment3BVH<TFloat>::SelfIntersections() const
+{
+    std::vector<Segment3Hit<TFloat>> hits;
+    SelfIntersections(hits);
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3BVH<TFloat>::SelfIntersections
+(
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits
+)
+const
+{
+    CollectHits(hits, [this](std::size_t i, std::size_t j) {
+        return Segments[i].Intersection(Segments[j]);
+    });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator, typename TTracer>
+inline void Segment3BVH<TFloat>::SelfIntersections
+(
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits,
+    TTracer&& tracer
+)
+const
+{
+    CollectHits(hits, [this, &tracer](std::size_t i, std::size_t j) {
+        return Segments[i].Intersection(Segments[j], tracer);
+    });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3<TFloat> Segment3BVH<TFloat>::Merge
+(
+    const Segment3<TFloat>& first,
+    const Segment3<TFloat>& second
+)
+{
+    return Segment3<TFloat>(
+        {
+            std::min(first.Start.X, second.Start.X),
+            std::min(first.Start.Y, second.Start.Y),
+            std::min(first.Start.Z, second.Start.Z),
+        },
+        {
+            std::max(first.End.X, second.End.X),
+            std::max(first.End.Y, second.End.Y),
+            std::max(first.End.Z, second.End.Z),
+        }
+    );
+}
+
+//---------------------------------------------------------------------------------------
+// Front to back descent along query: of two children the one query enters
+// first is visited first, and a node query enters beyond bound() is skipped,
+// so once bound() drops to the parameter of the hits found the rest of the
+// tree is left unvisited. Calls visit(index) for every segment whose box
+// overlaps the box of query and is entered no later than bound().
+template<typename TFloat>
+    template<typename TVisit, typename TBound>
+inline void Segment3BVH<TFloat>::AlongSegment
+(
+    const Segment3<TFloat>& query,
+    TVisit&& visit,
+    TBound&& bound
+)
+const
+{
+    const TFloat miss = std::numeric_limits<TFloat>::infinity();
+    const Segment3<TFloat> box = query.ToAABB();
+
+    auto entry = [&query, &box, miss](const Segment3<TFloat>& candidate) {
+        return Segment3<TFloat>::BoxesOverlap(candidate, box) ? Enter(candidate, query) : miss;
+    };
+
+    if (Tree.empty())
+        return;
+
+    std::uint32_t stack [64];
+    TFloat        enters[64];
+    std::size_t   depth = 0;
+
+    const TFloat root = entry(Tree[0].Box);
+    if (root != miss) {
+        enters[depth] = root;
+        stack [depth] = 0;
+        ++depth;
+    }
+
+    while (depth > 0)
+    {
+        --depth;
+        if (enters[depth] > bound())
+            continue;
+
+        const Node& node = Tree[stack[depth]];
+
+        if (node.Count == 0) {
+            const TFloat first  = entry(Tree[node.Child    ].Box);
+            const TFloat second = entry(Tree[node.Child + 1].Box);
+
+            // The nearer child goes on top
+            const bool swapped = second < first;
+            const TFloat        nearEnter = swapped ? second : first;
+            const TFloat        farEnter  = swapped ? first  : second;
+            const std::uint32_t nearChild = node.Child + (swapped ? 1 : 0);
+            const std::uint32_t farChild  = node.Child + (swapped ? 0 : 1);
+
+            if (farEnter != miss) {
+                enters[depth] = farEnter;
+                stack [depth] = farChild;
+                ++depth;
+            }
+
+            if (nearEnter != miss) {
+                enters[depth] = nearEnter;
+                stack [depth] = nearChild;
+                ++depth;
+            }
+            continue;
+        }
+
+        for (std::uint32_t i = node.First; i < node.First + node.Count; ++i) {
+            const TFloat enter = entry(Box(Order[i]));
+            if (enter != miss && !(enter > bound()))
+                visit(static_cast<std::size_t>(Order[i]));
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Parameter on query where it enters the box, infinity if it misses it. The
+// slabs are widened by a few units of rounding, so the result never exceeds
+// the parameter of a point of query inside the box and no hit is skipped.
+// An axis along which query does not move is left to BoxesOverlap.
+template<typename TFloat>
+inline TFloat Segment3BVH<TFloat>::Enter
+(
+    const Segment3<TFloat>& box,
+    const Segment3<TFloat>& query
+)
+{
+    const TFloat unit = std::numeric_limits<TFloat>::epsilon();
+    const Vector3<TFloat> direction = query.ToVector();
+
+    TFloat enter = 0;
+    TFloat exit  = 1;
+    for (TFloat Vector3<TFloat>::* axis : { &Vector3<TFloat>::X, &Vector3<TFloat>::Y, &Vector3<TFloat>::Z })
+    {
+        const TFloat step = direction.*axis;
+        if (step == 0)
+            continue;
+
+        const TFloat start = query.Start.*axis;
+        const TFloat pad   = Vector3<TFloat>::eps +
+            4 * unit * (std::abs(box.Start.*axis) + std::abs(box.End.*axis) + std::abs(start));
+
+        TFloat low  = (box.Start.*axis - pad - start) / step;
+        TFloat high = (box.End  .*axis + pad - start) / step;
+        if (step < 0)
+            std::swap(low, high);
+
+        enter = std::max(enter, low);
+        exit  = std::min(exit,  high);
+    }
+
+    return enter <= exit ? enter : std::numeric_limits<TFloat>::infinity();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename THits, typename TIntersect>
+inline void Segment3BVH<TFloat>::CollectHits
+(
+    THits& hits,
+    TIntersect&& intersect
+)
+const
+{
+    hits.clear();
+
+    VisitPairs([&](std::size_t i, std::size_t j)
+    {
+        const Vector3<TFloat> point = intersect(i, j);
+        if (point.IsValid())
+            hits.push_back({ i, j, point });
+    });
+
+    std::sort(hits.begin(), hits.end());
+}
+
+//---------------------------------------------------------------------------------------
+// Simultaneous descent of the tree against itself, calls callback(i, j) once
+// for every unordered pair of segments with overlapping boxes. A pair of
+// nodes leaves at most two pairs on the stack per level of the median split
+// tree, whose height stays below 33 for 32-bit indices.
+template<typename TFloat>
+    template<typename TCallback>
+inline void Segment3BVH<TFloat>::SelfPairs
+(
+    std::uint32_t first,
+    std::uint32_t second,
+    TCallback&& callback
+)
+const
+{
+    std::pair<std::uint32_t, std::uint32_t> pending[128];
+    std::size_t depth = 0;
+    pending[depth++] = { first, second };
+
+    while (depth > 0)
+    {
+        const auto current = pending[--depth];
+
+        const Node& a = Tree[current.first];
+        const Node& b = Tree[current.second];
+
+        if (current.first == current.second)
+        {
+            if (a.Count == 0) {
+                pending[depth++] = { a.Child,     a.Child + 1 };
+                pending[depth++] = { a.Child + 1, a.Child + 1 };
+                pending[depth++] = { a.Child,     a.Child     };
+                continue;
+            }
+
+            for (std::uint32_t i = a.First; i < a.First + a.Count; ++i)
+                for (std::uint32_t j = i + 1; j < a.First + a.Count; ++j)
+                    if (Segment3<TFloat>::BoxesOverlap(Box(Order[i]), Box(Order[j])))
+                        callback(static_cast<std::size_t>(Order[i]), static_cast<std::size_t>(Order[j]));
+            continue;
+        }
+
+        if (!Segment3<TFloat>::BoxesOverlap(a.Box, b.Box))
+            continue;
+
+        if (a.Count == 0 && (b.Count != 0 || a.Box.SizeSquared() >= b.Box.SizeSquared())) {
+            pending[depth++] = { a.Child + 1, current.second };
+            pending[depth++] = { a.Child,     current.second };
+            continue;
+        }
+
+        if (b.Count == 0) {
+            pending[depth++] = { current.first, b.Child + 1 };
+            pending[depth++] = { current.first, b.Child     };
+            continue;
+        }
+
+        for (std::uint32_t i = a.First; i < a.First + a.Count; ++i)
+            for (std::uint32_t j = b.First; j < b.First + b.Count; ++j)
+                if (Segment3<TFloat>::BoxesOverlap(Box(Order[i]), Box(Order[j])))
+                    callback(static_cast<std::size_t>(Order[i]), static_cast<std::size_t>(Order[j]));
+    }
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3BVHF = Segment3BVH<float>;
+using Segment3BVHD = Segment3BVH<double>;
@@ -0,0 +1,419 @@
+#pragma once
+#include "Segment3.h"
+#include "Vector3Batch.h"
+#include "SimdPack.h"
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------
+// Structure-of-arrays storage for Segment3 with a vectorized pairwise
+// Intersection: the i-th segment of one batch is intersected with the i-th
+// segment of the other, producing the same points as Segment3::Intersection.
+// Branches are evaluated for all lanes and merged with masks; results are
+// bit-identical to the scalar path in any build, FMA contraction included,
+// since every product goes through Unfused.
+template <typename TFloat>
+class Segment3Batch
+{
+public:
+    Vector3Batch<TFloat> Start;
+    Vector3Batch<TFloat> End;
+
+public:
+    Segment3Batch() = default;
+
+    Segment3Batch(std::size_t size);
+
+    Segment3Batch(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    std::size_t Size() const;
+
+    void Resize(std::size_t size);
+
+    void Reserve(std::size_t capacity);
+
+    void Clear();
+
+    void PushBack(const Segment3<TFloat>& segment);
+
+    Segment3<TFloat> Get(std::size_t index) const;
+
+    void Set(std::size_t index, const Segment3<TFloat>& segment);
+
+    void Intersection(
+        const Segment3Batch<TFloat>& other,
+        Vector3Batch<TFloat>& result
+    ) const;
+
+    // Pairs [first, last) only, result must already hold last points
+    void Intersection(
+        const Segment3Batch<TFloat>& other,
+        Vector3Batch<TFloat>& result,
+        std::size_t first,
+        std::size_t last
+    ) const;
+
+private:
+    template<typename TPack>
+    static typename TPack::Mask AABBOverlap(
+        const Vector3Pack<TPack>& start,
+        const Vector3Pack<TPack>& end,
+        const Vector3Pack<TPack>& point
+    );
+
+    template<typename TPack>
+    static typename TPack::Mask AABBOverlap(
+        const Vector3Pack<TPack>& firstStart,
+        const Vector3Pack<TPack>& firstEnd,
+        const Vector3Pack<TPack>& secondStart,
+        const Vector3Pack<TPack>& secondEnd
+    );
+
+    template<typename TPack>
+    static typename TPack::Mask Intersect(
+        const Vector3Pack<TPack>& start,
+        const Vector3Pack<TPack>& end,
+        const Vector3Pack<TPack>& point
+    );
+
+    template<typename TPack>
+    void IntersectionKernel(
+        const Segment3Batch<TFloat>& other,
+        Vector3Batch<TFloat>& result,
+        std::size_t index
+    ) const;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Batch<TFloat>::Segment3Batch
+(
+    std::size_t size
+) :
+    Start(size),
+    End(size)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Batch<TFloat>::Segment3Batch
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    Reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        PushBack(segments[i]);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Batch<TFloat>::Size() const
+{
+    return Start.Size();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::Resize
+(
+    std::size_t size
+)
+{
+    Start.Resize(size);
+    End  .Resize(size);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::Reserve
+(
+    std::size_t capacity
+)
+{
+    Start.Reserve(capacity);
+    End  .Reserve(capacity);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::Clear()
+{
+    Start.Clear();
+    End  .Clear();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::PushBack
+(
+    const Segment3<TFloat>& segment
+)
+{
+    Start.PushBack(segment.Start);
+    End  .PushBack(segment.End);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3<TFloat> Segment3Batch<TFloat>::Get
+(
+    std::size_t index
+)
+const
+{
+    return Segment3<TFloat>(Start.Get(index), End.Get(index));
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::Set
+(
+    std::size_t index,
+    const Segment3<TFloat>& segment
+)
+{
+    Start.Set(index, segment.Start);
+    End  .Set(index, segment.End);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::Intersection
+(
+    const Segment3Batch<TFloat>& other,
+    Vector3Batch<TFloat>& result
+)
+const
+{
+    const std::size_t size = std::min(this->Size(), other.Size());
+    result.Resize(size);
+
+    Intersection(other, result, 0, size);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Batch<TFloat>::Intersection
+(
+    const Segment3Batch<TFloat>& other,
+    Vector3Batch<TFloat>& result,
+    std::size_t first,
+    std::size_t last
+)
+const
+{
+    using TPack = typename NativePack<TFloat>::Type;
+
+    std::size_t i = first;
+    for (; i + TPack::Width <= last; i += TPack::Width)
+        IntersectionKernel<TPack>(other, result, i);
+
+    // Remaining lanes
+    for (; i < last; ++i)
+        IntersectionKernel<ScalarPack<TFloat>>(other, result, i);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TPack>
+inline typename TPack::Mask Segment3Batch<TFloat>::AABBOverlap
+(
+    const Vector3Pack<TPack>& start,
+    const Vector3Pack<TPack>& end,
+    const Vector3Pack<TPack>& point
+)
+{
+    return (
+        (point.X >= Min(start.X, end.X)) &
+        (point.Y >= Min(start.Y, end.Y)) &
+        (point.Z >= Min(start.Z, end.Z)) &
+        (point.X <= Max(start.X, end.X)) &
+        (point.Y <= Max(start.Y, end.Y)) &
+        (point.Z <= Max(start.Z, end.Z))
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TPack>
+inline typename TPack::Mask Segment3Batch<TFloat>::AABBOverlap
+(
+    const Vector3Pack<TPack>& firstStart,
+    const Vector3Pack<TPack>& firstEnd,
+    const Vector3Pack<TPack>& secondStart,
+    const Vector3Pack<TPack>& secondEnd
+)
+{
+    return (
+        (Min(firstStart .X, firstEnd .X) <= Max(secondStart.X, secondEnd.X)) &
+        (Min(firstStart .Y, firstEnd .Y) <= Max(secondStart.Y, secondEnd.Y)) &
+        (Min(firstStart .Z, firstEnd .Z) <= Max(secondStart.Z, secondEnd.Z)) &
+        (Min(secondStart.X, secondEnd.X) <= Max(firstStart .X, firstEnd .X)) &
+        (Min(secondStart.Y, secondEnd.Y) <= Max(firstStart .Y, firstEnd .Y)) &
+        (Min(secondStart.Z, secondEnd.Z) <= Max(firstStart .Z, firstEnd .Z))
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TPack>
+inline typename TPack::Mask Segment3Batch<TFloat>::Intersect
+(
+    const Vector3Pack<TPack>& start,
+    const Vector3Pack<TPack>& end,
+    const Vector3Pack<TPack>& point
+)
+{
+    const TPack eps = Vector3<TFloat>::eps;
+
+    return (
+        AABBOverlap(start, end, point) &
+        ~((end - start).Cross(point - start).SizeSquared() > eps)
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TPack>
+inline void Segment3Batch<TFloat>::IntersectionKernel
+(
+    const Segment3Batch<TFloat>& other,
+    Vector3Batch<TFloat>& result,
+    std::size_t index
+)
+const
+{
+    using Mask = typename TPack::Mask;
+    using Wide = typename TPack::Wide;
+
+    const TPack eps = Vector3<TFloat>::eps;
+    const TPack nan = static_cast<TFloat>(NAN);
+
+    const auto thisStart  = Vector3Pack<TPack>::Load(this->Start, index);
+    const auto thisEnd    = Vector3Pack<TPack>::Load(this->End,   index);
+    const auto otherStart = Vector3Pack<TPack>::Load(other.Start, index);
+    const auto otherEnd   = Vector3Pack<TPack>::Load(other.End,   index);
+
+    const auto thisV  = thisEnd  - thisStart;
+    const auto otherV = otherEnd - otherStart;
+
+    Vector3Pack<TPack> point(nan, nan, nan);
+    auto blend = [&point](Mask mask, const Vector3Pack<TPack>& value)
+    {
+        point.X = Select(mask, value.X, point.X);
+        point.Y = Select(mask, value.Y, point.Y);
+        point.Z = Select(mask, value.Z, point.Z);
+    };
+
+    // Point segments, the first one takes precedence
+    const Mask thisPoint = (
+        (Abs(thisV.X) < eps) &
+        (Abs(thisV.Y) < eps) &
+        (Abs(thisV.Z) < eps)
+    );
+    const Mask otherPoint = ~thisPoint & (
+        (Abs(otherV.X) < eps) &
+        (Abs(otherV.Y) < eps) &
+        (Abs(otherV.Z) < eps)
+    );
+
+    blend(thisPoint  & Intersect(otherStart, otherEnd, thisStart), thisStart);
+    blend(otherPoint & Intersect(thisStart, thisEnd, otherStart), otherStart);
+
+    // One or more pairs of projections do not intersect
+    Mask active = ~(thisPoint | otherPoint) &
+        AABBOverlap(thisStart, thisEnd, otherStart, otherEnd);
+
+    if (Any(active))
+    {
+        const auto crossV    = thisV.Cross(otherV);
+        const auto startDist = thisStart - otherStart;
+
+        // Skew lines
+        active = active & ~(Abs(startDist.Dot(crossV)) > eps);
+
+        // Parallel lines or the same line
+        const Mask parallel = active & (crossV.SizeSquared() < eps);
+        const Mask sameLine = parallel &
+            ~(startDist.Cross(thisV).SizeSquared() > eps);
+
+        const Mask startInside = AABBOverlap(thisStart, thisEnd, otherStart);
+        blend(sameLine, {
+            Select(startInside, otherStart.X, otherEnd.X),
+            Select(startInside, otherStart.Y, otherEnd.Y),
+            Select(startInside, otherStart.Z, otherEnd.Z)
+        });
+
+        active = active & ~parallel;
+    }
+
+    if (Any(active))
+    {
+        // Projection plane UV, same preference order as the scalar search
+        const TPack thisX  = Abs(thisV .X), thisY  = Abs(thisV .Y), thisZ  = Abs(thisV .Z);
+        const TPack otherX = Abs(otherV.X), otherY = Abs(otherV.Y), otherZ = Abs(otherV.Z);
+
+        const Mask planeXY = ~((thisX < eps) | (otherY < eps));
+        const Mask planeYZ = ~planeXY & (thisY > eps) & (otherZ > eps);
+        Mask taken = planeXY | planeYZ;
+        const Mask planeZX = ~taken & (thisZ > eps) & (otherX > eps);
+        taken = taken | planeZX;
+        const Mask planeYX = ~taken & (thisY > eps) & (otherX > eps);
+        taken = taken | planeYX;
+        const Mask planeZY = ~taken & (thisZ > eps) & (otherY > eps);
+        taken = taken | planeZY;
+        const Mask planeXZ = ~taken & (thisX > eps) & (otherZ > eps);
+        taken = taken | planeXZ;
+
+        // Lanes without a valid plane keep XY and end up with NaN parameters
+        const Mask uX = planeXY | planeXZ | ~taken;
+        const Mask uY = planeYZ | planeYX;
+        const Mask vX = planeZX | planeYX;
+        const Mask vY = planeXY | planeZY | ~taken;
+
+        auto pickU = [&](const Vector3Pack<TPack>& v) {
+            return Select(uX, v.X, Select(uY, v.Y, v.Z));
+        };
+        auto pickV = [&](const Vector3Pack<TPack>& v) {
+            return Select(vX, v.X, Select(vY, v.Y, v.Z));
+        };
+
+        const TPack thisU       = pickU(thisV),      thisVV       = pickV(thisV);
+        const TPack otherU      = pickU(otherV),     otherVV      = pickV(otherV);
+        const TPack thisStartU  = pickU(thisStart),  thisStartV  = pickV(thisStart);
+        const TPack otherStartU = pickU(otherStart), otherStartV = pickV(otherStart);
+
+        const Wide t = ((
+            thisU  * (otherStartV - thisStartV) -
+            thisVV * (otherStartU - thisStartU)
+            ) / (
+            thisVV * otherU - otherVV * thisU
+        )).Widen();
+
+        const Wide k = (
+            otherU.Widen() * t + otherStartU.Widen() - thisStartU.Widen()
+            ) / (
+            thisU.Widen()
+        );
+
+        const Wide zero = 0.;
+        const Wide one  = 1.;
+        const Mask miss = (t < zero) | (one < t) | (k < zero) | (one < k);
+
+        blend(active & ~miss, {
+            otherStart.X + TPack::Narrow(otherV.X.Widen() * t),
+            otherStart.Y + TPack::Narrow(otherV.Y.Widen() * t),
+            otherStart.Z + TPack::Narrow(otherV.Z.Widen() * t)
+        });
+    }
+
+    point.Store(result, index);
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3BatchF = Segment3Batch<float>;
+using Segment3BatchD = Segment3Batch<double>;
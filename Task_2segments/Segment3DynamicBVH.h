@@ -0,0 +1,633 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3BVH.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Bounding volume hierarchy for segment sets that change between queries.
+// Segments are inserted, updated and removed by handle. Every leaf holds a
+// copy of its segment and a box grown by Margin around Segment3::ToAABB(),
+// so a segment that moves a little stays inside its box and the tree is not
+// touched at all. A leaf that does leave its box is reinserted, and the
+// nodes on its path are rebalanced by AVL-style rotations.
+//
+// Intersections() keeps the hits of the previous call and only re-tests the
+// pairs that involve a segment inserted or updated since then. Pairs of
+// removed segments are dropped.
+template <typename TFloat>
+class Segment3DynamicBVH
+{
+public:
+    using Handle = std::uint32_t;
+
+    static constexpr Handle Null = 0xFFFFFFFF;
+
+    struct Node {
+        Segment3<TFloat> Box;      // grown box of the leaf or union of the children
+        Handle           Parent;   // next free node while the node is unused
+        Handle           Child[2]; // Null for leaves
+        std::int32_t     Height;   // 0 for leaves, -1 for unused nodes
+    };
+
+public:
+    explicit Segment3DynamicBVH(TFloat margin = 0);
+
+    Handle Insert(const Segment3<TFloat>& segment);
+
+    void Remove(Handle handle);
+
+    // Returns true when the segment left its box and the leaf was reinserted
+    bool Update(
+        Handle handle,
+        const Segment3<TFloat>& segment
+    );
+
+    const Segment3<TFloat>& Segment(Handle handle) const;
+
+    std::size_t Size() const;
+
+    std::size_t Height() const;
+
+    const std::vector<Node>& Nodes() const;
+
+    // Rebuilds the internal nodes top-down by median splits, as Segment3BVH
+    // does. Insertions in an unlucky order leave a valid but loose tree, a
+    // rebuild after a bulk load or a large edit makes queries tighter again.
+    // Handles stay the same.
+    void Rebuild();
+
+    // Calls callback(handle) for every segment whose box overlaps the given box
+    template<typename TCallback>
+    void Query(
+        const Segment3<TFloat>& box,
+        TCallback&& callback
+    ) const;
+
+    // All intersecting pairs of the current set sorted by handles, First and
+    // Second are handles
+    const std::vector<Segment3Hit<TFloat>>& Intersections();
+
+    // Number of pairs tested by the last Intersections() call
+    std::size_t Tested() const;
+
+private:
+    Handle Allocate();
+
+    void Free(Handle handle);
+
+    void InsertLeaf(Handle leaf);
+
+    void RemoveLeaf(Handle leaf);
+
+    void Refit(Handle handle);
+
+    Handle Balance(Handle handle);
+
+    Handle Build(
+        Handle* first,
+        Handle* last
+    );
+
+    void Touch(Handle handle);
+
+    Segment3<TFloat> Grow(const Segment3<TFloat>& box) const;
+
+    static TFloat Area(const Segment3<TFloat>& box);
+
+    static bool Contains(
+        const Segment3<TFloat>& outer,
+        const Segment3<TFloat>& inner
+    );
+
+private:
+    TFloat                           Margin;
+    std::vector<Node>                Tree;
+    std::vector<Segment3<TFloat>>    Segments; // by handle, kept apart to keep nodes small
+    Handle                           Root     = Null;
+    Handle                           FreeList = Null;
+    std::size_t                      Count    = 0;
+    std::vector<Handle>              Changed;
+    std::vector<std::uint8_t>        Stale;
+    std::vector<Segment3Hit<TFloat>> Hits;
+    std::size_t                      Pairs    = 0;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3DynamicBVH<TFloat>::Segment3DynamicBVH
+(
+    TFloat margin
+) :
+    Margin(margin)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline typename Segment3DynamicBVH<TFloat>::Handle Segment3DynamicBVH<TFloat>::Insert
+(
+    const Segment3<TFloat>& segment
+)
+{
+    const Handle leaf = Allocate();
+
+    Tree[leaf].Box = Grow(segment.ToAABB());
+    Segments[leaf] = segment;
+
+    InsertLeaf(leaf);
+    Touch(leaf);
+    ++Count;
+
+    return leaf;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::Remove
+(
+    Handle handle
+)
+{
+    RemoveLeaf(handle);
+    Free(handle);
+    Touch(handle);
+    --Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3DynamicBVH<TFloat>::Update
+(
+    Handle handle,
+    const Segment3<TFloat>& segment
+)
+{
+    const Segment3<TFloat> box = segment.ToAABB();
+
+    Segments[handle] = segment;
+    Touch(handle);
+
+    if (Contains(Tree[handle].Box, box))
+        return false;
+
+    RemoveLeaf(handle);
+    Tree[handle].Box = Grow(box);
+    InsertLeaf(handle);
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>& Segment3DynamicBVH<TFloat>::Segment
+(
+    Handle handle
+)
+const
+{
+    return Segments[handle];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3DynamicBVH<TFloat>::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3DynamicBVH<TFloat>::Height() const
+{
+    return Root == Null ? 0 : static_cast<std::size_t>(Tree[Root].Height);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<typename Segment3DynamicBVH<TFloat>::Node>& Segment3DynamicBVH<TFloat>::Nodes() const
+{
+    return Tree;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::Rebuild()
+{
+    if (Root == Null)
+        return;
+
+    std::vector<Handle> leaves;
+    leaves.reserve(Count);
+    for (std::size_t i = 0; i < Tree.size(); ++i)
+        if (Tree[i].Height == 0)
+            leaves.push_back(static_cast<Handle>(i));
+        else if (Tree[i].Height > 0)
+            Free(static_cast<Handle>(i));
+
+    Root = Build(leaves.data(), leaves.data() + leaves.size());
+    Tree[Root].Parent = Null;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TCallback>
+inline void Segment3DynamicBVH<TFloat>::Query
+(
+    const Segment3<TFloat>& box,
+    TCallback&& callback
+)
+const
+{
+    if (Root == Null)
+        return;
+
+    // Rotations keep the height within about 1.44 log2 of the leaf count
+    Handle stack[128];
+    std::size_t depth = 0;
+    stack[depth++] = Root;
+
+    while (depth > 0)
+    {
+        const Handle index = stack[--depth];
+        const Node&  node  = Tree[index];
+        if (!Segment3<TFloat>::BoxesOverlap(node.Box, box))
+            continue;
+
+        if (node.Height > 0) {
+            stack[depth++] = node.Child[0];
+            stack[depth++] = node.Child[1];
+            continue;
+        }
+
+        // The grown box may overlap where the segment itself does not
+        if (Segment3<TFloat>::BoxesOverlap(Segments[index].ToAABB(), box))
+            callback(index);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<Segment3Hit<TFloat>>& Segment3DynamicBVH<TFloat>::Intersections()
+{
+    Pairs = 0;
+    if (Changed.empty())
+        return Hits;
+
+    Hits.erase(
+        std::remove_if(Hits.begin(), Hits.end(), [this](const Segment3Hit<TFloat>& hit) {
+            return Stale[hit.First] || Stale[hit.Second];
+        }),
+        Hits.end()
+    );
+    const std::size_t kept = Hits.size();
+
+    for (const Handle handle : Changed)
+    {
+        // Removed, or reused as an internal node after removal
+        if (Tree[handle].Height != 0)
+            continue;
+
+        Query(Segments[handle].ToAABB(), [&](Handle other)
+        {
+            // A pair of two changed segments is tested from the lower handle
+            if (other == handle || (Stale[other] && other < handle))
+                return;
+
+            ++Pairs;
+            const Handle first  = std::min(handle, other);
+            const Handle second = std::max(handle, other);
+
+            const Vector3<TFloat> point = Segments[first].Intersection(Segments[second]);
+            if (point.IsValid())
+                Hits.push_back({ first, second, point });
+        });
+    }
+
+    for (const Handle handle : Changed)
+        Stale[handle] = 0;
+    Changed.clear();
+
+    std::sort(Hits.begin() + kept, Hits.end());
+    std::inplace_merge(Hits.begin(), Hits.begin() + kept, Hits.end());
+
+    return Hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3DynamicBVH<TFloat>::Tested() const
+{
+    return Pairs;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline typename Segment3DynamicBVH<TFloat>::Handle Segment3DynamicBVH<TFloat>::Allocate()
+{
+    if (FreeList == Null) {
+        Tree.push_back({});
+        Tree.back().Height = -1;
+        Segments.push_back({});
+        Stale.push_back(0);
+        FreeList = static_cast<Handle>(Tree.size() - 1);
+        Tree[FreeList].Parent = Null;
+    }
+
+    const Handle handle = FreeList;
+    FreeList = Tree[handle].Parent;
+
+    Node& node = Tree[handle];
+    node.Parent   = Null;
+    node.Child[0] = Null;
+    node.Child[1] = Null;
+    node.Height   = 0;
+
+    return handle;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::Free
+(
+    Handle handle
+)
+{
+    Tree[handle].Parent = FreeList;
+    Tree[handle].Height = -1;
+    FreeList = handle;
+}
+
+//---------------------------------------------------------------------------------------
+// Descends to the sibling with the least growth of the summed surface area,
+// as in Box2D's b2DynamicTree
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::InsertLeaf
+(
+    Handle leaf
+)
+{
+    if (Root == Null) {
+        Root = leaf;
+        Tree[leaf].Parent = Null;
+        return;
+    }
+
+    const Segment3<TFloat> box = Tree[leaf].Box;
+
+    Handle index = Root;
+    while (Tree[index].Height > 0)
+    {
+        const Node& node = Tree[index];
+
+        const TFloat area     = Area(node.Box);
+        const TFloat combined = Area(Segment3BVH<TFloat>::Merge(node.Box, box));
+
+        // Cost of a new parent for this node and the leaf, and the minimum
+        // cost pushed down to the children
+        const TFloat cost        = 2 * combined;
+        const TFloat inheritance = 2 * (combined - area);
+
+        TFloat costs[2];
+        for (int i = 0; i < 2; ++i) {
+            const Node&  child  = Tree[node.Child[i]];
+            const TFloat merged = Area(Segment3BVH<TFloat>::Merge(child.Box, box));
+            costs[i] = inheritance + (child.Height == 0 ? merged : merged - Area(child.Box));
+        }
+
+        if (cost < costs[0] && cost < costs[1])
+            break;
+
+        index = costs[0] < costs[1] ? node.Child[0] : node.Child[1];
+    }
+
+    const Handle sibling = index;
+    const Handle parent  = Allocate();
+    const Handle grand   = Tree[sibling].Parent;
+
+    Node& node = Tree[parent];
+    node.Parent   = grand;
+    node.Child[0] = sibling;
+    node.Child[1] = leaf;
+    node.Box      = Segment3BVH<TFloat>::Merge(Tree[sibling].Box, box);
+    node.Height   = Tree[sibling].Height + 1;
+
+    if (grand == Null)
+        Root = parent;
+    else
+        Tree[grand].Child[Tree[grand].Child[0] == sibling ? 0 : 1] = parent;
+
+    Tree[sibling].Parent = parent;
+    Tree[leaf]   .Parent = parent;
+
+    Refit(grand);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::RemoveLeaf
+(
+    Handle leaf
+)
+{
+    if (leaf == Root) {
+        Root = Null;
+        return;
+    }
+
+    const Handle parent  = Tree[leaf].Parent;
+    const Handle grand   = Tree[parent].Parent;
+    const Handle sibling = Tree[parent].Child[Tree[parent].Child[0] == leaf ? 1 : 0];
+
+    Tree[sibling].Parent = grand;
+    if (grand == Null)
+        Root = sibling;
+    else
+        Tree[grand].Child[Tree[grand].Child[0] == parent ? 0 : 1] = sibling;
+
+    Free(parent);
+    Refit(grand);
+}
+
+//---------------------------------------------------------------------------------------
+// Restores boxes and heights from the given node up to the root
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::Refit
+(
+    Handle handle
+)
+{
+    while (handle != Null)
+    {
+        handle = Balance(handle);
+
+        Node& node = Tree[handle];
+        const Node& first  = Tree[node.Child[0]];
+        const Node& second = Tree[node.Child[1]];
+
+        node.Box    = Segment3BVH<TFloat>::Merge(first.Box, second.Box);
+        node.Height = 1 + std::max(first.Height, second.Height);
+
+        handle = node.Parent;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// When the children heights differ by more than one, the taller child takes
+// the place of the node and the node takes the shorter grandchild. Returns
+// the node that is now in the place of the given one.
+template<typename TFloat>
+inline typename Segment3DynamicBVH<TFloat>::Handle Segment3DynamicBVH<TFloat>::Balance
+(
+    Handle handle
+)
+{
+    Node& node = Tree[handle];
+    if (node.Height < 2)
+        return handle;
+
+    const std::int32_t balance = Tree[node.Child[1]].Height - Tree[node.Child[0]].Height;
+    if (balance >= -1 && balance <= 1)
+        return handle;
+
+    const int    side = balance > 1 ? 1 : 0;
+    const Handle up   = node.Child[side];
+    const Handle keep = node.Child[1 - side];
+
+    Node& raised = Tree[up];
+    Handle tall  = raised.Child[0];
+    Handle lower = raised.Child[1];
+    if (Tree[tall].Height <= Tree[lower].Height)
+        std::swap(tall, lower);
+
+    raised.Child[0] = handle;
+    raised.Child[1] = tall;
+    raised.Parent   = node.Parent;
+    node.Parent     = up;
+    node.Child[side] = lower;
+    Tree[lower].Parent = handle;
+
+    if (raised.Parent == Null)
+        Root = up;
+    else
+        Tree[raised.Parent].Child[Tree[raised.Parent].Child[0] == handle ? 0 : 1] = up;
+
+    node.Box    = Segment3BVH<TFloat>::Merge(Tree[keep].Box, Tree[lower].Box);
+    node.Height = 1 + std::max(Tree[keep].Height, Tree[lower].Height);
+
+    raised.Box    = Segment3BVH<TFloat>::Merge(node.Box, Tree[tall].Box);
+    raised.Height = 1 + std::max(node.Height, Tree[tall].Height);
+
+    return up;
+}
+
+//---------------------------------------------------------------------------------------
+// Median split along the widest axis of the doubled centroids, returns the
+// root of the subtree over the given leaves
+template<typename TFloat>
+inline typename Segment3DynamicBVH<TFloat>::Handle Segment3DynamicBVH<TFloat>::Build
+(
+    Handle* first,
+    Handle* last
+)
+{
+    if (last - first == 1)
+        return *first;
+
+    Segment3<TFloat> centroid;
+    for (Handle* leaf = first; leaf != last; ++leaf) {
+        const Segment3<TFloat>& box = Tree[*leaf].Box;
+        const Vector3<TFloat> center = box.Start + box.End;
+
+        centroid = leaf == first ?
+            Segment3<TFloat>(center, center) :
+            Segment3BVH<TFloat>::Merge(centroid, { center, center });
+    }
+
+    const Vector3<TFloat> extent = centroid.ToVector();
+    TFloat Vector3<TFloat>::* axis = &Vector3<TFloat>::X;
+    if (extent.Y > extent.*axis) axis = &Vector3<TFloat>::Y;
+    if (extent.Z > extent.*axis) axis = &Vector3<TFloat>::Z;
+
+    Handle* middle = first + (last - first) / 2;
+    std::nth_element(first, middle, last, [this, axis](Handle a, Handle b) {
+        return Tree[a].Box.Start.*axis + Tree[a].Box.End.*axis <
+               Tree[b].Box.Start.*axis + Tree[b].Box.End.*axis;
+    });
+
+    const Handle left   = Build(first, middle);
+    const Handle right  = Build(middle, last);
+    const Handle parent = Allocate();
+
+    Node& node = Tree[parent];
+    node.Child[0] = left;
+    node.Child[1] = right;
+    node.Box      = Segment3BVH<TFloat>::Merge(Tree[left].Box, Tree[right].Box);
+    node.Height   = 1 + std::max(Tree[left].Height, Tree[right].Height);
+
+    Tree[left] .Parent = parent;
+    Tree[right].Parent = parent;
+
+    return parent;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3DynamicBVH<TFloat>::Touch
+(
+    Handle handle
+)
+{
+    if (Stale[handle])
+        return;
+
+    Stale[handle] = 1;
+    Changed.push_back(handle);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3<TFloat> Segment3DynamicBVH<TFloat>::Grow
+(
+    const Segment3<TFloat>& box
+)
+const
+{
+    const Vector3<TFloat> margin(Margin);
+    return Segment3<TFloat>(box.Start - margin, box.End + margin);
+}
+
+//---------------------------------------------------------------------------------------
+// Half of the surface area, only the relative values matter
+template<typename TFloat>
+inline TFloat Segment3DynamicBVH<TFloat>::Area
+(
+    const Segment3<TFloat>& box
+)
+{
+    const Vector3<TFloat> size = box.ToVector();
+    return size.X * size.Y + size.Y * size.Z + size.Z * size.X;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3DynamicBVH<TFloat>::Contains
+(
+    const Segment3<TFloat>& outer,
+    const Segment3<TFloat>& inner
+)
+{
+    return (
+        outer.Start.X <= inner.Start.X &&
+        outer.Start.Y <= inner.Start.Y &&
+        outer.Start.Z <= inner.Start.Z &&
+        inner.End  .X <= outer.End  .X &&
+        inner.End  .Y <= outer.End  .Y &&
+        inner.End  .Z <= outer.End  .Z
+    );
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3DynamicBVHF = Segment3DynamicBVH<float>;
+using Segment3DynamicBVHD = Segment3DynamicBVH<double>;
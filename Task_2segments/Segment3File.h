@@ -0,0 +1,451 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3Span.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+//---------------------------------------------------------------------------------------
+// Binary segment file ("SEG3"):
+//     64-byte header
+//     Count segments, six TFloat each, at offset Segments
+//     Count boxes in Segment3::ToAABB() form at offset Boxes, if HasBoxes
+// Numbers are stored in the native (little-endian on every supported target)
+// byte order; a file written on a machine of the other byte order fails the
+// version check instead of being misread. Both arrays start on 64-byte
+// boundaries, so a mapped file can be used in place.
+struct Segment3FileHeader
+{
+    static constexpr std::uint32_t CurrentVersion = 1;
+    static constexpr std::uint32_t HasBoxes       = 1;
+
+    // Type of the numbers, files without the field read as FloatingPoint
+    static constexpr std::uint32_t FloatingPoint  = 0;
+    static constexpr std::uint32_t Integer        = 1;
+
+    template<typename TFloat>
+    static constexpr std::uint32_t TypeOf = std::is_integral_v<TFloat> ? Integer : FloatingPoint;
+
+    char          Magic[4];  // "SEG3"
+    std::uint32_t Version;
+    std::uint32_t Precision; // sizeof(TFloat): 4 or 8
+    std::uint32_t Flags;
+    std::uint64_t Count;
+    std::uint64_t Segments;  // byte offset of the segment array
+    std::uint64_t Boxes;     // byte offset of the box array, 0 without boxes
+    std::uint32_t Type;      // FloatingPoint or Integer
+    std::uint8_t  Reserved[20];
+
+    // Header of a valid file of the given total size
+    bool IsValid(std::uint64_t fileSize) const;
+};
+
+static_assert(sizeof(Segment3FileHeader) == 64, "Segment3FileHeader must be 64 bytes");
+
+//---------------------------------------------------------------------------------------
+// Writes a SEG3 file in appended chunks, so it can be produced from a stream.
+// Boxes are computed while writing and kept in a temporary file until Close.
+template <typename TFloat>
+class Segment3FileWriter
+{
+public:
+    Segment3FileWriter() = default;
+
+    ~Segment3FileWriter();
+
+    Segment3FileWriter(const Segment3FileWriter&) = delete;
+
+    Segment3FileWriter& operator=(const Segment3FileWriter&) = delete;
+
+    bool Open(
+        const char* path,
+        bool withBoxes
+    );
+
+    bool Write(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    // Appends the boxes, fills the header in and closes the file
+    bool Close();
+
+    // Whole file in one call
+    static bool Save(
+        const char* path,
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        bool withBoxes
+    );
+
+private:
+    std::FILE*    File   = nullptr;
+    std::FILE*    Boxes  = nullptr;
+    bool          Failed = false;
+    std::uint64_t Count  = 0;
+};
+
+//---------------------------------------------------------------------------------------
+// Read-only memory mapping of a SEG3 file. Open only maps and validates the
+// header; pages are read by the OS on first access, so opening costs the
+// same for any file size.
+template <typename TFloat>
+class Segment3MappedFile
+{
+public:
+    Segment3MappedFile() = default;
+
+    ~Segment3MappedFile();
+
+    Segment3MappedFile(const Segment3MappedFile&) = delete;
+
+    Segment3MappedFile& operator=(const Segment3MappedFile&) = delete;
+
+    // False if the file cannot be mapped, is not SEG3 or has another precision
+    // or number type
+    bool Open(const char* path);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    const Segment3FileHeader& Header() const;
+
+    Segment3Span<TFloat> Segments() const;
+
+    // Empty if the file has no boxes
+    Segment3Span<TFloat> Boxes() const;
+
+    // Reads only the header, e.g. to pick the precision before opening
+    static bool ReadHeader(
+        const char* path,
+        Segment3FileHeader& header
+    );
+
+private:
+    const unsigned char* View = nullptr;
+    std::uint64_t        Size = 0;
+#ifdef _WIN32
+    HANDLE               File    = INVALID_HANDLE_VALUE;
+    HANDLE               Mapping = nullptr;
+#endif // _WIN32
+};
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3FileHeader::IsValid
+(
+    std::uint64_t fileSize
+)
+const
+{
+    if (std::memcmp(Magic, "SEG3", 4) != 0 || Version != CurrentVersion)
+        return false;
+
+    if (Precision != sizeof(float) && Precision != sizeof(double))
+        return false;
+
+    if (Type != FloatingPoint && Type != Integer)
+        return false;
+
+    const std::uint64_t bytes = Count * 6 * Precision;
+    if (Count > fileSize / (6 * Precision) || Segments % 64 != 0 ||
+        Segments < sizeof(Segment3FileHeader) || Segments > fileSize || bytes > fileSize - Segments)
+        return false;
+
+    if (Flags & HasBoxes)
+        return Boxes % 64 == 0 && Boxes >= Segments + bytes && Boxes <= fileSize && bytes <= fileSize - Boxes;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3FileWriter<TFloat>::~Segment3FileWriter()
+{
+    if (File)
+        Close();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3FileWriter<TFloat>::Open
+(
+    const char* path,
+    bool withBoxes
+)
+{
+    if (File)
+        Close();
+
+    File   = std::fopen(path, "wb");
+    Boxes  = File && withBoxes ? std::tmpfile() : nullptr;
+    Failed = !File || (withBoxes && !Boxes);
+    Count  = 0;
+
+    // Placeholder header, the real one is written by Close
+    const Segment3FileHeader header = {};
+    Failed = Failed || std::fwrite(&header, sizeof(header), 1, File) != 1;
+
+    return !Failed;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3FileWriter<TFloat>::Write
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    static_assert(sizeof(Segment3<TFloat>) == 6 * sizeof(TFloat), "Segment3 must be six packed TFloat");
+
+    if (Failed || !File)
+        return false;
+
+    Failed = std::fwrite(segments, sizeof(Segment3<TFloat>), count, File) != count;
+
+    if (Boxes) {
+        Segment3<TFloat> boxes[256];
+        for (std::size_t done = 0; !Failed && done < count;) {
+            const std::size_t size = std::min<std::size_t>(256, count - done);
+            for (std::size_t i = 0; i < size; ++i)
+                boxes[i] = segments[done + i].ToAABB();
+
+            Failed = std::fwrite(boxes, sizeof(Segment3<TFloat>), size, Boxes) != size;
+            done  += size;
+        }
+    }
+
+    Count += count;
+    return !Failed;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3FileWriter<TFloat>::Close()
+{
+    if (!File)
+        return false;
+
+    Segment3FileHeader header = {};
+    std::memcpy(header.Magic, "SEG3", 4);
+    header.Version   = Segment3FileHeader::CurrentVersion;
+    header.Precision = sizeof(TFloat);
+    header.Type      = Segment3FileHeader::TypeOf<TFloat>;
+    header.Flags     = Boxes ? Segment3FileHeader::HasBoxes : 0;
+    header.Count     = Count;
+    header.Segments  = sizeof(Segment3FileHeader);
+
+    const std::uint64_t end = header.Segments + Count * sizeof(Segment3<TFloat>);
+    header.Boxes = Boxes ? (end + 63) / 64 * 64 : 0;
+
+    if (Boxes)
+    {
+        const char padding[64] = {};
+        const std::size_t gap = static_cast<std::size_t>(header.Boxes - end);
+        Failed = Failed || std::fwrite(padding, 1, gap, File) != gap;
+        Failed = Failed || std::fseek(Boxes, 0, SEEK_SET) != 0;
+
+        std::vector<char> chunk(1 << 20);
+        while (!Failed) {
+            const std::size_t size = std::fread(chunk.data(), 1, chunk.size(), Boxes);
+            Failed = std::fwrite(chunk.data(), 1, size, File) != size;
+            if (size < chunk.size())
+                break;
+        }
+
+        std::fclose(Boxes);
+        Boxes = nullptr;
+    }
+
+    Failed = Failed ||
+        std::fseek(File, 0, SEEK_SET) != 0 ||
+        std::fwrite(&header, sizeof(header), 1, File) != 1;
+
+    Failed = std::fclose(File) != 0 || Failed;
+    File = nullptr;
+
+    return !Failed;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3FileWriter<TFloat>::Save
+(
+    const char* path,
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    bool withBoxes
+)
+{
+    Segment3FileWriter<TFloat> writer;
+
+    const bool written = writer.Open(path, withBoxes) && writer.Write(segments, count);
+    return writer.Close() && written;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3MappedFile<TFloat>::~Segment3MappedFile()
+{
+    Close();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3MappedFile<TFloat>::Open
+(
+    const char* path
+)
+{
+    Close();
+
+#ifdef _WIN32
+    File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(File, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(Segment3FileHeader))) {
+        Close();
+        return false;
+    }
+    Size = static_cast<std::uint64_t>(size.QuadPart);
+
+    Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    View = Mapping ?
+        static_cast<const unsigned char*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0)) :
+        nullptr;
+#else
+    const int file = ::open(path, O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Segment3FileHeader))) {
+        ::close(file);
+        return false;
+    }
+    Size = static_cast<std::uint64_t>(status.st_size);
+
+    // The mapping stays valid after the descriptor is closed
+    void* view = mmap(nullptr, static_cast<std::size_t>(Size), PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    View = view != MAP_FAILED ? static_cast<const unsigned char*>(view) : nullptr;
+#endif // _WIN32
+
+    if (!View || !Header().IsValid(Size) || Header().Precision != sizeof(TFloat) ||
+        Header().Type != Segment3FileHeader::TypeOf<TFloat>) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3MappedFile<TFloat>::Close()
+{
+#ifdef _WIN32
+    if (View)
+        UnmapViewOfFile(View);
+    if (Mapping)
+        CloseHandle(Mapping);
+    if (File != INVALID_HANDLE_VALUE)
+        CloseHandle(File);
+
+    Mapping = nullptr;
+    File    = INVALID_HANDLE_VALUE;
+#else
+    if (View)
+        munmap(const_cast<unsigned char*>(View), static_cast<std::size_t>(Size));
+#endif // _WIN32
+
+    View = nullptr;
+    Size = 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3MappedFile<TFloat>::IsOpen() const
+{
+    return View != nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3FileHeader& Segment3MappedFile<TFloat>::Header() const
+{
+    return *reinterpret_cast<const Segment3FileHeader*>(View);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Span<TFloat> Segment3MappedFile<TFloat>::Segments() const
+{
+    if (!View)
+        return {};
+
+    return Segment3Span<TFloat>(
+        reinterpret_cast<const Segment3<TFloat>*>(View + Header().Segments),
+        static_cast<std::size_t>(Header().Count)
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Span<TFloat> Segment3MappedFile<TFloat>::Boxes() const
+{
+    if (!View || !(Header().Flags & Segment3FileHeader::HasBoxes))
+        return {};
+
+    return Segment3Span<TFloat>(
+        reinterpret_cast<const Segment3<TFloat>*>(View + Header().Boxes),
+        static_cast<std::size_t>(Header().Count)
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3MappedFile<TFloat>::ReadHeader
+(
+    const char* path,
+    Segment3FileHeader& header
+)
+{
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file)
+        return false;
+
+    const bool read = std::fread(&header, sizeof(header), 1, file) == 1;
+    std::fclose(file);
+
+    return read && std::memcmp(header.Magic, "SEG3", 4) == 0;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3FileWriterF = Segment3FileWriter<float>;
+using Segment3FileWriterD = Segment3FileWriter<double>;
+using Segment3MappedFileF = Segment3MappedFile<float>;
+using Segment3MappedFileD = Segment3MappedFile<double>;
@@ -0,0 +1,401 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Hashed uniform grid broad phase for dense, evenly distributed segments.
+// Every segment is binned into the cells its path crosses (3D DDA walk from
+// Start to End), not into every cell of its box. Cells are hashed into 64-bit
+// keys and the (key, index) entries are sorted, so segments sharing a cell
+// end up in one contiguous run; hash collisions only add candidates.
+// The grid keeps a pointer to the segments, they must outlive it.
+template <typename TFloat>
+class Segment3Grid
+{
+public:
+    Segment3Grid() = default;
+
+    // cellSize <= 0 picks the size from the segment length distribution
+    Segment3Grid(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        TFloat cellSize = 0
+    );
+
+    void Build(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        TFloat cellSize = 0
+    );
+
+    std::size_t Size() const;
+
+    TFloat CellSize() const;
+
+    // Calls callback(x, y, z) for every cell crossed by the segment
+    template<typename TCallback>
+    void Traverse(
+        const Segment3<TFloat>& segment,
+        TCallback&& callback
+    ) const;
+
+    // Unique pairs sharing a cell and passing AABBOverlap, sorted
+    std::vector<Segment3Pair> CandidatePairs() const;
+
+    std::vector<Segment3Hit<TFloat>> SelfIntersections() const;
+
+    // Same results written over the contents of the vectors, temporaries are
+    // taken from the same allocator. With ArenaVector outputs repeated queries
+    // make no heap allocations once the arena is large enough.
+    template<typename TAllocator>
+    void CandidatePairs(std::vector<Segment3Pair, TAllocator>& pairs) const;
+
+    template<typename TAllocator>
+    void SelfIntersections(std::vector<Segment3Hit<TFloat>, TAllocator>& hits) const;
+
+    static TFloat AutoCellSize(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    static std::uint64_t CellKey(
+        std::int64_t x,
+        std::int64_t y,
+        std::int64_t z
+    );
+
+private:
+    struct Entry {
+        std::uint64_t Key;
+        std::uint32_t Index;
+
+        bool operator<(const Entry& other) const;
+    };
+
+    std::int64_t Cell(TFloat coordinate, TFloat origin) const;
+
+private:
+    const Segment3<TFloat>* Segments = nullptr;
+    std::size_t             Count    = 0;
+    TFloat                  Step     = 1;
+    Vector3<TFloat>         Origin;
+    std::vector<Entry>      Entries;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Grid<TFloat>::Segment3Grid
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    TFloat cellSize
+)
+{
+    Build(segments, count, cellSize);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Grid<TFloat>::Build
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    TFloat cellSize
+)
+{
+    Segments = segments;
+    Count    = count;
+    Step     = cellSize > 0 ? cellSize : AutoCellSize(segments, count);
+
+    Entries.clear();
+    if (count == 0)
+        return;
+
+    Origin = segments[0].ToAABB().Start;
+    for (std::size_t i = 1; i < count; ++i) {
+        const Vector3<TFloat> start = segments[i].ToAABB().Start;
+        Origin.X = std::min(Origin.X, start.X);
+        Origin.Y = std::min(Origin.Y, start.Y);
+        Origin.Z = std::min(Origin.Z, start.Z);
+    }
+
+    Entries.reserve(2 * count);
+    for (std::size_t i = 0; i < count; ++i)
+        Traverse(segments[i], [&](std::int64_t x, std::int64_t y, std::int64_t z) {
+            Entries.push_back({ CellKey(x, y, z), static_cast<std::uint32_t>(i) });
+        });
+
+    std::sort(Entries.begin(), Entries.end());
+    Entries.erase(
+        std::unique(Entries.begin(), Entries.end(), [](const Entry& a, const Entry& b) {
+            return a.Key == b.Key && a.Index == b.Index;
+        }),
+        Entries.end()
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Grid<TFloat>::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline TFloat Segment3Grid<TFloat>::CellSize() const
+{
+    return Step;
+}
+
+//---------------------------------------------------------------------------------------
+// Amanatides-Woo walk from floor(Start) to floor(End). Crossing times are
+// recomputed from the cell borders on every step instead of being
+// accumulated. Every point P of the path has its cell floor(P) visited, so two
+// segments meeting on a cell border or corner still share a cell.
+template<typename TFloat>
+    template<typename TCallback>
+inline void Segment3Grid<TFloat>::Traverse
+(
+    const Segment3<TFloat>& segment,
+    TCallback&& callback
+)
+const
+{
+    const TFloat start[3] = { segment.Start.X, segment.Start.Y, segment.Start.Z };
+    const TFloat end  [3] = { segment.End  .X, segment.End  .Y, segment.End  .Z };
+    const TFloat origin[3] = { Origin.X, Origin.Y, Origin.Z };
+
+    std::int64_t cell[3];
+    std::int64_t last[3];
+    std::int64_t direction[3];
+    std::int64_t steps = 0;
+
+    const TFloat tolerance = 64 * std::numeric_limits<TFloat>::epsilon();
+
+    for (int axis = 0; axis < 3; ++axis) {
+        cell[axis] = Cell(start[axis], origin[axis]);
+        last[axis] = Cell(end  [axis], origin[axis]);
+        direction[axis] = last[axis] > cell[axis] ? 1 : (last[axis] < cell[axis] ? -1 : 0);
+        steps += std::abs(last[axis] - cell[axis]);
+    }
+
+    callback(cell[0], cell[1], cell[2]);
+
+    for (; steps > 0; --steps)
+    {
+        TFloat time[3];
+        TFloat best = std::numeric_limits<TFloat>::infinity();
+
+        for (int i = 0; i < 3; ++i) {
+            time[i] = std::numeric_limits<TFloat>::infinity();
+            if (cell[i] == last[i])
+                continue;
+
+            const TFloat border = origin[i] + (cell[i] + (direction[i] > 0 ? 1 : 0)) * Step;
+            time[i] = (border - start[i]) / (end[i] - start[i]);
+            best = std::min(best, time[i]);
+        }
+
+        int axis = -1;
+        int tied = 0;
+        for (int i = 0; i < 3; ++i)
+            if (time[i] <= best + tolerance) {
+                tied |= 1 << i;
+                if (axis < 0 || time[i] < time[axis])
+                    axis = i;
+            }
+
+        // Borders crossed at (nearly) the same time: the crossing point may lie
+        // in any cell stepped along a subset of those axes, visit them all
+        if (tied & (tied - 1))
+            for (int subset = 1; subset < tied; ++subset)
+                if ((subset & tied) == subset)
+                    callback(
+                        cell[0] + (subset & 1 ? direction[0] : 0),
+                        cell[1] + (subset & 2 ? direction[1] : 0),
+                        cell[2] + (subset & 4 ? direction[2] : 0)
+                    );
+
+        if (axis < 0)
+            break;
+
+        cell[axis] += direction[axis];
+        callback(cell[0], cell[1], cell[2]);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Pair> Segment3Grid<TFloat>::CandidatePairs() const
+{
+    std::vector<Segment3Pair> pairs;
+    CandidatePairs(pairs);
+    return pairs;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> Segment3Grid<TFloat>::SelfIntersections() const
+{
+    std::vector<Segment3Hit<TFloat>> hits;
+    SelfIntersections(hits);
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3Grid<TFloat>::CandidatePairs
+(
+    std::vector<Segment3Pair, TAllocator>& pairs
+)
+const
+{
+    pairs.clear();
+
+    for (std::size_t run = 0; run < Entries.size();)
+    {
+        std::size_t next = run + 1;
+        while (next < Entries.size() && Entries[next].Key == Entries[run].Key)
+            ++next;
+
+        for (std::size_t a = run; a < next; ++a)
+            for (std::size_t b = a + 1; b < next; ++b) {
+                const std::size_t i = Entries[a].Index;
+                const std::size_t j = Entries[b].Index;
+
+                if (Segments[i].AABBOverlap(Segments[j]))
+                    pairs.push_back({ std::min(i, j), std::max(i, j) });
+            }
+
+        run = next;
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3Grid<TFloat>::SelfIntersections
+(
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits
+)
+const
+{
+    using Pairs = std::vector<Segment3Pair, typename std::allocator_traits<TAllocator>::template rebind_alloc<Segment3Pair>>;
+
+    Pairs pairs(hits.get_allocator());
+    CandidatePairs(pairs);
+
+    hits.clear();
+    for (const Segment3Pair& pair : pairs) {
+        const Vector3<TFloat> point = Segments[pair.First].Intersection(Segments[pair.Second]);
+        if (point.IsValid())
+            hits.push_back({ pair.First, pair.Second, point });
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Median segment length: most segments then cross one or two cells. Point
+// sets fall back to the cube root of the average volume per segment.
+template<typename TFloat>
+inline TFloat Segment3Grid<TFloat>::AutoCellSize
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    if (count == 0)
+        return 1;
+
+    std::vector<TFloat> lengths(count);
+    Segment3<TFloat> bounds = segments[0].ToAABB();
+    for (std::size_t i = 0; i < count; ++i) {
+        const Segment3<TFloat> box = segments[i].ToAABB();
+        const Vector3<TFloat>  extent = box.ToVector();
+
+        lengths[i] = std::max({ extent.X, extent.Y, extent.Z });
+        bounds = Segment3<TFloat>(
+            { std::min(bounds.Start.X, box.Start.X), std::min(bounds.Start.Y, box.Start.Y), std::min(bounds.Start.Z, box.Start.Z) },
+            { std::max(bounds.End  .X, box.End  .X), std::max(bounds.End  .Y, box.End  .Y), std::max(bounds.End  .Z, box.End  .Z) }
+        );
+    }
+
+    std::nth_element(lengths.begin(), lengths.begin() + count / 2, lengths.end());
+    TFloat size = lengths[count / 2];
+
+    const Vector3<TFloat> extent = bounds.ToVector();
+    const TFloat largest = std::max({ extent.X, extent.Y, extent.Z });
+
+    // No more than ~2^20 cells along the longest side
+    size = std::max(size, largest / static_cast<TFloat>(1 << 20));
+    if (size > 0)
+        return size;
+
+    const TFloat volume = std::max(extent.X, Vector3<TFloat>::eps) *
+                          std::max(extent.Y, Vector3<TFloat>::eps) *
+                          std::max(extent.Z, Vector3<TFloat>::eps);
+    size = std::cbrt(volume / static_cast<TFloat>(count));
+
+    return size > 0 ? size : 1;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::uint64_t Segment3Grid<TFloat>::CellKey
+(
+    std::int64_t x,
+    std::int64_t y,
+    std::int64_t z
+)
+{
+    return (
+        static_cast<std::uint64_t>(x) * 0x9E3779B97F4A7C15ull ^
+        static_cast<std::uint64_t>(y) * 0xC2B2AE3D27D4EB4Full ^
+        static_cast<std::uint64_t>(z) * 0x165667B19E3779F9ull
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Grid<TFloat>::Entry::operator<
+(
+    const Entry& other
+)
+const
+{
+    return Key < other.Key || (Key == other.Key && Index < other.Index);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::int64_t Segment3Grid<TFloat>::Cell
+(
+    TFloat coordinate,
+    TFloat origin
+)
+const
+{
+    std::int64_t cell = static_cast<std::int64_t>(std::floor((coordinate - origin) / Step));
+
+    // Agree with the borders origin + cell * Step used by the walk
+    while (coordinate < origin + cell * Step)
+        --cell;
+    while (coordinate >= origin + (cell + 1) * Step)
+        ++cell;
+
+    return cell;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3GridF = Segment3Grid<float>;
+using Segment3GridD = Segment3Grid<double>;
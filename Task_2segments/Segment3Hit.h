@@ -0,0 +1,90 @@
+#pragma once
+#include "Vector3.h"
+#include <cstddef>
+#include <tuple>
+
+//---------------------------------------------------------------------------------------
+// Intersection found by a many-vs-many query: First < Second are indices into
+// the queried set, Point is segments[First].Intersection(segments[Second])
+template <typename TFloat>
+struct Segment3Hit
+{
+    std::size_t First;
+    std::size_t Second;
+    Vector3<TFloat> Point;
+
+    bool operator<(const Segment3Hit<TFloat>& other) const;
+};
+
+//---------------------------------------------------------------------------------------
+// Intersection found walking along a query segment: Index is into the queried
+// set, T the parameter of Point on the query, 0 at its Start and 1 at its End.
+// For a segment on the same line Point is where the shared part begins.
+// Ordered by T, ties by Index.
+template <typename TFloat>
+struct Segment3RayHit
+{
+    std::size_t Index;
+    TFloat T;
+    Vector3<TFloat> Point;
+
+    bool operator<(const Segment3RayHit<TFloat>& other) const;
+};
+
+//---------------------------------------------------------------------------------------
+// Candidate pair produced by a broad phase, First < Second
+struct Segment3Pair
+{
+    std::size_t First;
+    std::size_t Second;
+
+    bool operator<(const Segment3Pair& other) const;
+
+    bool operator==(const Segment3Pair& other) const;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Hit<TFloat>::operator<
+(
+    const Segment3Hit<TFloat>& other
+)
+const
+{
+    return std::tie(First, Second) < std::tie(other.First, other.Second);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3RayHit<TFloat>::operator<
+(
+    const Segment3RayHit<TFloat>& other
+)
+const
+{
+    return std::tie(T, Index) < std::tie(other.T, other.Index);
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Pair::operator<
+(
+    const Segment3Pair& other
+)
+const
+{
+    return std::tie(First, Second) < std::tie(other.First, other.Second);
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Pair::operator==
+(
+    const Segment3Pair& other
+)
+const
+{
+    return First == other.First && Second == other.Second;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3HitF = Segment3Hit<float>;
+using Segment3HitD = Segment3Hit<double>;
@@ -0,0 +1,246 @@
+#pragma once
+#include "Segment3Batch.h"
+#include <cfloat>
+
+//---------------------------------------------------------------------------------------
+// Pairwise intersection of double segments with a single precision prefilter
+// for misses. The batch keeps a float copy of the segments next to the double
+// one, so a register holds twice the lanes of Segment3BatchD and the filter
+// reads half the bytes. In float, with a bound on the error including the
+// rounding of the input, the filter only certifies the two early misses of
+// Segment3::Intersection: disjoint boxes and clearly skew lines. Runs of packs
+// with any other pair are recomputed in place by the Segment3BatchD kernel,
+// so hits, misses and points all match the double path, with any build
+// flags: the kernel's products are unfused like the scalar ones.
+// Certifying a hit is out of reach: it needs coplanarity against the double
+// eps of 1e-15, while rounding the input to float alone moves the triple
+// product of a coplanar pair by far more than that at any ordinary scale.
+// The batch therefore pays off only for sets dominated by disjoint or skew
+// pairs, e.g. the candidates of a coarse broad phase; where many pairs may
+// intersect Segment3BatchD is faster.
+class Segment3MixedBatch
+{
+public:
+    Segment3MixedBatch() = default;
+
+    Segment3MixedBatch(
+        const Segment3<double>* segments,
+        std::size_t count
+    );
+
+    std::size_t Size() const;
+
+    // Both return the number of pairs that were recomputed in double
+    std::size_t Intersection(
+        const Segment3MixedBatch& other,
+        Vector3Batch<double>& result
+    ) const;
+
+    // Pairs [first, last) only, result must already hold last points
+    std::size_t Intersection(
+        const Segment3MixedBatch& other,
+        Vector3Batch<double>& result,
+        std::size_t first,
+        std::size_t last
+    ) const;
+
+private:
+    // Returns the lanes left to double, the caller writes the certified misses
+    template<typename TPack>
+    unsigned IntersectionKernel(
+        const Segment3MixedBatch& other,
+        std::size_t index
+    ) const;
+
+private:
+    // Unit roundoff of float, 2^-24
+    static constexpr float Roundoff = 5.96046448e-8f;
+
+    // Margin on top of the first-order error bounds
+    static constexpr float Safety = 4.f;
+
+    Segment3Batch<float>  Narrow;
+    Segment3Batch<double> Wide;
+};
+
+//---------------------------------------------------------------------------------------
+inline Segment3MixedBatch::Segment3MixedBatch
+(
+    const Segment3<double>* segments,
+    std::size_t count
+) :
+    Wide(segments, count)
+{
+    auto narrow = [](const Vector3<double>& vector) {
+        return Vector3<float>(
+            static_cast<float>(vector.X),
+            static_cast<float>(vector.Y),
+            static_cast<float>(vector.Z)
+        );
+    };
+
+    Narrow.Reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        Narrow.PushBack(Segment3<float>(narrow(segments[i].Start), narrow(segments[i].End)));
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t Segment3MixedBatch::Size() const
+{
+    return Narrow.Size();
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t Segment3MixedBatch::Intersection
+(
+    const Segment3MixedBatch& other,
+    Vector3Batch<double>& result
+)
+const
+{
+    const std::size_t size = std::min(this->Size(), other.Size());
+    result.Resize(size);
+
+    return Intersection(other, result, 0, size);
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t Segment3MixedBatch::Intersection
+(
+    const Segment3MixedBatch& other,
+    Vector3Batch<double>& result,
+    std::size_t first,
+    std::size_t last
+)
+const
+{
+    using TPack = NativeFloatPack::Type;
+
+    std::size_t fallbacks = 0;
+    std::size_t run = last;
+
+    // Pairs [run, end) go to double as one range
+    auto flush = [&](std::size_t end) {
+        if (run == last)
+            return;
+        Wide.Intersection(other.Wide, result, run, end);
+        fallbacks += end - run;
+        run = last;
+    };
+    auto settle = [&](std::size_t index, std::size_t width, unsigned bits) {
+        if (bits == 0) {
+            flush(index);
+            for (std::size_t lane = 0; lane < width; ++lane)
+                result.Set(index + lane, Vector3<double>(NAN));
+        }
+        else if (run == last)
+            run = index;
+    };
+
+    std::size_t i = first;
+    for (; i + TPack::Width <= last; i += TPack::Width)
+        settle(i, TPack::Width, IntersectionKernel<TPack>(other, i));
+
+    // Remaining lanes
+    for (; i < last; ++i)
+        settle(i, 1, IntersectionKernel<ScalarPack<float>>(other, i));
+
+    flush(last);
+
+    return fallbacks;
+}
+
+//---------------------------------------------------------------------------------------
+// Error bounds: every input is off by at most Roundoff * scale after the
+// conversion, so a difference of two inputs is off by delta = 5 * Roundoff *
+// scale. A product of such differences a * b is off by at most
+// delta * (|a| + |b|) + Roundoff * |a * b|, and so on up the expression;
+// magnitudes are bounded by the largest component plus delta.
+// A decision against a threshold is certain when the value is farther from it
+// than Safety times its bound.
+template<typename TPack>
+inline unsigned Segment3MixedBatch::IntersectionKernel
+(
+    const Segment3MixedBatch& other,
+    std::size_t index
+)
+const
+{
+    using Mask = typename TPack::Mask;
+
+    const TPack eps    = static_cast<float>(Vector3<double>::eps);
+    const TPack unit   = Roundoff;
+    const TPack safety = Safety;
+    const TPack two    = 2.f;
+
+    const auto thisStart  = Vector3Pack<TPack>::Load(this->Narrow.Start, index);
+    const auto thisEnd    = Vector3Pack<TPack>::Load(this->Narrow.End,   index);
+    const auto otherStart = Vector3Pack<TPack>::Load(other.Narrow.Start, index);
+    const auto otherEnd   = Vector3Pack<TPack>::Load(other.Narrow.End,   index);
+
+    const auto thisV     = thisEnd  - thisStart;
+    const auto otherV    = otherEnd - otherStart;
+    const auto startDist = thisStart - otherStart;
+
+    auto maxAbs = [](const Vector3Pack<TPack>& v) {
+        return Max(Abs(v.X), Max(Abs(v.Y), Abs(v.Z)));
+    };
+    auto tie = [](TPack a, TPack b) {
+        return (a <= b) & (a >= b);
+    };
+    auto above = [&](TPack value, TPack error) {
+        return Abs(value) > eps + safety * error;
+    };
+
+    const TPack scale = Max(
+        Max(maxAbs(thisStart),  maxAbs(thisEnd)),
+        Max(maxAbs(otherStart), maxAbs(otherEnd))
+    );
+    const TPack delta = TPack(5.f) * unit * scale;
+
+    // Out of float range, or point segments, or maybe point segments
+    Mask uncertain = ~(scale <= TPack(FLT_MAX)) |
+        ~(above(thisV .X, delta) | above(thisV .Y, delta) | above(thisV .Z, delta)) |
+        ~(above(otherV.X, delta) | above(otherV.Y, delta) | above(otherV.Z, delta));
+
+    // Rounding keeps the order of coordinates but may turn it into a tie
+    const TPack thisMinX  = Min(thisStart .X, thisEnd .X), thisMaxX  = Max(thisStart .X, thisEnd .X);
+    const TPack thisMinY  = Min(thisStart .Y, thisEnd .Y), thisMaxY  = Max(thisStart .Y, thisEnd .Y);
+    const TPack thisMinZ  = Min(thisStart .Z, thisEnd .Z), thisMaxZ  = Max(thisStart .Z, thisEnd .Z);
+    const TPack otherMinX = Min(otherStart.X, otherEnd.X), otherMaxX = Max(otherStart.X, otherEnd.X);
+    const TPack otherMinY = Min(otherStart.Y, otherEnd.Y), otherMaxY = Max(otherStart.Y, otherEnd.Y);
+    const TPack otherMinZ = Min(otherStart.Z, otherEnd.Z), otherMaxZ = Max(otherStart.Z, otherEnd.Z);
+
+    const Mask separate =
+        (thisMinX  > otherMaxX) | (thisMinY  > otherMaxY) | (thisMinZ  > otherMaxZ) |
+        (otherMinX > thisMaxX ) | (otherMinY > thisMaxY ) | (otherMinZ > thisMaxZ );
+    const Mask boxTie =
+        tie(thisMinX,  otherMaxX) | tie(thisMinY,  otherMaxY) | tie(thisMinZ,  otherMaxZ) |
+        tie(otherMinX, thisMaxX ) | tie(otherMinY, thisMaxY ) | tie(otherMinZ, thisMaxZ );
+
+    Mask active = ~uncertain & ~separate;
+    uncertain = uncertain | (active & boxTie);
+    active = active & ~boxTie;
+
+    const TPack thisL  = maxAbs(thisV)     + delta;
+    const TPack otherL = maxAbs(otherV)    + delta;
+    const TPack distL  = maxAbs(startDist) + delta;
+
+    if (Any(active))
+    {
+        const auto  crossV = thisV.Cross(otherV);
+        const TPack crossL = two * thisL * otherL;
+        const TPack crossE = two * delta * (thisL + otherL) + TPack(4.f) * unit * thisL * otherL;
+
+        // Skew lines
+        const TPack triple  = startDist.Dot(crossV);
+        const TPack tripleE = TPack(3.f) * (delta * crossL + distL * crossE) +
+            TPack(9.f) * unit * distL * crossL;
+
+        // Everything that is not certainly skew may intersect
+        uncertain = uncertain | (active & ~above(triple, tripleE));
+    }
+
+    // Pairs that may intersect or lie inside an error band
+    return Bits(uncertain);
+}
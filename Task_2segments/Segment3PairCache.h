@@ -0,0 +1,340 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3BVH.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Results of Segment3::Intersection for pairs of segments identified by
+// handles below 2^32 (indices in a segment array, Segment3DynamicBVH handles
+// and so on).
+// Touch() stamps a handle with the current value of a change counter; a
+// cached result is reused while both of its segments have older stamps than
+// the result itself.
+//
+// A hit costs one probe of an open-addressing hash table; an entry takes
+// 8 + 8 + sizeof(Vector3) bytes and the table is kept 2 to 4 times the live
+// pairs. A probe is about as expensive as Segment3::Intersection itself, and
+// once the table outgrows the cache it is slower than recomputing. Use the
+// cache for costlier narrow phases such as Segment3::IntersectionExact, where
+// reused pairs save several times the probe.
+//
+// When the table fills up, entries not used in the current or the previous
+// frame (see NextFrame) are evicted before it grows, so its size follows the
+// pairs that are actually queried.
+template <typename TFloat>
+class Segment3PairCache
+{
+public:
+    explicit Segment3PairCache(std::size_t capacity = 1024);
+
+    // Marks the segment as changed, pairs with it are recomputed
+    void Touch(std::size_t handle);
+
+    void NextFrame();
+
+    // first.Intersection(second), from the cache when possible. A pair must
+    // be passed in the same order every time, the key is ordered.
+    Vector3<TFloat> Intersection(
+        std::size_t firstHandle,
+        std::size_t secondHandle,
+        const Segment3<TFloat>& first,
+        const Segment3<TFloat>& second
+    );
+
+    // Same with the point computed by intersect() on a miss, for narrow
+    // phases other than Segment3::Intersection
+    template<typename TIntersect>
+    Vector3<TFloat> Intersection(
+        std::size_t firstHandle,
+        std::size_t secondHandle,
+        TIntersect&& intersect
+    );
+
+    void Clear();
+
+    std::size_t Size() const;
+
+    std::size_t Lookups() const;
+
+    std::size_t Hits() const;
+
+    double HitRate() const;
+
+    void ResetStatistics();
+
+    // Bytes held by the table and the stamps
+    std::size_t MemoryUsage() const;
+
+private:
+    struct Entry {
+        std::uint64_t   Key;
+        std::uint32_t   Stamp; // change counter when the point was computed
+        std::uint32_t   Frame; // last frame the entry was used in
+        Vector3<TFloat> Point;
+    };
+
+    static constexpr std::uint64_t Empty = ~std::uint64_t(0);
+
+    std::uint32_t Stamp(std::size_t handle) const;
+
+    Entry& Find(std::uint64_t key);
+
+    void Rehash();
+
+private:
+    std::vector<Entry>         Table;
+    std::vector<std::uint32_t> Stamps;
+    std::uint32_t              Changes  = 0;
+    std::size_t                Count    = 0;
+    std::uint32_t              Frame    = 0;
+    std::size_t                Requests = 0;
+    std::size_t                Found    = 0;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3PairCache<TFloat>::Segment3PairCache
+(
+    std::size_t capacity
+)
+{
+    std::size_t size = 16;
+    while (size < 2 * capacity)
+        size *= 2;
+
+    Table.resize(size);
+    Clear();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PairCache<TFloat>::Touch
+(
+    std::size_t handle
+)
+{
+    if (handle >= Stamps.size())
+        Stamps.resize(handle + 1, 0);
+
+    Stamps[handle] = ++Changes;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PairCache<TFloat>::NextFrame()
+{
+    ++Frame;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Vector3<TFloat> Segment3PairCache<TFloat>::Intersection
+(
+    std::size_t firstHandle,
+    std::size_t secondHandle,
+    const Segment3<TFloat>& first,
+    const Segment3<TFloat>& second
+)
+{
+    return Intersection(firstHandle, secondHandle, [&first, &second]() {
+        return first.Intersection(second);
+    });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TIntersect>
+inline Vector3<TFloat> Segment3PairCache<TFloat>::Intersection
+(
+    std::size_t firstHandle,
+    std::size_t secondHandle,
+    TIntersect&& intersect
+)
+{
+    const std::uint64_t key     = (static_cast<std::uint64_t>(firstHandle) << 32) | secondHandle;
+    const std::uint32_t changed = std::max(Stamp(firstHandle), Stamp(secondHandle));
+
+    ++Requests;
+
+    Entry* entry = &Find(key);
+    if (entry->Key == key && entry->Stamp >= changed) {
+        ++Found;
+        entry->Frame = Frame;
+        return entry->Point;
+    }
+
+    const Vector3<TFloat> point = intersect();
+
+    if (entry->Key != key)
+    {
+        if (2 * (Count + 1) > Table.size()) {
+            Rehash();
+            entry = &Find(key);
+        }
+
+        entry->Key = key;
+        ++Count;
+    }
+
+    entry->Stamp = Changes;
+    entry->Frame = Frame;
+    entry->Point = point;
+
+    return point;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PairCache<TFloat>::Clear()
+{
+    for (Entry& entry : Table)
+        entry.Key = Empty;
+
+    Count = 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3PairCache<TFloat>::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3PairCache<TFloat>::Lookups() const
+{
+    return Requests;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3PairCache<TFloat>::Hits() const
+{
+    return Found;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline double Segment3PairCache<TFloat>::HitRate() const
+{
+    return Requests == 0 ? 0.0 : static_cast<double>(Found) / Requests;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PairCache<TFloat>::ResetStatistics()
+{
+    Requests = 0;
+    Found    = 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3PairCache<TFloat>::MemoryUsage() const
+{
+    return Table.capacity() * sizeof(Entry) + Stamps.capacity() * sizeof(std::uint32_t);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::uint32_t Segment3PairCache<TFloat>::Stamp
+(
+    std::size_t handle
+)
+const
+{
+    return handle < Stamps.size() ? Stamps[handle] : 0;
+}
+
+//---------------------------------------------------------------------------------------
+// Slot holding the key, or the empty slot where it would be inserted
+template<typename TFloat>
+inline typename Segment3PairCache<TFloat>::Entry& Segment3PairCache<TFloat>::Find
+(
+    std::uint64_t key
+)
+{
+    const std::size_t mask = Table.size() - 1;
+
+    std::size_t index = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while (Table[index].Key != key && Table[index].Key != Empty)
+        index = (index + 1) & mask;
+
+    return Table[index];
+}
+
+//---------------------------------------------------------------------------------------
+// Drops the entries idle for more than a frame, and doubles the table if the
+// rest still fill more than a quarter of it
+template<typename TFloat>
+inline void Segment3PairCache<TFloat>::Rehash()
+{
+    std::vector<Entry> old;
+    old.reserve(Count);
+    for (const Entry& entry : Table)
+        if (entry.Key != Empty && Frame - entry.Frame <= 1)
+            old.push_back(entry);
+
+    std::size_t size = Table.size();
+    while (4 * (old.size() + 1) > size)
+        size *= 2;
+
+    Table.assign(size, Entry());
+    Clear();
+
+    for (const Entry& entry : old)
+        Find(entry.Key) = entry;
+
+    Count = old.size();
+}
+
+//---------------------------------------------------------------------------------------
+// Segment3BVH::SelfIntersections() with segment indices as cache handles:
+// pairs whose segments were not touched in the cache since the last call are
+// not recomputed. With Segment3::Intersection as the narrow phase this is
+// slower than the plain query, see above; pass a costlier narrow phase such
+// as IntersectionExact as intersect(first, second).
+template<typename TFloat, typename TIntersect>
+inline std::vector<Segment3Hit<TFloat>> SelfIntersections
+(
+    const Segment3BVH<TFloat>& bvh,
+    Segment3PairCache<TFloat>& cache,
+    TIntersect&& intersect
+)
+{
+    std::vector<Segment3Hit<TFloat>> hits;
+    bvh.VisitPairs([&bvh, &cache, &intersect, &hits](std::size_t i, std::size_t j) {
+        const Vector3<TFloat> point = cache.Intersection(i, j, [&bvh, &intersect, i, j]() {
+            return intersect(bvh.Segment(i), bvh.Segment(j));
+        });
+
+        if (point.IsValid())
+            hits.push_back({ i, j, point });
+    });
+
+    cache.NextFrame();
+    std::sort(hits.begin(), hits.end());
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> SelfIntersections
+(
+    const Segment3BVH<TFloat>& bvh,
+    Segment3PairCache<TFloat>& cache
+)
+{
+    return SelfIntersections(bvh, cache, [](const Segment3<TFloat>& first, const Segment3<TFloat>& second) {
+        return first.Intersection(second);
+    });
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3PairCacheF = Segment3PairCache<float>;
+using Segment3PairCacheD = Segment3PairCache<double>;
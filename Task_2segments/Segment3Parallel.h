@@ -0,0 +1,259 @@
+#pragma once
+#include "Segment3Batch.h"
+#include "Segment3BVH.h"
+#include "Segment3Hit.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Multithreaded batch and all-pairs queries on top of a WorkStealingPool.
+// Work is cut into many more tasks than threads and balanced by stealing,
+// since a task of skew rejections costs far less than one of full solves.
+// Every worker appends hits to its own buffer and records which task they
+// came from; buffers are merged in task order, so the output is identical
+// to the single-threaded query whatever the scheduling was.
+template <typename TFloat>
+class Segment3Parallel
+{
+public:
+    explicit Segment3Parallel(WorkStealingPool& pool);
+
+    // Segment3Batch::Intersection split into tasks of grain pairs
+    void Intersection(
+        const Segment3Batch<TFloat>& first,
+        const Segment3Batch<TFloat>& second,
+        Vector3Batch<TFloat>& result,
+        std::size_t grain = 4096
+    );
+
+    // Narrow phase over candidate pairs of a broad phase, in pair order
+    std::vector<Segment3Hit<TFloat>> Intersections(
+        const Segment3<TFloat>* segments,
+        const std::vector<Segment3Pair>& pairs,
+        std::size_t grain = 1024
+    );
+
+    // Same hits as Segment3BVH::SelfIntersections
+    std::vector<Segment3Hit<TFloat>> SelfIntersections(
+        const Segment3BVH<TFloat>& bvh,
+        std::size_t grain = 256
+    );
+
+    // Same queries with the hits written over the contents of hits. Worker
+    // buffers are kept between calls, so with an ArenaVector or a vector kept
+    // between frames repeated queries stop allocating once buffers are large
+    // enough.
+    template<typename TAllocator>
+    void Intersections(
+        const Segment3<TFloat>* segments,
+        const std::vector<Segment3Pair>& pairs,
+        std::vector<Segment3Hit<TFloat>, TAllocator>& hits,
+        std::size_t grain = 1024
+    );
+
+    template<typename TAllocator>
+    void SelfIntersections(
+        const Segment3BVH<TFloat>& bvh,
+        std::vector<Segment3Hit<TFloat>, TAllocator>& hits,
+        std::size_t grain = 256
+    );
+
+private:
+    struct Chunk {
+        std::size_t Task;
+        std::size_t Worker;
+        std::size_t Begin;
+        std::size_t End;
+    };
+
+    struct alignas(64) Buffer {
+        std::vector<Segment3Hit<TFloat>> Hits;
+        std::vector<Chunk>               Chunks;
+    };
+
+    void Reset();
+
+    template<typename THits>
+    void Merge(THits& hits);
+
+private:
+    WorkStealingPool&   Pool;
+    std::vector<Buffer> Buffers;
+    std::vector<Chunk>  Chunks; // of all workers, in task order
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Parallel<TFloat>::Segment3Parallel
+(
+    WorkStealingPool& pool
+) :
+    Pool(pool),
+    Buffers(pool.Threads())
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Parallel<TFloat>::Intersection
+(
+    const Segment3Batch<TFloat>& first,
+    const Segment3Batch<TFloat>& second,
+    Vector3Batch<TFloat>& result,
+    std::size_t grain
+)
+{
+    // Task borders on a multiple of the widest pack keep every lane vectorized
+    grain = std::max<std::size_t>((grain + 7) / 8 * 8, 8);
+
+    const std::size_t size = std::min(first.Size(), second.Size());
+    result.Resize(size);
+
+    Pool.ParallelFor((size + grain - 1) / grain, [&](std::size_t task, std::size_t)
+    {
+        first.Intersection(second, result, task * grain, std::min(size, (task + 1) * grain));
+    });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> Segment3Parallel<TFloat>::Intersections
+(
+    const Segment3<TFloat>* segments,
+    const std::vector<Segment3Pair>& pairs,
+    std::size_t grain
+)
+{
+    std::vector<Segment3Hit<TFloat>> hits;
+    Intersections(segments, pairs, hits, grain);
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> Segment3Parallel<TFloat>::SelfIntersections
+(
+    const Segment3BVH<TFloat>& bvh,
+    std::size_t grain
+)
+{
+    std::vector<Segment3Hit<TFloat>> hits;
+    SelfIntersections(bvh, hits, grain);
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3Parallel<TFloat>::Intersections
+(
+    const Segment3<TFloat>* segments,
+    const std::vector<Segment3Pair>& pairs,
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits,
+    std::size_t grain
+)
+{
+    grain = std::max<std::size_t>(grain, 1);
+    Reset();
+
+    Pool.ParallelFor((pairs.size() + grain - 1) / grain, [&](std::size_t task, std::size_t worker)
+    {
+        Buffer& buffer = Buffers[worker];
+        const std::size_t begin = buffer.Hits.size();
+
+        const std::size_t last = std::min(pairs.size(), (task + 1) * grain);
+        for (std::size_t i = task * grain; i < last; ++i) {
+            const Segment3Pair& pair = pairs[i];
+            const Vector3<TFloat> point = segments[pair.First].Intersection(segments[pair.Second]);
+            if (point.IsValid())
+                buffer.Hits.push_back({ pair.First, pair.Second, point });
+        }
+
+        buffer.Chunks.push_back({ task, worker, begin, buffer.Hits.size() });
+    });
+
+    Merge(hits);
+}
+
+//---------------------------------------------------------------------------------------
+// Tasks are ranges of the first index; every segment queries the tree with
+// its box and keeps partners with a larger index, so each pair is tested once
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3Parallel<TFloat>::SelfIntersections
+(
+    const Segment3BVH<TFloat>& bvh,
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits,
+    std::size_t grain
+)
+{
+    grain = std::max<std::size_t>(grain, 1);
+    Reset();
+
+    const std::size_t size = bvh.Size();
+
+    Pool.ParallelFor((size + grain - 1) / grain, [&](std::size_t task, std::size_t worker)
+    {
+        Buffer& buffer = Buffers[worker];
+        const std::size_t begin = buffer.Hits.size();
+
+        const std::size_t last = std::min(size, (task + 1) * grain);
+        for (std::size_t i = task * grain; i < last; ++i)
+            bvh.Query(bvh.Box(i), [&](std::size_t j)
+            {
+                if (j <= i)
+                    return;
+
+                const Vector3<TFloat> point = bvh.Segment(i).Intersection(bvh.Segment(j));
+                if (point.IsValid())
+                    buffer.Hits.push_back({ i, j, point });
+            });
+
+        std::sort(buffer.Hits.begin() + begin, buffer.Hits.end());
+        buffer.Chunks.push_back({ task, worker, begin, buffer.Hits.size() });
+    });
+
+    Merge(hits);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Parallel<TFloat>::Reset()
+{
+    Buffers.resize(Pool.Threads());
+    for (Buffer& buffer : Buffers) {
+        buffer.Hits.clear();
+        buffer.Chunks.clear();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename THits>
+inline void Segment3Parallel<TFloat>::Merge
+(
+    THits& hits
+)
+{
+    Chunks.clear();
+    std::size_t total = 0;
+    for (const Buffer& buffer : Buffers) {
+        Chunks.insert(Chunks.end(), buffer.Chunks.begin(), buffer.Chunks.end());
+        total += buffer.Hits.size();
+    }
+
+    std::sort(Chunks.begin(), Chunks.end(), [](const Chunk& a, const Chunk& b) {
+        return a.Task < b.Task;
+    });
+
+    hits.clear();
+    hits.reserve(total);
+    for (const Chunk& chunk : Chunks) {
+        const std::vector<Segment3Hit<TFloat>>& source = Buffers[chunk.Worker].Hits;
+        hits.insert(hits.end(), source.begin() + chunk.Begin, source.begin() + chunk.End);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3ParallelF = Segment3Parallel<float>;
+using Segment3ParallelD = Segment3Parallel<double>;
@@ -0,0 +1,171 @@
+#pragma once
+#include "Segment3Batch.h"
+#include "SpscQueue.h"
+#include "Vector3Batch.h"
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Consecutive-pairs intersection run as three overlapping stages: a reader
+// thread parses chunks of segments into batches, a compute thread runs
+// Segment3Batch::Intersection on them and the calling thread emits the hits.
+// Chunks circulate through bounded SpscQueues and go back to the reader once
+// emitted, so at most Depth chunks are in flight and a stage that runs ahead
+// waits for the slowest one. Chunks and queues are members and their memory
+// is reused by every run once the batches have grown to the chunk size; the
+// two stage threads are started by each run, since the queues wait by
+// yielding and idle threads kept between runs would spin.
+// Hits are emitted in input order, the same as the sequential loop.
+template <typename TFloat>
+class Segment3Pipeline
+{
+public:
+    // Chunk is the number of pairs per chunk, depth the number of chunks
+    explicit Segment3Pipeline(
+        std::size_t chunk = 1 << 16,
+        std::size_t depth = 4
+    );
+
+    // Calls emit(pair, point) for every intersecting pair of segments
+    // 2 * pair and 2 * pair + 1 of reader (see Segment3Stream.h), returns the
+    // number of hits. The reader is only used from the reader thread.
+    template<typename TReader, typename TEmit>
+    std::size_t Pairs(TReader& reader, TEmit&& emit);
+
+    // Segments read by the last run, an odd last one has no pair
+    std::size_t Segments() const;
+
+private:
+    struct Chunk {
+        std::vector<Segment3<TFloat>> Segments;
+        Segment3Batch<TFloat>         First;
+        Segment3Batch<TFloat>         Second;
+        Vector3Batch<TFloat>          Points;
+        std::size_t                   Base  = 0; // index of the first pair
+        std::size_t                   Read  = 0; // segments
+        bool                          Last  = false;
+    };
+
+private:
+    std::size_t        Size;
+    std::vector<Chunk> Chunks;
+    SpscQueue<Chunk*>  Free;
+    SpscQueue<Chunk*>  Parsed;
+    SpscQueue<Chunk*>  Computed;
+    std::size_t        Total = 0;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Pipeline<TFloat>::Segment3Pipeline
+(
+    std::size_t chunk,
+    std::size_t depth
+) :
+    Size(chunk > 0 ? chunk : 1),
+    Chunks(depth > 1 ? depth : 2),
+    Free(Chunks.size()),
+    Parsed(Chunks.size()),
+    Computed(Chunks.size())
+{
+    for (Chunk& current : Chunks)
+        current.Segments.resize(2 * Size);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TReader, typename TEmit>
+inline std::size_t Segment3Pipeline<TFloat>::Pairs
+(
+    TReader& reader,
+    TEmit&& emit
+)
+{
+    // A run ends with Parsed and Computed empty and the chunks the reader did
+    // not need still in Free
+    for (Chunk* unused = nullptr; Free.TryPop(unused); )
+        ;
+
+    for (Chunk& current : Chunks)
+        Free.Push(&current);
+
+    std::thread ingest([&]()
+    {
+        for (std::size_t base = 0;; )
+        {
+            Chunk& current = *Free.Pop();
+
+            current.Read = reader.Read(current.Segments.data(), 2 * Size);
+            current.Base = base;
+            current.Last = current.Read < 2 * Size;
+
+            const std::size_t count = current.Read / 2;
+            current.First .Resize(count);
+            current.Second.Resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                current.First .Set(i, current.Segments[2 * i]);
+                current.Second.Set(i, current.Segments[2 * i + 1]);
+            }
+
+            base += count;
+            const bool last = current.Last;
+            Parsed.Push(&current);
+            if (last)
+                break;
+        }
+    });
+
+    std::thread compute([&]()
+    {
+        for (;;)
+        {
+            Chunk& current = *Parsed.Pop();
+            current.First.Intersection(current.Second, current.Points);
+
+            // Once pushed the chunk may be emitted and refilled by the reader
+            const bool last = current.Last;
+            Computed.Push(&current);
+            if (last)
+                break;
+        }
+    });
+
+    std::size_t hits = 0;
+    Total = 0;
+
+    for (bool last = false; !last; )
+    {
+        Chunk& current = *Computed.Pop();
+
+        const std::size_t count = current.Read / 2;
+        for (std::size_t i = 0; i < count; ++i) {
+            const Vector3<TFloat> point = current.Points.Get(i);
+            if (!point.IsValid())
+                continue;
+
+            emit(current.Base + i, point);
+            ++hits;
+        }
+
+        Total += current.Read;
+        last = current.Last;
+        Free.Push(&current);
+    }
+
+    ingest .join();
+    compute.join();
+
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Pipeline<TFloat>::Segments() const
+{
+    return Total;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3PipelineF = Segment3Pipeline<float>;
+using Segment3PipelineD = Segment3Pipeline<double>;
@@ -0,0 +1,721 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3BVH.h"
+#include "Segment3Hit.h"
+#include "Predicates.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Bentley-Ottmann sweep for segments lying in one plane: floor plans, PCB
+// layers and the like. The segments are projected along the coordinate axis
+// closest to the plane normal, which keeps the coordinates exact, and swept
+// in O((n + k) log n) for k intersections.
+//
+// All decisions of the sweep use the exact 2D orientations of Predicates.
+// Segments meeting at an endpoint are collected at that endpoint, proper
+// crossings become swap events, and crossing positions only order the
+// events. The sweep yields candidate pairs; the reported points come from
+// Segment3::Intersection of the original segments, so collinear, parallel
+// and point cases keep its semantics. Pairs that touch only within
+// Vector3::eps and not exactly can be missed.
+//
+// Sets that turn out not to be coplanar fall back to Segment3BVH. The
+// object keeps a pointer to the segments, they must outlive it.
+template <typename TFloat>
+class Segment3PlaneSweep
+{
+public:
+    // Largest distance to the plane, relative to the size of the set, that
+    // still counts as coplanar
+    static constexpr TFloat DefaultTolerance = 64 * std::numeric_limits<TFloat>::epsilon();
+
+public:
+    Segment3PlaneSweep(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        TFloat tolerance = DefaultTolerance
+    );
+
+    // The plane is given, the segments are trusted to lie in it
+    Segment3PlaneSweep(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        const Vector3<TFloat>& normal
+    );
+
+    bool IsPlanar() const;
+
+    const Vector3<TFloat>& Normal() const;
+
+    // Axis dropped by the projection, 0: X, 1: Y, 2: Z
+    int Axis() const;
+
+    // Pairs that touch in the projection, sorted
+    std::vector<Segment3Pair> CandidatePairs() const;
+
+    std::vector<Segment3Hit<TFloat>> SelfIntersections() const;
+
+    // Unit normal of the common plane of all endpoints, false if they are
+    // farther from every plane than tolerance allows. Collinear and single
+    // point sets get some plane through them.
+    static bool FindPlane(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        TFloat tolerance,
+        Vector3<TFloat>& normal
+    );
+
+private:
+    class Sweep;
+
+    void Project();
+
+private:
+    const Segment3<TFloat>* Segments = nullptr;
+    std::size_t             Count    = 0;
+    bool                    Planar   = false;
+    Vector3<TFloat>         Plane;
+    int                     Dropped  = 2;
+};
+
+//---------------------------------------------------------------------------------------
+// State of one run of the sweep. The status is a std::set ordered by the
+// segments' position just right of the current event; it is searched only at
+// endpoint events, where the event point is exact, and crossings swap the
+// stored indices in place.
+template<typename TFloat>
+class Segment3PlaneSweep<TFloat>::Sweep
+{
+public:
+    Sweep(const Segment3PlaneSweep<TFloat>& owner);
+
+    std::vector<Segment3Pair> Run();
+
+private:
+    using Key = std::pair<double, double>;
+
+    // Endpoints are sorted once, crossings found on the way go to a heap
+    struct Endpoint {
+        Key           Position;
+        std::uint32_t Segment;
+        std::uint32_t Kind;
+
+        bool operator<(const Endpoint& other) const;
+    };
+
+    static constexpr std::uint32_t Upper = 0; // left endpoint
+    static constexpr std::uint32_t Lower = 1; // right endpoint
+    static constexpr std::uint32_t Alone = 2; // single point segment
+
+    struct Crossing {
+        Key           Position;
+        std::uint32_t Lower;
+        std::uint32_t Upper;
+
+        bool operator>(const Crossing& other) const;
+    };
+
+    struct Item {
+        mutable std::uint32_t Index;
+    };
+
+    // Stands for the current event point in heterogeneous lookups
+    struct Probe {};
+
+    struct Order {
+        using is_transparent = void;
+
+        const Sweep* Owner;
+
+        bool operator()(const Item& first, const Item& second) const;
+
+        bool operator()(const Item& item, const Probe&) const;
+
+        bool operator()(const Probe&, const Item& item) const;
+    };
+
+    using Status = std::set<Item, Order>;
+
+    Key KeyOf(const Vector3<TFloat>& point) const;
+
+    int Orient(
+        std::uint32_t segment,
+        const Vector3<TFloat>& point
+    ) const;
+
+    int Compare(
+        std::uint32_t inserted,
+        std::uint32_t other
+    ) const;
+
+    bool Crosses(
+        std::uint32_t first,
+        std::uint32_t second
+    ) const;
+
+    void HandleEndpoint(
+        const Endpoint* first,
+        const Endpoint* last
+    );
+
+    void HandleCross(
+        std::uint32_t lower,
+        std::uint32_t upper
+    );
+
+    void Insert(std::uint32_t segment);
+
+    void Check(
+        std::uint32_t lower,
+        std::uint32_t upper
+    );
+
+    void AddPair(
+        std::uint32_t first,
+        std::uint32_t second
+    );
+
+private:
+    using Crossings = std::priority_queue<Crossing, std::vector<Crossing>, std::greater<Crossing>>;
+
+    const Segment3PlaneSweep<TFloat>&      Owner;
+    TFloat Vector3<TFloat>::*              U;
+    TFloat Vector3<TFloat>::*              V;
+    std::vector<Vector3<TFloat>>           Left;
+    std::vector<Vector3<TFloat>>           Right;
+    Crossings                              Pending;
+    Key                                    Current;
+    Vector3<TFloat>                        Point;
+    std::uint32_t                          Inserting = 0;
+    Status                                 Active;
+    std::vector<typename Status::iterator> Where;
+    std::vector<std::uint8_t>              Inside;
+    std::vector<std::uint32_t>             Through;
+    std::vector<std::uint32_t>             Touching;
+    std::vector<Segment3Pair>              Pairs;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3PlaneSweep<TFloat>::Segment3PlaneSweep
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    TFloat tolerance
+) :
+    Segments(segments),
+    Count(count)
+{
+    Planar = FindPlane(segments, count, tolerance, Plane);
+    Project();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3PlaneSweep<TFloat>::Segment3PlaneSweep
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    const Vector3<TFloat>& normal
+) :
+    Segments(segments),
+    Count(count),
+    Planar(true),
+    Plane(normal)
+{
+    Project();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::IsPlanar() const
+{
+    return Planar;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Vector3<TFloat>& Segment3PlaneSweep<TFloat>::Normal() const
+{
+    return Plane;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline int Segment3PlaneSweep<TFloat>::Axis() const
+{
+    return Dropped;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Pair> Segment3PlaneSweep<TFloat>::CandidatePairs() const
+{
+    return Sweep(*this).Run();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> Segment3PlaneSweep<TFloat>::SelfIntersections() const
+{
+    if (!Planar)
+        return Segment3BVH<TFloat>(Segments, Count).SelfIntersections();
+
+    std::vector<Segment3Hit<TFloat>> hits;
+    for (const Segment3Pair& pair : CandidatePairs())
+    {
+        const Vector3<TFloat> point = Segments[pair.First].Intersection(Segments[pair.Second]);
+        if (point.IsValid())
+            hits.push_back({ pair.First, pair.Second, point });
+    }
+
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::FindPlane
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    TFloat tolerance,
+    Vector3<TFloat>& normal
+)
+{
+    normal = Vector3<TFloat>(0, 0, 1);
+    if (count == 0)
+        return true;
+
+    // The farthest endpoint from the first one gives the direction, the
+    // farthest endpoint from that line gives the plane
+    const Vector3<TFloat> origin = segments[0].Start;
+
+    Vector3<TFloat> direction(0);
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+        const Vector3<TFloat> offset = (i % 2 ? segments[i / 2].End : segments[i / 2].Start) - origin;
+        if (offset.SizeSquared() > direction.SizeSquared())
+            direction = offset;
+    }
+
+    if (direction.SizeSquared() == 0)
+        return true;
+
+    Vector3<TFloat> plane(0);
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+        const Vector3<TFloat> offset = (i % 2 ? segments[i / 2].End : segments[i / 2].Start) - origin;
+        const Vector3<TFloat> cross  = direction.Cross(offset);
+        if (cross.SizeSquared() > plane.SizeSquared())
+            plane = cross;
+    }
+
+    // All on one line: any plane through it, the one closest to the
+    // coordinate plane with the smallest direction component dropped
+    if (plane.SizeSquared() == 0)
+    {
+        Vector3<TFloat> axis(0);
+        if (std::abs(direction.X) <= std::abs(direction.Y) && std::abs(direction.X) <= std::abs(direction.Z))
+            axis.X = 1;
+        else if (std::abs(direction.Y) <= std::abs(direction.Z))
+            axis.Y = 1;
+        else
+            axis.Z = 1;
+
+        normal = direction.Cross(axis.Cross(direction)).Normalize();
+        return true;
+    }
+
+    plane.Normalize();
+
+    const TFloat limit = tolerance * direction.Size();
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+        const Vector3<TFloat> offset = (i % 2 ? segments[i / 2].End : segments[i / 2].Start) - origin;
+        if (std::abs(plane.Dot(offset)) > limit)
+            return false;
+    }
+
+    normal = plane;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PlaneSweep<TFloat>::Project()
+{
+    const TFloat x = std::abs(Plane.X);
+    const TFloat y = std::abs(Plane.Y);
+    const TFloat z = std::abs(Plane.Z);
+
+    Dropped = x >= y && x >= z ? 0 : (y >= z ? 1 : 2);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3PlaneSweep<TFloat>::Sweep::Sweep
+(
+    const Segment3PlaneSweep<TFloat>& owner
+) :
+    Owner(owner),
+    Active(Order{ this })
+{
+    TFloat Vector3<TFloat>::* const axes[3] = {
+        &Vector3<TFloat>::X,
+        &Vector3<TFloat>::Y,
+        &Vector3<TFloat>::Z,
+    };
+
+    // Same orientation as the projection of Predicates::Cross
+    U = axes[(owner.Dropped + 1) % 3];
+    V = axes[(owner.Dropped + 2) % 3];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Pair> Segment3PlaneSweep<TFloat>::Sweep::Run()
+{
+    const std::size_t count = Owner.Count;
+
+    Left  .resize(count);
+    Right .resize(count);
+    Where .resize(count);
+    Inside.assign(count, 0);
+
+    std::vector<Endpoint> endpoints;
+    endpoints.reserve(2 * count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Segment3<TFloat>& segment = Owner.Segments[i];
+        const std::uint32_t     index   = static_cast<std::uint32_t>(i);
+
+        const bool forward = KeyOf(segment.Start) <= KeyOf(segment.End);
+        Left [i] = forward ? segment.Start : segment.End;
+        Right[i] = forward ? segment.End   : segment.Start;
+
+        if (KeyOf(Left[i]) == KeyOf(Right[i])) {
+            endpoints.push_back({ KeyOf(Left[i]), index, Alone });
+            continue;
+        }
+
+        endpoints.push_back({ KeyOf(Left [i]), index, Upper });
+        endpoints.push_back({ KeyOf(Right[i]), index, Lower });
+    }
+
+    std::sort(endpoints.begin(), endpoints.end());
+
+    // Crossings at an event point are applied before its endpoints, they
+    // happen just left of it
+    const Endpoint* next = endpoints.data();
+    const Endpoint* end  = endpoints.data() + endpoints.size();
+    while (next != end || !Pending.empty())
+    {
+        Current = next == end || (!Pending.empty() && Pending.top().Position < next->Position) ?
+            Pending.top().Position :
+            next->Position;
+
+        while (!Pending.empty() && Pending.top().Position == Current) {
+            const Crossing crossing = Pending.top();
+            Pending.pop();
+            HandleCross(crossing.Lower, crossing.Upper);
+        }
+
+        const Endpoint* first = next;
+        while (next != end && next->Position == Current)
+            ++next;
+
+        if (first != next)
+            HandleEndpoint(first, next);
+    }
+
+    std::sort(Pairs.begin(), Pairs.end());
+    Pairs.erase(std::unique(Pairs.begin(), Pairs.end()), Pairs.end());
+
+    return std::move(Pairs);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline typename Segment3PlaneSweep<TFloat>::Sweep::Key Segment3PlaneSweep<TFloat>::Sweep::KeyOf
+(
+    const Vector3<TFloat>& point
+)
+const
+{
+    return Key(point.*U, point.*V);
+}
+
+//---------------------------------------------------------------------------------------
+// Positive when the point is above the segment, i.e. to the left of its
+// direction from the left endpoint to the right one
+template<typename TFloat>
+inline int Segment3PlaneSweep<TFloat>::Sweep::Orient
+(
+    std::uint32_t segment,
+    const Vector3<TFloat>& point
+)
+const
+{
+    return Predicates::Cross(Left[segment], Right[segment], Left[segment], point, Owner.Dropped);
+}
+
+//---------------------------------------------------------------------------------------
+// Order of a segment through the current endpoint against one in the status,
+// just right of the endpoint. Collinear overlapping segments are ordered by
+// index.
+template<typename TFloat>
+inline int Segment3PlaneSweep<TFloat>::Sweep::Compare
+(
+    std::uint32_t inserted,
+    std::uint32_t other
+)
+const
+{
+    const int side = Orient(other, Point);
+    if (side != 0)
+        return side;
+
+    const int direction = Orient(other, Right[inserted]);
+    if (direction != 0)
+        return direction;
+
+    return inserted < other ? -1 : 1;
+}
+
+//---------------------------------------------------------------------------------------
+// Proper crossing: each segment has the endpoints of the other strictly on
+// both sides. Every other contact involves an endpoint and is found there.
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::Sweep::Crosses
+(
+    std::uint32_t first,
+    std::uint32_t second
+)
+const
+{
+    return
+        Orient(first,  Left[second]) * Orient(first,  Right[second]) < 0 &&
+        Orient(second, Left[first])  * Orient(second, Right[first])  < 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PlaneSweep<TFloat>::Sweep::HandleEndpoint
+(
+    const Endpoint* first,
+    const Endpoint* last
+)
+{
+    const std::uint32_t segment = first->Segment;
+    Point = first->Kind == Lower ? Right[segment] : Left[segment];
+
+    // Segments through the point are adjacent in the status
+    Through.clear();
+    for (auto it = Active.lower_bound(Probe()); it != Active.end() && Orient(it->Index, Point) == 0; ++it)
+        Through.push_back(it->Index);
+
+    Touching = Through;
+    for (const Endpoint* endpoint = first; endpoint != last; ++endpoint)
+        if (endpoint->Kind != Lower)
+            Touching.push_back(endpoint->Segment);
+
+    for (std::size_t i = 0; i < Touching.size(); ++i)
+        for (std::size_t j = i + 1; j < Touching.size(); ++j)
+            AddPair(Touching[i], Touching[j]);
+
+    for (const std::uint32_t segment : Through) {
+        Active.erase(Where[segment]);
+        Inside[segment] = 0;
+    }
+
+    std::size_t inserted = 0;
+    for (const std::uint32_t segment : Through)
+        if (KeyOf(Right[segment]) != Current) {
+            Insert(segment);
+            ++inserted;
+        }
+
+    for (const Endpoint* endpoint = first; endpoint != last; ++endpoint)
+        if (endpoint->Kind == Upper) {
+            Insert(endpoint->Segment);
+            ++inserted;
+        }
+
+    auto lowest = Active.lower_bound(Probe());
+    if (inserted == 0) {
+        if (lowest != Active.begin() && lowest != Active.end())
+            Check(std::prev(lowest)->Index, lowest->Index);
+        return;
+    }
+
+    auto highest = lowest;
+    while (std::next(highest) != Active.end() && Orient(std::next(highest)->Index, Point) == 0)
+        ++highest;
+
+    if (lowest != Active.begin())
+        Check(std::prev(lowest)->Index, lowest->Index);
+
+    if (std::next(highest) != Active.end())
+        Check(highest->Index, std::next(highest)->Index);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PlaneSweep<TFloat>::Sweep::HandleCross
+(
+    std::uint32_t lower,
+    std::uint32_t upper
+)
+{
+    // The pair may have been separated or swapped since the event was added
+    if (!Inside[lower] || !Inside[upper] || std::next(Where[lower]) != Where[upper])
+        return;
+
+    if (Orient(lower, Right[upper]) >= 0)
+        return;
+
+    const typename Status::iterator below = Where[lower];
+    const typename Status::iterator above = Where[upper];
+
+    below->Index  = upper;
+    above->Index  = lower;
+    Where[upper] = below;
+    Where[lower] = above;
+
+    if (below != Active.begin())
+        Check(std::prev(below)->Index, upper);
+
+    if (std::next(above) != Active.end())
+        Check(lower, std::next(above)->Index);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PlaneSweep<TFloat>::Sweep::Insert
+(
+    std::uint32_t segment
+)
+{
+    Inserting = segment;
+    Where[segment]  = Active.insert(Item{ segment }).first;
+    Inside[segment] = 1;
+}
+
+//---------------------------------------------------------------------------------------
+// Every pair that becomes adjacent is a candidate. A crossing pair still in
+// the order of before the crossing gets a swap event at the crossing point,
+// or at the current event if rounding puts the point behind it.
+template<typename TFloat>
+inline void Segment3PlaneSweep<TFloat>::Sweep::Check
+(
+    std::uint32_t lower,
+    std::uint32_t upper
+)
+{
+    AddPair(lower, upper);
+
+    if (!Crosses(lower, upper) || Orient(lower, Right[upper]) >= 0)
+        return;
+
+    const double ax = Left [lower].*U, ay = Left [lower].*V;
+    const double bx = Right[lower].*U, by = Right[lower].*V;
+    const double cx = Left [upper].*U, cy = Left [upper].*V;
+    const double dx = Right[upper].*U, dy = Right[upper].*V;
+
+    const double t = ((cx - ax) * (dy - cy) - (cy - ay) * (dx - cx)) /
+                     ((bx - ax) * (dy - cy) - (by - ay) * (dx - cx));
+
+    Key key(ax + t * (bx - ax), ay + t * (by - ay));
+    if (key < Current)
+        key = Current;
+
+    Pending.push({ key, lower, upper });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3PlaneSweep<TFloat>::Sweep::AddPair
+(
+    std::uint32_t first,
+    std::uint32_t second
+)
+{
+    if (first > second)
+        std::swap(first, second);
+
+    Pairs.push_back({ first, second });
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::Sweep::Endpoint::operator<
+(
+    const Endpoint& other
+)
+const
+{
+    return Position < other.Position;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::Sweep::Crossing::operator>
+(
+    const Crossing& other
+)
+const
+{
+    return Position > other.Position;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::Sweep::Order::operator()
+(
+    const Item& first,
+    const Item& second
+)
+const
+{
+    if (first.Index == Owner->Inserting)
+        return Owner->Compare(first.Index, second.Index) < 0;
+
+    if (second.Index == Owner->Inserting)
+        return Owner->Compare(second.Index, first.Index) > 0;
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::Sweep::Order::operator()
+(
+    const Item& item,
+    const Probe&
+)
+const
+{
+    return Owner->Orient(item.Index, Owner->Point) > 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3PlaneSweep<TFloat>::Sweep::Order::operator()
+(
+    const Probe&,
+    const Item& item
+)
+const
+{
+    return Owner->Orient(item.Index, Owner->Point) < 0;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3PlaneSweepF = Segment3PlaneSweep<float>;
+using Segment3PlaneSweepD = Segment3PlaneSweep<double>;
@@ -0,0 +1,132 @@
+#pragma once
+#include "Vector3.h"
+#include "Segment3Trace.h"
+#include <cstdint>
+
+//---------------------------------------------------------------------------------------
+// Outcome of Segment3::IntersectionResult. Hits come first, so a hit test is
+// one byte compare and sorting by outcome puts the hits in front.
+enum class Segment3Outcome : std::uint8_t
+{
+    Crossing,   // lines intersect inside both segments
+    Overlap,    // segments on the same line share a part
+    PointOn,    // one segment is a point lying on the other
+    AABBReject, // bounding boxes do not overlap, first of the misses
+    Skew,       // skew lines
+    Parallel,   // parallel lines
+    OutOfRange, // lines intersect outside of a segment
+    PointOff,   // one segment is a point off the other
+};
+
+//---------------------------------------------------------------------------------------
+const char* Segment3OutcomeName(Segment3Outcome outcome);
+
+//---------------------------------------------------------------------------------------
+// Result of first.IntersectionResult(second) with the parameters of the
+// lines first.Start + K * (first.End - first.Start) and second.Start +
+// T * (second.End - second.Start), the same K and T as in the trace records.
+// For Overlap the shared part is [K, KEnd] on the first segment and Point
+// is its start, otherwise KEnd == K. K and T are also set for OutOfRange,
+// where they are NaN if the projection plane of Intersection was degenerate;
+// the other misses leave the numbers NaN.
+template <typename TFloat>
+struct Segment3Result
+{
+    Segment3Outcome Outcome;
+    TFloat          K;
+    TFloat          T;
+    TFloat          KEnd;
+    Vector3<TFloat> Point;
+
+    bool IsHit() const;
+
+    // By outcome only, hits first
+    bool operator<(const Segment3Result<TFloat>& other) const;
+};
+
+//---------------------------------------------------------------------------------------
+// Keeps the last decision and line parameters of a traced Intersection call,
+// which is all IntersectionResult needs to know
+struct Segment3ResultTracer
+{
+    Segment3Step Last = Segment3Step::Segments;
+    double       T    = 0.;
+    double       K    = 0.;
+
+    void operator()(Segment3Step step);
+
+    void operator()(
+        Segment3Step step,
+        char u,
+        char v,
+        double t,
+        double k
+    );
+};
+
+//---------------------------------------------------------------------------------------
+inline const char* Segment3OutcomeName
+(
+    Segment3Outcome outcome
+)
+{
+    switch (outcome)
+    {
+    case Segment3Outcome::Crossing:   return "Crossing";
+    case Segment3Outcome::Overlap:    return "Overlap";
+    case Segment3Outcome::PointOn:    return "Point on segment";
+    case Segment3Outcome::AABBReject: return "Bounding boxes do not overlap";
+    case Segment3Outcome::Skew:       return "Skew lines";
+    case Segment3Outcome::Parallel:   return "Parallel lines";
+    case Segment3Outcome::OutOfRange: return "Intersection is outside the segments";
+    case Segment3Outcome::PointOff:   return "Point is not on the segment";
+    }
+
+    return "";
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Result<TFloat>::IsHit() const
+{
+    return Outcome < Segment3Outcome::AABBReject;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Result<TFloat>::operator<
+(
+    const Segment3Result<TFloat>& other
+)
+const
+{
+    return Outcome < other.Outcome;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3ResultTracer::operator()
+(
+    Segment3Step step
+)
+{
+    Last = step;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3ResultTracer::operator()
+(
+    Segment3Step step,
+    char,
+    char,
+    double t,
+    double k
+)
+{
+    Last = step;
+    T    = t;
+    K    = k;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3ResultF = Segment3Result<float>;
+using Segment3ResultD = Segment3Result<double>;
@@ -0,0 +1,845 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3Batch.h"
+#include "Segment3BVH.h"
+#include "Vector3Batch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//---------------------------------------------------------------------------------------
+// Binary protocol of Segment3Server, native byte order. A request is a
+// header followed by Count records, a response the same:
+//     Query: Count Segment3D in, Segment3QueryHit out for every hit of every
+//            query segment against the set, by query and set index
+//     Pairs: 2 * Count Segment3D in, Count Vector3D out, NaN for a miss
+//     Stats: nothing in, Count bytes of JSON latency statistics out
+//     Stop:  nothing in, an empty response, then the server returns
+enum class Segment3RequestKind : std::uint32_t
+{
+    Query = 1,
+    Pairs = 2,
+    Stats = 3,
+    Stop  = 4,
+};
+
+//---------------------------------------------------------------------------------------
+struct Segment3RequestHeader
+{
+    static constexpr std::uint32_t Signature = 0x51523353; // "S3RQ"
+
+    std::uint32_t Magic;
+    std::uint32_t Kind;
+    std::uint64_t Count;
+};
+
+//---------------------------------------------------------------------------------------
+struct Segment3ResponseHeader
+{
+    static constexpr std::uint32_t Signature = 0x53523353; // "S3RS"
+
+    std::uint32_t Magic;
+    std::uint32_t Status; // 0 if the request was served
+    std::uint64_t Count;
+};
+
+//---------------------------------------------------------------------------------------
+// Hit of query segment Query with set segment Segment,
+// Point is query.Intersection(set[Segment])
+struct Segment3QueryHit
+{
+    std::uint64_t Query;
+    std::uint64_t Segment;
+    Vector3D      Point;
+};
+
+//---------------------------------------------------------------------------------------
+// Latencies of one request kind from the arrival of the header to the last
+// byte of the response, in a histogram of powers of two nanoseconds: bucket 0
+// counts zero, bucket b > 0 the latencies in [2^(b-1), 2^b).
+struct Segment3LatencyStats
+{
+    static constexpr std::size_t Buckets = 48;
+
+    std::uint64_t Requests  = 0;
+    std::uint64_t Records   = 0;
+    std::uint64_t TotalNs   = 0;
+    std::uint64_t MinNs     = 0;
+    std::uint64_t MaxNs     = 0;
+    std::uint64_t Histogram[Buckets] = {};
+
+    void Add(std::uint64_t nanoseconds, std::uint64_t records);
+
+    // Upper bound of the bucket holding the given fraction of the requests
+    std::uint64_t PercentileNs(double fraction) const;
+
+    void WriteJson(std::ostream& out) const;
+};
+
+//---------------------------------------------------------------------------------------
+// Long-running local server holding a segment set indexed by a Segment3BVH,
+// so that clients do not reload the geometry and rebuild the index for every
+// short request. Connections are multiplexed with poll on one thread over
+// non-blocking sockets: every connection keeps the part of its request read so
+// far and the part of its response still to write, so a client that stalls
+// mid-request or stops reading delays only itself. A request is served as a
+// whole once all its records have arrived. Buffers are kept between requests,
+// so a steady stream of requests of similar size allocates nothing. A request
+// that cannot be allocated is answered with status 1. POSIX only, empty on
+// Windows.
+class Segment3Server
+{
+public:
+    // Requests whose records take more bytes are refused and the connection closed
+    static constexpr std::uint64_t MaxRequestBytes = std::uint64_t(1) << 28;
+
+public:
+    Segment3Server(
+        const Segment3D* segments,
+        std::size_t count
+    );
+
+    ~Segment3Server();
+
+    Segment3Server(const Segment3Server&) = delete;
+
+    Segment3Server& operator=(const Segment3Server&) = delete;
+
+    // Binds the socket, replacing a stale socket file at path
+    bool Listen(const char* path);
+
+    // Serves connections until a Stop request, false if polling failed
+    bool Serve();
+
+    const Segment3LatencyStats& Stats(Segment3RequestKind kind) const;
+
+    std::string StatsJson() const;
+
+    // Reads and writes the whole buffer, retrying short transfers
+    static bool ReadAll(int socket, void* data, std::size_t bytes);
+
+    static bool WriteAll(int socket, const void* data, std::size_t bytes);
+
+private:
+    // One client: the request read so far and the response written so far
+    struct Connection
+    {
+        int                    Socket   = -1;
+        Segment3RequestHeader  Header   = {};
+        std::size_t            Received = 0; // bytes of header and records
+        std::size_t            Expected = 0; // bytes of records
+        std::vector<Segment3D> Input;
+        std::vector<char>      Output;
+        std::size_t            Sent     = 0;
+        bool                   Closing  = false; // close once Output is sent
+        Segment3LatencyStats*  Timed    = nullptr;
+        std::chrono::steady_clock::time_point Start;
+    };
+
+    // Both false when the connection is to be closed
+    bool Receive(Connection& connection);
+
+    bool Send(Connection& connection);
+
+    // Checks the header and sizes the input, false if the request is refused
+    bool Accept(Connection& connection);
+
+    void Handle(Connection& connection);
+
+    void Respond(Connection& connection, std::uint32_t status, std::uint64_t count, const void* data, std::size_t bytes);
+
+    void Query(const std::vector<Segment3D>& input);
+
+    void Pairs(const std::vector<Segment3D>& input);
+
+private:
+    std::vector<Segment3D>        Segments;
+    Segment3BVH<double>           Index;
+    std::string                   Path;
+    int                           Listener = -1;
+    bool                          Stopping = false;
+
+    std::vector<Segment3QueryHit> Hits;
+    Segment3BatchD                First;
+    Segment3BatchD                Second;
+    Vector3BatchD                 Solved;
+    std::vector<Vector3D>         Points;
+
+    Segment3LatencyStats          QueryStats;
+    Segment3LatencyStats          PairsStats;
+};
+
+//---------------------------------------------------------------------------------------
+// Blocking client of Segment3Server, one request at a time
+class Segment3Client
+{
+public:
+    Segment3Client() = default;
+
+    ~Segment3Client();
+
+    Segment3Client(const Segment3Client&) = delete;
+
+    Segment3Client& operator=(const Segment3Client&) = delete;
+
+    bool Connect(const char* path);
+
+    void Close();
+
+    bool Query(
+        const Segment3D* segments,
+        std::size_t count,
+        std::vector<Segment3QueryHit>& hits
+    );
+
+    // first[i].Intersection(second[i]) on the server
+    bool Pairs(
+        const Segment3D* first,
+        const Segment3D* second,
+        std::size_t count,
+        std::vector<Vector3D>& points
+    );
+
+    bool Stats(std::string& json);
+
+    bool Stop();
+
+private:
+    bool Send(Segment3RequestKind kind, std::uint64_t count, const void* data, std::size_t bytes);
+
+    bool Receive(std::uint64_t& count);
+
+private:
+    int                    Socket = -1;
+    std::vector<Segment3D> Request;
+};
+
+//---------------------------------------------------------------------------------------
+inline void Segment3LatencyStats::Add
+(
+    std::uint64_t nanoseconds,
+    std::uint64_t records
+)
+{
+    MinNs = Requests == 0 ? nanoseconds : std::min(MinNs, nanoseconds);
+    MaxNs = std::max(MaxNs, nanoseconds);
+    TotalNs += nanoseconds;
+    Records += records;
+    ++Requests;
+
+    std::size_t bucket = 0;
+    while (bucket + 1 < Buckets && (nanoseconds >> bucket) != 0)
+        ++bucket;
+    ++Histogram[bucket];
+}
+
+//---------------------------------------------------------------------------------------
+inline std::uint64_t Segment3LatencyStats::PercentileNs
+(
+    double fraction
+)
+const
+{
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < Buckets && Requests > 0; ++bucket) {
+        seen += Histogram[bucket];
+        if (seen >= fraction * Requests)
+            return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+    }
+
+    return MaxNs;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3LatencyStats::WriteJson
+(
+    std::ostream& out
+)
+const
+{
+    out << "{ "
+        << "\"requests\": " << Requests << ", "
+        << "\"records\": " << Records << ", "
+        << "\"ns\": { "
+        << "\"min\": " << MinNs << ", "
+        << "\"mean\": " << (Requests > 0 ? TotalNs / Requests : 0) << ", "
+        << "\"p50\": " << PercentileNs(0.5) << ", "
+        << "\"p99\": " << PercentileNs(0.99) << ", "
+        << "\"max\": " << MaxNs << " }, "
+        << "\"histogram\": [";
+
+    for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+        out << (bucket > 0 ? ", " : "") << Histogram[bucket];
+
+    out << "] }";
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3Server::Segment3Server
+(
+    const Segment3D* segments,
+    std::size_t count
+) :
+    Segments(segments, segments + count)
+{
+    Index.Build(Segments.data(), Segments.size());
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3Server::~Segment3Server()
+{
+    if (Listener >= 0) {
+        ::close(Listener);
+        ::unlink(Path.c_str());
+    }
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Server::Listen
+(
+    const char* path
+)
+{
+    sockaddr_un address = {};
+    if (std::strlen(path) >= sizeof(address.sun_path))
+        return false;
+
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path);
+
+    Listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Listener < 0)
+        return false;
+
+    ::unlink(path);
+    if (::bind(Listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(Listener, 64) != 0)
+    {
+        ::close(Listener);
+        Listener = -1;
+        return false;
+    }
+
+    Path = path;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Server::Serve()
+{
+    std::vector<pollfd>     sockets(1, { Listener, POLLIN, 0 });
+    std::vector<Connection> connections(1);
+
+    Stopping = false;
+    while (!Stopping)
+    {
+        // A connection with a pending response is not read until it is sent
+        for (std::size_t i = 1; i < sockets.size(); ++i)
+            sockets[i].events = connections[i].Sent < connections[i].Output.size() ? POLLOUT : POLLIN;
+
+        if (::poll(sockets.data(), static_cast<nfds_t>(sockets.size()), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (std::size_t i = sockets.size(); i-- > 1;) {
+            const short events = sockets[i].revents;
+            if (events == 0)
+                continue;
+
+            const bool open =
+                (events & POLLOUT) ? Send(connections[i]) :
+                (events & POLLIN)  ? Receive(connections[i]) :
+                false;
+
+            if (!open) {
+                ::close(sockets[i].fd);
+                sockets    .erase(sockets    .begin() + i);
+                connections.erase(connections.begin() + i);
+            }
+        }
+
+        if (sockets[0].revents & POLLIN) {
+            const int client = ::accept(Listener, nullptr, nullptr);
+            if (client >= 0 && ::fcntl(client, F_SETFL, ::fcntl(client, F_GETFL) | O_NONBLOCK) == 0) {
+                sockets.push_back({ client, POLLIN, 0 });
+                connections.emplace_back();
+                connections.back().Socket = client;
+            }
+            else if (client >= 0)
+                ::close(client);
+        }
+    }
+
+    for (std::size_t i = 1; i < sockets.size(); ++i)
+        ::close(sockets[i].fd);
+
+    return Stopping;
+}
+
+//---------------------------------------------------------------------------------------
+inline const Segment3LatencyStats& Segment3Server::Stats
+(
+    Segment3RequestKind kind
+)
+const
+{
+    return kind == Segment3RequestKind::Query ? QueryStats : PairsStats;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::string Segment3Server::StatsJson() const
+{
+    std::ostringstream out;
+    out << "{\n"
+        << "  \"segments\": " << Segments.size() << ",\n"
+        << "  \"query\": ";
+    QueryStats.WriteJson(out);
+    out << ",\n"
+        << "  \"pairs\": ";
+    PairsStats.WriteJson(out);
+    out << "\n"
+        << "}\n";
+
+    return out.str();
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Server::ReadAll
+(
+    int socket,
+    void* data,
+    std::size_t bytes
+)
+{
+    char* next = static_cast<char*>(data);
+    while (bytes > 0) {
+        const ssize_t read = ::recv(socket, next, bytes, 0);
+        if (read < 0 && errno == EINTR)
+            continue;
+        if (read <= 0)
+            return false;
+
+        next  += read;
+        bytes -= static_cast<std::size_t>(read);
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// A client gone mid-response must not kill the server with SIGPIPE
+inline bool Segment3Server::WriteAll
+(
+    int socket,
+    const void* data,
+    std::size_t bytes
+)
+{
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif // MSG_NOSIGNAL
+
+    const char* next = static_cast<const char*>(data);
+    while (bytes > 0) {
+        const ssize_t written = ::send(socket, next, bytes, flags);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        next  += written;
+        bytes -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// Reads what the socket holds; a complete request is served and its response
+// sent as far as the socket takes it
+inline bool Segment3Server::Receive
+(
+    Connection& connection
+)
+{
+    const std::size_t head = sizeof(Segment3RequestHeader);
+
+    while (connection.Received < head + connection.Expected)
+    {
+        char* next = connection.Received < head ?
+            reinterpret_cast<char*>(&connection.Header) + connection.Received :
+            reinterpret_cast<char*>(connection.Input.data()) + (connection.Received - head);
+        const std::size_t bytes = connection.Received < head ?
+            head - connection.Received :
+            head + connection.Expected - connection.Received;
+
+        const ssize_t read = ::recv(connection.Socket, next, bytes, 0);
+        if (read < 0 && errno == EINTR)
+            continue;
+        if (read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (read <= 0)
+            return false;
+
+        connection.Received += static_cast<std::size_t>(read);
+        if (connection.Received == head && !Accept(connection))
+            return Send(connection);
+    }
+
+    Handle(connection);
+    return Send(connection);
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Server::Send
+(
+    Connection& connection
+)
+{
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif // MSG_NOSIGNAL
+
+    while (connection.Sent < connection.Output.size()) {
+        const ssize_t written = ::send(
+            connection.Socket,
+            connection.Output.data() + connection.Sent,
+            connection.Output.size() - connection.Sent,
+            flags
+        );
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (written <= 0)
+            return false;
+
+        connection.Sent += static_cast<std::size_t>(written);
+    }
+
+    if (connection.Timed) {
+        const std::chrono::nanoseconds latency = std::chrono::steady_clock::now() - connection.Start;
+        connection.Timed->Add(static_cast<std::uint64_t>(latency.count()), connection.Header.Count);
+    }
+
+    connection.Output.clear();
+    connection.Sent     = 0;
+    connection.Received = 0;
+    connection.Expected = 0;
+    connection.Timed    = nullptr;
+
+    return !connection.Closing;
+}
+
+//---------------------------------------------------------------------------------------
+// The cap is on bytes, so a Pairs request holds half the records of a Query
+inline bool Segment3Server::Accept
+(
+    Connection& connection
+)
+{
+    const Segment3RequestHeader& header = connection.Header;
+    connection.Start = std::chrono::steady_clock::now();
+
+    bool known = true;
+    std::uint64_t record = 0;
+    switch (static_cast<Segment3RequestKind>(header.Kind))
+    {
+    case Segment3RequestKind::Query: record = sizeof(Segment3D);     break;
+    case Segment3RequestKind::Pairs: record = 2 * sizeof(Segment3D); break;
+    case Segment3RequestKind::Stats:
+    case Segment3RequestKind::Stop:  break;
+    default:                         known = false;                  break;
+    }
+
+    if (!known || header.Magic != Segment3RequestHeader::Signature ||
+        (record != 0 && header.Count > MaxRequestBytes / record))
+    {
+        connection.Closing = true;
+        Respond(connection, 1, 0, nullptr, 0);
+        return false;
+    }
+
+    try {
+        connection.Expected = static_cast<std::size_t>(header.Count * record);
+        connection.Input.resize(connection.Expected / sizeof(Segment3D));
+    }
+    catch (const std::bad_alloc&) {
+        std::vector<Segment3D>().swap(connection.Input);
+        connection.Closing = true;
+        Respond(connection, 1, 0, nullptr, 0);
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3Server::Handle
+(
+    Connection& connection
+)
+{
+    try {
+        switch (static_cast<Segment3RequestKind>(connection.Header.Kind))
+        {
+        case Segment3RequestKind::Query:
+            Query(connection.Input);
+            Respond(connection, 0, Hits.size(), Hits.data(), Hits.size() * sizeof(Segment3QueryHit));
+            connection.Timed = &QueryStats;
+            break;
+
+        case Segment3RequestKind::Pairs:
+            Pairs(connection.Input);
+            Respond(connection, 0, Points.size(), Points.data(), Points.size() * sizeof(Vector3D));
+            connection.Timed = &PairsStats;
+            break;
+
+        case Segment3RequestKind::Stats: {
+            const std::string json = StatsJson();
+            Respond(connection, 0, json.size(), json.data(), json.size());
+            break;
+        }
+
+        case Segment3RequestKind::Stop:
+            Stopping = true;
+            Respond(connection, 0, 0, nullptr, 0);
+            break;
+        }
+    }
+    catch (const std::bad_alloc&) {
+        // Give back what the failed request grew before answering it
+        std::vector<Segment3QueryHit>().swap(Hits);
+        std::vector<Vector3D>().swap(Points);
+        std::vector<char>().swap(connection.Output);
+        connection.Timed = nullptr;
+        Respond(connection, 1, 0, nullptr, 0);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Queues the response; it is copied, as Hits and Points serve the next request
+inline void Segment3Server::Respond
+(
+    Connection& connection,
+    std::uint32_t status,
+    std::uint64_t count,
+    const void* data,
+    std::size_t bytes
+)
+{
+    const Segment3ResponseHeader header = { Segment3ResponseHeader::Signature, status, count };
+
+    connection.Output.resize(sizeof(header) + bytes);
+    std::memcpy(connection.Output.data(), &header, sizeof(header));
+    if (bytes > 0)
+        std::memcpy(connection.Output.data() + sizeof(header), data, bytes);
+    connection.Sent = 0;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3Server::Query
+(
+    const std::vector<Segment3D>& input
+)
+{
+    Hits.clear();
+
+    for (std::size_t query = 0; query < input.size(); ++query) {
+        const Segment3D& segment = input[query];
+        const std::size_t first = Hits.size();
+
+        Index.Query(segment.ToAABB(), [&](std::size_t i) {
+            const Vector3D point = segment.Intersection(Segments[i]);
+            if (point.IsValid())
+                Hits.push_back({ query, i, point });
+        });
+
+        std::sort(Hits.begin() + first, Hits.end(), [](const Segment3QueryHit& a, const Segment3QueryHit& b) {
+            return a.Segment < b.Segment;
+        });
+    }
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3Server::Pairs
+(
+    const std::vector<Segment3D>& input
+)
+{
+    const std::size_t count = input.size() / 2;
+
+    First .Resize(count);
+    Second.Resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        First .Set(i, input[2 * i]);
+        Second.Set(i, input[2 * i + 1]);
+    }
+
+    First.Intersection(Second, Solved);
+
+    Points.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+        Points[i] = Solved.Get(i);
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3Client::~Segment3Client()
+{
+    Close();
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Connect
+(
+    const char* path
+)
+{
+    Close();
+
+    sockaddr_un address = {};
+    if (std::strlen(path) >= sizeof(address.sun_path))
+        return false;
+
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path);
+
+    Socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Socket < 0)
+        return false;
+
+    if (::connect(Socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3Client::Close()
+{
+    if (Socket >= 0)
+        ::close(Socket);
+
+    Socket = -1;
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Query
+(
+    const Segment3D* segments,
+    std::size_t count,
+    std::vector<Segment3QueryHit>& hits
+)
+{
+    std::uint64_t found = 0;
+    if (!Send(Segment3RequestKind::Query, count, segments, count * sizeof(Segment3D)) || !Receive(found))
+        return false;
+
+    hits.resize(static_cast<std::size_t>(found));
+    return Segment3Server::ReadAll(Socket, hits.data(), hits.size() * sizeof(Segment3QueryHit));
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Pairs
+(
+    const Segment3D* first,
+    const Segment3D* second,
+    std::size_t count,
+    std::vector<Vector3D>& points
+)
+{
+    Request.resize(2 * count);
+    for (std::size_t i = 0; i < count; ++i) {
+        Request[2 * i]     = first[i];
+        Request[2 * i + 1] = second[i];
+    }
+
+    std::uint64_t solved = 0;
+    if (!Send(Segment3RequestKind::Pairs, count, Request.data(), Request.size() * sizeof(Segment3D)) ||
+        !Receive(solved))
+        return false;
+
+    points.resize(static_cast<std::size_t>(solved));
+    return Segment3Server::ReadAll(Socket, points.data(), points.size() * sizeof(Vector3D));
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Stats
+(
+    std::string& json
+)
+{
+    std::uint64_t bytes = 0;
+    if (!Send(Segment3RequestKind::Stats, 0, nullptr, 0) || !Receive(bytes))
+        return false;
+
+    json.resize(static_cast<std::size_t>(bytes));
+    return Segment3Server::ReadAll(Socket, &json[0], json.size());
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Stop()
+{
+    std::uint64_t count = 0;
+    return Send(Segment3RequestKind::Stop, 0, nullptr, 0) && Receive(count);
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Send
+(
+    Segment3RequestKind kind,
+    std::uint64_t count,
+    const void* data,
+    std::size_t bytes
+)
+{
+    const Segment3RequestHeader header = {
+        Segment3RequestHeader::Signature,
+        static_cast<std::uint32_t>(kind),
+        count
+    };
+
+    return
+        Socket >= 0 &&
+        Segment3Server::WriteAll(Socket, &header, sizeof(header)) &&
+        Segment3Server::WriteAll(Socket, data, bytes);
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3Client::Receive
+(
+    std::uint64_t& count
+)
+{
+    Segment3ResponseHeader header;
+    if (!Segment3Server::ReadAll(Socket, &header, sizeof(header)))
+        return false;
+
+    count = header.Count;
+    return header.Magic == Segment3ResponseHeader::Signature && header.Status == 0;
+}
+#endif // _WIN32
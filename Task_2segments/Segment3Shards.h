@@ -0,0 +1,405 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3BVH.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // _WIN32
+
+//---------------------------------------------------------------------------------------
+// All-pairs query split into spatial shards: slabs along the widest axis of
+// the segment set, cut at quantiles of the box centers so that the shards get
+// about as many segments each. A segment goes to every slab its box touches.
+// The pair of overlapping boxes is reported only by the shard of the lower
+// end of their common extent along the axis, a point both boxes contain, so
+// every hit is found exactly once without any exchange between shards and
+// the merged output is the one of Segment3BVH::SelfIntersections.
+// A shard depends only on the segments and the slab bounds, so it can run in
+// a worker process; the result goes back as a stream of Segment3Hit records.
+template <typename TFloat>
+class Segment3Shards
+{
+public:
+    Segment3Shards() = default;
+
+    Segment3Shards(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        std::size_t shards
+    );
+
+    // The segments are used in place and must outlive the shards
+    void Build(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        std::size_t shards
+    );
+
+    std::size_t Size() const;
+
+    int Axis() const;
+
+    // Lower bounds of slabs 1 .. Size() - 1 along Axis()
+    const std::vector<TFloat>& Bounds() const;
+
+    // Indices of the segments of a shard, increasing
+    const std::vector<std::uint32_t>& Members(std::size_t shard) const;
+
+    // Shard reporting the pair, for boxes in Segment3::ToAABB() form
+    std::size_t Owner(
+        const Segment3<TFloat>& firstBox,
+        const Segment3<TFloat>& secondBox
+    ) const;
+
+    // Hits owned by one shard with indices into the whole set, sorted
+    void ShardIntersections(
+        std::size_t shard,
+        std::vector<Segment3Hit<TFloat>>& hits
+    ) const;
+
+    // Hits of all shards, sorted. With processes every shard runs in a forked
+    // worker that writes its hits into a pipe; where fork is not available
+    // (Windows) or fails the shards run in this process one after another.
+    // False if a worker failed, hits are then incomplete.
+    bool SelfIntersections(
+        std::vector<Segment3Hit<TFloat>>& hits,
+        bool processes = true
+    ) const;
+
+private:
+    std::size_t Slab(TFloat coordinate) const;
+
+    TFloat Low(const Segment3<TFloat>& box) const;
+
+    TFloat High(const Segment3<TFloat>& box) const;
+
+#ifndef _WIN32
+    static bool WriteAll(int file, const void* data, std::size_t bytes);
+
+    static bool ReadAll(int file, std::vector<Segment3Hit<TFloat>>& hits);
+#endif // _WIN32
+
+private:
+    const Segment3<TFloat>*                 Segments = nullptr;
+    std::size_t                             Count    = 0;
+    int                                     Split    = 0;
+    std::vector<TFloat>                     Bound;
+    std::vector<std::vector<std::uint32_t>> Shards;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Shards<TFloat>::Segment3Shards
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    std::size_t shards
+)
+{
+    Build(segments, count, shards);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3Shards<TFloat>::Build
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    std::size_t shards
+)
+{
+    Segments = segments;
+    Count    = count;
+    Split    = 0;
+    Bound.clear();
+    Shards.assign(std::max<std::size_t>(1, std::min(shards, count)), {});
+
+    if (count == 0)
+        return;
+
+    // Centers are kept doubled (Start + End) to avoid the scaling
+    std::vector<Vector3<TFloat>> centers(count);
+    for (std::size_t i = 0; i < count; ++i)
+        centers[i] = segments[i].Start + segments[i].End;
+
+    Vector3<TFloat> low  = centers[0];
+    Vector3<TFloat> high = centers[0];
+    for (const Vector3<TFloat>& center : centers) {
+        low  = { std::min(low .X, center.X), std::min(low .Y, center.Y), std::min(low .Z, center.Z) };
+        high = { std::max(high.X, center.X), std::max(high.Y, center.Y), std::max(high.Z, center.Z) };
+    }
+
+    const Vector3<TFloat> extent = high - low;
+    Split = extent.X >= extent.Y && extent.X >= extent.Z ? 0 : extent.Y >= extent.Z ? 1 : 2;
+
+    std::vector<TFloat> keys(count);
+    for (std::size_t i = 0; i < count; ++i)
+        keys[i] = Split == 0 ? centers[i].X : Split == 1 ? centers[i].Y : centers[i].Z;
+
+    std::sort(keys.begin(), keys.end());
+    for (std::size_t slab = 1; slab < Shards.size(); ++slab)
+        Bound.push_back(keys[slab * count / Shards.size()] / 2);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const Segment3<TFloat> box = segments[i].ToAABB();
+        const std::size_t last = Slab(High(box));
+        for (std::size_t slab = Slab(Low(box)); slab <= last; ++slab)
+            Shards[slab].push_back(static_cast<std::uint32_t>(i));
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Shards<TFloat>::Size() const
+{
+    return Shards.size();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline int Segment3Shards<TFloat>::Axis() const
+{
+    return Split;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<TFloat>& Segment3Shards<TFloat>::Bounds() const
+{
+    return Bound;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<std::uint32_t>& Segment3Shards<TFloat>::Members
+(
+    std::size_t shard
+)
+const
+{
+    return Shards[shard];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Shards<TFloat>::Owner
+(
+    const Segment3<TFloat>& firstBox,
+    const Segment3<TFloat>& secondBox
+)
+const
+{
+    return Slab(std::max(Low(firstBox), Low(secondBox)));
+}
+
+//---------------------------------------------------------------------------------------
+// Local indices follow the global order, so every pair is intersected the
+// same way round as in a BVH over the whole set and the points are the same
+template<typename TFloat>
+inline void Segment3Shards<TFloat>::ShardIntersections
+(
+    std::size_t shard,
+    std::vector<Segment3Hit<TFloat>>& hits
+)
+const
+{
+    const std::vector<std::uint32_t>& members = Shards[shard];
+
+    std::vector<Segment3<TFloat>> local(members.size());
+    for (std::size_t i = 0; i < members.size(); ++i)
+        local[i] = Segments[members[i]];
+
+    const Segment3BVH<TFloat> bvh(local.data(), local.size());
+    bvh.SelfIntersections(hits);
+
+    std::size_t kept = 0;
+    for (const Segment3Hit<TFloat>& hit : hits) {
+        if (Owner(bvh.Box(hit.First), bvh.Box(hit.Second)) != shard)
+            continue;
+
+        hits[kept++] = { members[hit.First], members[hit.Second], hit.Point };
+    }
+
+    hits.resize(kept);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Shards<TFloat>::SelfIntersections
+(
+    std::vector<Segment3Hit<TFloat>>& hits,
+    bool processes
+)
+const
+{
+    hits.clear();
+
+    std::vector<Segment3Hit<TFloat>> found;
+    bool complete = true;
+
+#ifndef _WIN32
+    if (processes && Shards.size() > 1) {
+        std::vector<pid_t> workers(Shards.size(), -1);
+        std::vector<int>   pipes  (Shards.size(), -1);
+
+        for (std::size_t shard = 0; shard < Shards.size(); ++shard) {
+            int ends[2];
+            if (pipe(ends) != 0)
+                continue;
+
+            const pid_t worker = fork();
+            if (worker == 0) {
+                ::close(ends[0]);
+                ShardIntersections(shard, found);
+                const bool written = WriteAll(ends[1], found.data(), found.size() * sizeof(Segment3Hit<TFloat>));
+                _exit(written ? 0 : 1);
+            }
+
+            ::close(ends[1]);
+            if (worker < 0) {
+                ::close(ends[0]);
+                continue;
+            }
+
+            workers[shard] = worker;
+            pipes  [shard] = ends[0];
+        }
+
+        // Workers only write, so reading the pipes in order cannot deadlock
+        for (std::size_t shard = 0; shard < Shards.size(); ++shard) {
+            if (workers[shard] < 0) {
+                ShardIntersections(shard, found);
+                hits.insert(hits.end(), found.begin(), found.end());
+                continue;
+            }
+
+            const bool read = ReadAll(pipes[shard], hits);
+            ::close(pipes[shard]);
+
+            int status = 0;
+            while (waitpid(workers[shard], &status, 0) < 0 && errno == EINTR) {}
+            complete = complete && read && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+
+        std::sort(hits.begin(), hits.end());
+        return complete;
+    }
+#endif // _WIN32
+
+    (void)processes;
+    for (std::size_t shard = 0; shard < Shards.size(); ++shard) {
+        ShardIntersections(shard, found);
+        hits.insert(hits.end(), found.begin(), found.end());
+    }
+
+    std::sort(hits.begin(), hits.end());
+    return complete;
+}
+
+//---------------------------------------------------------------------------------------
+// Slabs are half-open, a coordinate on a bound belongs to the upper slab
+template<typename TFloat>
+inline std::size_t Segment3Shards<TFloat>::Slab
+(
+    TFloat coordinate
+)
+const
+{
+    return static_cast<std::size_t>(std::upper_bound(Bound.begin(), Bound.end(), coordinate) - Bound.begin());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline TFloat Segment3Shards<TFloat>::Low
+(
+    const Segment3<TFloat>& box
+)
+const
+{
+    return Split == 0 ? box.Start.X : Split == 1 ? box.Start.Y : box.Start.Z;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline TFloat Segment3Shards<TFloat>::High
+(
+    const Segment3<TFloat>& box
+)
+const
+{
+    return Split == 0 ? box.End.X : Split == 1 ? box.End.Y : box.End.Z;
+}
+
+#ifndef _WIN32
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Shards<TFloat>::WriteAll
+(
+    int file,
+    const void* data,
+    std::size_t bytes
+)
+{
+    const char* next = static_cast<const char*>(data);
+    while (bytes > 0) {
+        const ssize_t written = ::write(file, next, bytes);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        next  += written;
+        bytes -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// Appends the records of a pipe up to its end, a torn last record is an error
+template<typename TFloat>
+inline bool Segment3Shards<TFloat>::ReadAll
+(
+    int file,
+    std::vector<Segment3Hit<TFloat>>& hits
+)
+{
+    const std::size_t record = sizeof(Segment3Hit<TFloat>);
+    const std::size_t first  = hits.size();
+
+    std::size_t bytes = 0;
+    for (;;) {
+        // Room for at least a page more, doubling the records of this pipe
+        if ((hits.size() - first) * record - bytes < 4096)
+            hits.resize(hits.size() + std::max<std::size_t>(hits.size() - first, 4096 / record + 1));
+
+        char* target = reinterpret_cast<char*>(hits.data() + first) + bytes;
+        const std::size_t room = (hits.size() - first) * record - bytes;
+
+        const ssize_t read = ::read(file, target, room);
+        if (read < 0 && errno == EINTR)
+            continue;
+        if (read < 0)
+            return false;
+        if (read == 0)
+            break;
+
+        bytes += static_cast<std::size_t>(read);
+    }
+
+    hits.resize(first + bytes / record);
+    return bytes % record == 0;
+}
+#endif // _WIN32
+
+//---------------------------------------------------------------------------------------
+using Segment3ShardsF = Segment3Shards<float>;
+using Segment3ShardsD = Segment3Shards<double>;
@@ -0,0 +1,117 @@
+#pragma once
+#include "Segment3.h"
+#include <cstddef>
+
+//---------------------------------------------------------------------------------------
+// Non-owning view of a contiguous segment array, e.g. a memory-mapped file.
+// Data() and Size() plug straight into the (segments, count) parameters of
+// Segment3Batch, Segment3BVH, Segment3Grid and Segment3SweepAndPrune.
+template <typename TFloat>
+class Segment3Span
+{
+public:
+    Segment3Span() = default;
+
+    Segment3Span(
+        const Segment3<TFloat>* data,
+        std::size_t size
+    );
+
+    const Segment3<TFloat>* Data() const;
+
+    std::size_t Size() const;
+
+    bool Empty() const;
+
+    const Segment3<TFloat>& operator[](std::size_t index) const;
+
+    // Part of the view starting at offset, at most count segments long
+    Segment3Span<TFloat> Subspan(
+        std::size_t offset,
+        std::size_t count
+    ) const;
+
+    const Segment3<TFloat>* begin() const;
+
+    const Segment3<TFloat>* end() const;
+
+private:
+    const Segment3<TFloat>* Pointer = nullptr;
+    std::size_t             Count   = 0;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Span<TFloat>::Segment3Span
+(
+    const Segment3<TFloat>* data,
+    std::size_t size
+) :
+    Pointer(data),
+    Count(size)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>* Segment3Span<TFloat>::Data() const
+{
+    return Pointer;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Span<TFloat>::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Span<TFloat>::Empty() const
+{
+    return Count == 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>& Segment3Span<TFloat>::operator[]
+(
+    std::size_t index
+)
+const
+{
+    return Pointer[index];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Span<TFloat> Segment3Span<TFloat>::Subspan
+(
+    std::size_t offset,
+    std::size_t count
+)
+const
+{
+    offset = offset < Count ? offset : Count;
+    count  = count < Count - offset ? count : Count - offset;
+
+    return Segment3Span<TFloat>(Pointer + offset, count);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>* Segment3Span<TFloat>::begin() const
+{
+    return Pointer;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>* Segment3Span<TFloat>::end() const
+{
+    return Pointer + Count;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3SpanF = Segment3Span<float>;
+using Segment3SpanD = Segment3Span<double>;
@@ -0,0 +1,413 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3Batch.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+enum class Segment3Curve
+{
+    Morton,
+    Hilbert,
+};
+
+//---------------------------------------------------------------------------------------
+// Copy of a segment set sorted along a space-filling curve through the
+// centers of the Segment3::ToAABB() boxes, so that segments close in space are
+// close in memory, with the permutation back to the input order.
+// Any broad phase or batch can be run on Segments(); Restore() translates the
+// indices of the hits and pairs found there into input indices, Gather() and
+// Scatter() move per-segment arrays between the two orders.
+// Centers are quantized to 21 bits per axis over the common bounds, the same
+// scale on all axes; Hilbert order has no jumps between distant cells and
+// keeps neighbours a little closer than Morton order, which is cheaper to
+// compute.
+template <typename TFloat>
+class Segment3SpatialOrder
+{
+public:
+    static constexpr unsigned Bits = 21;
+
+public:
+    Segment3SpatialOrder() = default;
+
+    Segment3SpatialOrder(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        Segment3Curve curve = Segment3Curve::Hilbert
+    );
+
+    void Build(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        Segment3Curve curve = Segment3Curve::Hilbert
+    );
+
+    std::size_t Size() const;
+
+    // Segments in curve order
+    const Segment3<TFloat>* Segments() const;
+
+    // Input index of every segment in curve order
+    const std::vector<std::uint32_t>& Permutation() const;
+
+    std::size_t Original(std::size_t sorted) const;
+
+    std::size_t Sorted(std::size_t original) const;
+
+    // target[i] = source[Original(i)] for an array in input order
+    template<typename T>
+    void Gather(
+        const T* source,
+        T* target
+    ) const;
+
+    // target[Original(i)] = source[i] for an array in curve order
+    template<typename T>
+    void Scatter(
+        const T* source,
+        T* target
+    ) const;
+
+    // Segments() as a batch
+    Segment3Batch<TFloat> Batch() const;
+
+    // Batch of the partners of the input segments, e.g. the second argument
+    // of Segment3Batch::Intersection, in curve order
+    Segment3Batch<TFloat> Batch(const Segment3<TFloat>* partners) const;
+
+    // Batch results in curve order back to input order
+    void Scatter(
+        const Vector3Batch<TFloat>& source,
+        Vector3Batch<TFloat>& target
+    ) const;
+
+    // Hits found on Segments() with input indices, First < Second, sorted.
+    // Intersection is not symmetric, so a pair whose order flips is
+    // recomputed as input[First].Intersection(input[Second]) and dropped if
+    // that misses. A pair that hits only in input order cannot be found from
+    // curve-order hits: for exactly the hits of the input order, Restore the
+    // candidate pairs of the broad phase and intersect them in input order.
+    template<typename TAllocator>
+    void Restore(std::vector<Segment3Hit<TFloat>, TAllocator>& hits) const;
+
+    template<typename TAllocator>
+    void Restore(std::vector<Segment3Pair, TAllocator>& pairs) const;
+
+    // Coordinates below 2^21
+    static std::uint64_t MortonCode(
+        std::uint32_t x,
+        std::uint32_t y,
+        std::uint32_t z
+    );
+
+    static std::uint64_t HilbertCode(
+        std::uint32_t x,
+        std::uint32_t y,
+        std::uint32_t z
+    );
+
+private:
+    static std::uint64_t Spread(std::uint32_t value);
+
+private:
+    std::vector<Segment3<TFloat>> Ordered;
+    std::vector<std::uint32_t>    Order;
+    std::vector<std::uint32_t>    Rank;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3SpatialOrder<TFloat>::Segment3SpatialOrder
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    Segment3Curve curve
+)
+{
+    Build(segments, count, curve);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3SpatialOrder<TFloat>::Build
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    Segment3Curve curve
+)
+{
+    Ordered.clear();
+    Order.clear();
+    Rank.clear();
+    if (count == 0)
+        return;
+
+    // Centers are kept doubled (Start + End) to avoid the scaling
+    std::vector<Vector3<TFloat>> centers(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const Segment3<TFloat> box = segments[i].ToAABB();
+        centers[i] = box.Start + box.End;
+    }
+
+    Vector3<TFloat> low  = centers[0];
+    Vector3<TFloat> high = centers[0];
+    for (const Vector3<TFloat>& center : centers) {
+        low  = { std::min(low .X, center.X), std::min(low .Y, center.Y), std::min(low .Z, center.Z) };
+        high = { std::max(high.X, center.X), std::max(high.Y, center.Y), std::max(high.Z, center.Z) };
+    }
+
+    const Vector3<TFloat> extent = high - low;
+    const double largest = std::max({ extent.X, extent.Y, extent.Z });
+    const double scale   = largest > 0 ? ((1u << Bits) - 1) / largest : 0.;
+
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> keys(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::uint32_t x = static_cast<std::uint32_t>((centers[i].X - low.X) * scale);
+        const std::uint32_t y = static_cast<std::uint32_t>((centers[i].Y - low.Y) * scale);
+        const std::uint32_t z = static_cast<std::uint32_t>((centers[i].Z - low.Z) * scale);
+
+        keys[i].first  = curve == Segment3Curve::Hilbert ? HilbertCode(x, y, z) : MortonCode(x, y, z);
+        keys[i].second = static_cast<std::uint32_t>(i);
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    Ordered.resize(count);
+    Order.resize(count);
+    Rank.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        Order[i] = keys[i].second;
+        Rank[keys[i].second] = static_cast<std::uint32_t>(i);
+        Ordered[i] = segments[keys[i].second];
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3SpatialOrder<TFloat>::Size() const
+{
+    return Ordered.size();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const Segment3<TFloat>* Segment3SpatialOrder<TFloat>::Segments() const
+{
+    return Ordered.data();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline const std::vector<std::uint32_t>& Segment3SpatialOrder<TFloat>::Permutation() const
+{
+    return Order;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3SpatialOrder<TFloat>::Original
+(
+    std::size_t sorted
+)
+const
+{
+    return Order[sorted];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3SpatialOrder<TFloat>::Sorted
+(
+    std::size_t original
+)
+const
+{
+    return Rank[original];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename T>
+inline void Segment3SpatialOrder<TFloat>::Gather
+(
+    const T* source,
+    T* target
+)
+const
+{
+    for (std::size_t i = 0; i < Order.size(); ++i)
+        target[i] = source[Order[i]];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename T>
+inline void Segment3SpatialOrder<TFloat>::Scatter
+(
+    const T* source,
+    T* target
+)
+const
+{
+    for (std::size_t i = 0; i < Order.size(); ++i)
+        target[Order[i]] = source[i];
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Batch<TFloat> Segment3SpatialOrder<TFloat>::Batch() const
+{
+    return Segment3Batch<TFloat>(Ordered.data(), Ordered.size());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Batch<TFloat> Segment3SpatialOrder<TFloat>::Batch
+(
+    const Segment3<TFloat>* partners
+)
+const
+{
+    Segment3Batch<TFloat> batch(Order.size());
+    for (std::size_t i = 0; i < Order.size(); ++i)
+        batch.Set(i, partners[Order[i]]);
+
+    return batch;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3SpatialOrder<TFloat>::Scatter
+(
+    const Vector3Batch<TFloat>& source,
+    Vector3Batch<TFloat>& target
+)
+const
+{
+    target.Resize(Order.size());
+    Scatter(source.X.data(), target.X.data());
+    Scatter(source.Y.data(), target.Y.data());
+    Scatter(source.Z.data(), target.Z.data());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3SpatialOrder<TFloat>::Restore
+(
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits
+)
+const
+{
+    for (Segment3Hit<TFloat>& hit : hits) {
+        const std::size_t first  = hit.First;
+        const std::size_t second = hit.Second;
+
+        hit.First  = Order[first];
+        hit.Second = Order[second];
+        if (hit.First > hit.Second) {
+            std::swap(hit.First, hit.Second);
+            hit.Point = Ordered[second].Intersection(Ordered[first]);
+        }
+    }
+
+    auto missed = [](const Segment3Hit<TFloat>& hit) {
+        return !hit.Point.IsValid();
+    };
+
+    hits.erase(std::remove_if(hits.begin(), hits.end(), missed), hits.end());
+    std::sort(hits.begin(), hits.end());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3SpatialOrder<TFloat>::Restore
+(
+    std::vector<Segment3Pair, TAllocator>& pairs
+)
+const
+{
+    for (Segment3Pair& pair : pairs) {
+        pair.First  = Order[pair.First];
+        pair.Second = Order[pair.Second];
+        if (pair.First > pair.Second)
+            std::swap(pair.First, pair.Second);
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::uint64_t Segment3SpatialOrder<TFloat>::MortonCode
+(
+    std::uint32_t x,
+    std::uint32_t y,
+    std::uint32_t z
+)
+{
+    return (Spread(x) << 2) | (Spread(y) << 1) | Spread(z);
+}
+
+//---------------------------------------------------------------------------------------
+// Skilling's transform of the coordinates into the transposed Hilbert index,
+// whose bits interleaved the same way as in MortonCode give the index itself
+template<typename TFloat>
+inline std::uint64_t Segment3SpatialOrder<TFloat>::HilbertCode
+(
+    std::uint32_t x,
+    std::uint32_t y,
+    std::uint32_t z
+)
+{
+    std::uint32_t axes[3] = { x, y, z };
+
+    for (std::uint32_t bit = 1u << (Bits - 1); bit > 1; bit >>= 1) {
+        const std::uint32_t lower = bit - 1;
+        for (std::uint32_t& axis : axes)
+            if (axis & bit)
+                axes[0] ^= lower;
+            else {
+                const std::uint32_t swap = (axes[0] ^ axis) & lower;
+                axes[0] ^= swap;
+                axis    ^= swap;
+            }
+    }
+
+    axes[1] ^= axes[0];
+    axes[2] ^= axes[1];
+
+    std::uint32_t flip = 0;
+    for (std::uint32_t bit = 1u << (Bits - 1); bit > 1; bit >>= 1)
+        if (axes[2] & bit)
+            flip ^= bit - 1;
+
+    return MortonCode(axes[0] ^ flip, axes[1] ^ flip, axes[2] ^ flip);
+}
+
+//---------------------------------------------------------------------------------------
+// Moves bit k of a 21-bit value to bit 3k
+template<typename TFloat>
+inline std::uint64_t Segment3SpatialOrder<TFloat>::Spread
+(
+    std::uint32_t value
+)
+{
+    std::uint64_t bits = value & 0x1FFFFF;
+    bits = (bits | bits << 32) & 0x001F00000000FFFFull;
+    bits = (bits | bits << 16) & 0x001F0000FF0000FFull;
+    bits = (bits | bits <<  8) & 0x100F00F00F00F00Full;
+    bits = (bits | bits <<  4) & 0x10C30C30C30C30C3ull;
+    bits = (bits | bits <<  2) & 0x1249249249249249ull;
+    return bits;
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3SpatialOrderF = Segment3SpatialOrder<float>;
+using Segment3SpatialOrderD = Segment3SpatialOrder<double>;
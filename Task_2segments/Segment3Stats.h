@@ -0,0 +1,454 @@
+#pragma once
+#include "Segment3Trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SEGMENT3_STATS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SEGMENT3_STATS_TSC
+#endif
+
+//---------------------------------------------------------------------------------------
+// Totals of a Segment3Stats at one moment. Counts hold every Segment3Step
+// reported, so Count(Segments) is the number of segment-segment calls and the
+// final steps (AABBReject ... OutOfRange, PointOutsideAABB ... PointOnSegment)
+// tell where they ended. Every sampled call adds its duration in ticks to the
+// final step: bucket 0 of the histogram counts zero ticks, bucket b > 0 the
+// durations in [2^(b-1), 2^b).
+struct Segment3StatsSnapshot
+{
+    static constexpr std::size_t Steps   = static_cast<std::size_t>(Segment3Step::OutOfRange) + 1;
+    static constexpr std::size_t Buckets = 32;
+
+    std::size_t   Threads      = 0;
+    std::uint32_t SamplePeriod = 0;
+    std::uint64_t Counts   [Steps]          = {};
+    std::uint64_t Ticks    [Steps]          = {};
+    std::uint64_t Histogram[Steps][Buckets] = {};
+
+    std::uint64_t Count(Segment3Step step) const;
+
+    std::uint64_t Sampled(Segment3Step step) const;
+
+    double MeanTicks(Segment3Step step) const;
+
+    // Upper bound of the bucket holding the given fraction of the samples
+    std::uint64_t PercentileTicks(Segment3Step step, double fraction) const;
+
+    // Time stamp counter ticks on x86, nanoseconds elsewhere
+    static const char* TickUnit();
+
+    // One object per step in Segment3Step order, the layout does not depend
+    // on the data, so dumps of two runs can be diffed
+    void WriteJson(std::ostream& out) const;
+};
+
+//---------------------------------------------------------------------------------------
+class Segment3StatsTracer;
+
+//---------------------------------------------------------------------------------------
+// Opt-in counters of the decisions taken by Segment3::Intersect and
+// Segment3::Intersection, fed by Segment3StatsTracer. Every thread writes
+// only its own slot, a cache line aligned block of relaxed atomics, so the
+// counting costs two plain stores per call and Snapshot() can read the totals
+// while the workers run. One call in SamplePeriod per slot is also timed.
+// Reset() only moves the baseline Snapshot() subtracts; Snapshot() and
+// Reset() are meant for one controlling thread.
+class Segment3Stats
+{
+public:
+    static constexpr std::size_t Steps   = Segment3StatsSnapshot::Steps;
+    static constexpr std::size_t Buckets = Segment3StatsSnapshot::Buckets;
+
+public:
+    // Slots for worker indices [0, threads), e.g. WorkStealingPool::Threads();
+    // the sample period is rounded up to a power of two
+    explicit Segment3Stats(
+        std::size_t threads = 1,
+        std::uint32_t samplePeriod = 64
+    );
+
+    Segment3Stats(const Segment3Stats&) = delete;
+
+    Segment3Stats& operator=(const Segment3Stats&) = delete;
+
+    std::size_t Threads() const;
+
+    // Tracer writing to the slot of the given worker
+    Segment3StatsTracer Tracer(std::size_t worker);
+
+    Segment3StatsSnapshot Snapshot() const;
+
+    void Reset();
+
+    static std::uint64_t Now();
+
+private:
+    friend class Segment3StatsTracer;
+
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> Counts   [Steps];
+        std::atomic<std::uint64_t> Ticks    [Steps];
+        std::atomic<std::uint64_t> Histogram[Steps][Buckets];
+        std::uint64_t              Calls;   // owner only, drives the sampling
+    };
+
+    static void Add(std::atomic<std::uint64_t>& counter, std::uint64_t value);
+
+    Segment3StatsSnapshot Total() const;
+
+private:
+    std::unique_ptr<Slot[]> Slots;
+    std::size_t             Count = 0;
+    std::uint32_t           Mask  = 0;
+    Segment3StatsSnapshot   Baseline;
+};
+
+//---------------------------------------------------------------------------------------
+// Tracer for the intersection routines, e.g.
+//     first.Intersection(second, stats.Tracer(worker))
+// A call starts at Segments or SegmentPoint and ends at its final step; the
+// point test nested in a segment call with a point segment is part of it.
+class Segment3StatsTracer
+{
+public:
+    void operator()(Segment3Step step);
+
+    void operator()(
+        Segment3Step step,
+        char u,
+        char v,
+        double t,
+        double k
+    );
+
+private:
+    friend class Segment3Stats;
+
+    Segment3StatsTracer(
+        Segment3Stats::Slot& slot,
+        std::uint32_t mask
+    );
+
+    static bool IsFinal(Segment3Step step);
+
+private:
+    Segment3Stats::Slot* Target;
+    std::uint32_t        Mask;
+    bool                 Active  = false;
+    bool                 Sampled = false;
+    std::uint64_t        Start   = 0;
+};
+
+//---------------------------------------------------------------------------------------
+inline std::uint64_t Segment3StatsSnapshot::Count
+(
+    Segment3Step step
+)
+const
+{
+    return Counts[static_cast<std::size_t>(step)];
+}
+
+//---------------------------------------------------------------------------------------
+inline std::uint64_t Segment3StatsSnapshot::Sampled
+(
+    Segment3Step step
+)
+const
+{
+    std::uint64_t sampled = 0;
+    for (std::uint64_t bucket : Histogram[static_cast<std::size_t>(step)])
+        sampled += bucket;
+
+    return sampled;
+}
+
+//---------------------------------------------------------------------------------------
+inline double Segment3StatsSnapshot::MeanTicks
+(
+    Segment3Step step
+)
+const
+{
+    const std::uint64_t sampled = Sampled(step);
+    return sampled > 0 ? static_cast<double>(Ticks[static_cast<std::size_t>(step)]) / sampled : 0.;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::uint64_t Segment3StatsSnapshot::PercentileTicks
+(
+    Segment3Step step,
+    double fraction
+)
+const
+{
+    const std::uint64_t sampled = Sampled(step);
+    if (sampled == 0)
+        return 0;
+
+    const std::uint64_t* histogram = Histogram[static_cast<std::size_t>(step)];
+
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < Buckets; ++bucket) {
+        seen += histogram[bucket];
+        if (seen >= fraction * sampled)
+            return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+    }
+
+    return (std::uint64_t(1) << (Buckets - 1)) - 1;
+}
+
+//---------------------------------------------------------------------------------------
+inline const char* Segment3StatsSnapshot::TickUnit()
+{
+#ifdef SEGMENT3_STATS_TSC
+    return "tsc";
+#else
+    return "ns";
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3StatsSnapshot::WriteJson
+(
+    std::ostream& out
+)
+const
+{
+    static const char* const keys[Steps] = {
+        "segment_point",
+        "point_outside_aabb",
+        "point_off_line",
+        "point_on_segment",
+        "segments",
+        "first_is_point",
+        "second_is_point",
+        "aabb_reject",
+        "skew",
+        "parallel",
+        "same_line",
+        "solved",
+        "out_of_range",
+    };
+
+    out << "{\n"
+        << "  \"threads\": " << Threads << ",\n"
+        << "  \"sample_period\": " << SamplePeriod << ",\n"
+        << "  \"tick_unit\": \"" << TickUnit() << "\",\n"
+        << "  \"steps\": [\n";
+
+    for (std::size_t i = 0; i < Steps; ++i) {
+        const Segment3Step step = static_cast<Segment3Step>(i);
+
+        out << "    { "
+            << "\"step\": \"" << keys[i] << "\", "
+            << "\"count\": " << Counts[i] << ", "
+            << "\"sampled\": " << Sampled(step) << ", "
+            << "\"ticks\": { "
+            << "\"mean\": " << MeanTicks(step) << ", "
+            << "\"p50\": " << PercentileTicks(step, 0.5) << ", "
+            << "\"p99\": " << PercentileTicks(step, 0.99) << " }, "
+            << "\"histogram\": [";
+
+        for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+            out << (bucket > 0 ? ", " : "") << Histogram[i][bucket];
+
+        out << "] }" << (i + 1 < Steps ? "," : "") << '\n';
+    }
+
+    out << "  ]\n"
+        << "}\n";
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3Stats::Segment3Stats
+(
+    std::size_t threads,
+    std::uint32_t samplePeriod
+) :
+    Slots(new Slot[threads > 0 ? threads : 1]),
+    Count(threads > 0 ? threads : 1)
+{
+    std::uint32_t period = 1;
+    while (period < samplePeriod && period < (1u << 31))
+        period <<= 1;
+    Mask = period - 1;
+
+    for (std::size_t slot = 0; slot < Count; ++slot) {
+        for (std::size_t i = 0; i < Steps; ++i) {
+            Slots[slot].Counts[i].store(0, std::memory_order_relaxed);
+            Slots[slot].Ticks [i].store(0, std::memory_order_relaxed);
+            for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+                Slots[slot].Histogram[i][bucket].store(0, std::memory_order_relaxed);
+        }
+        Slots[slot].Calls = 0;
+    }
+
+    Baseline.Threads      = Count;
+    Baseline.SamplePeriod = period;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t Segment3Stats::Threads() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3StatsTracer Segment3Stats::Tracer
+(
+    std::size_t worker
+)
+{
+    return Segment3StatsTracer(Slots[worker], Mask);
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3StatsSnapshot Segment3Stats::Snapshot() const
+{
+    Segment3StatsSnapshot snapshot = Total();
+
+    for (std::size_t i = 0; i < Steps; ++i) {
+        snapshot.Counts[i] -= Baseline.Counts[i];
+        snapshot.Ticks [i] -= Baseline.Ticks [i];
+        for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+            snapshot.Histogram[i][bucket] -= Baseline.Histogram[i][bucket];
+    }
+
+    return snapshot;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3Stats::Reset()
+{
+    Baseline = Total();
+}
+
+//---------------------------------------------------------------------------------------
+inline std::uint64_t Segment3Stats::Now()
+{
+#ifdef SEGMENT3_STATS_TSC
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+// Only the owner thread writes a slot, so a load and a store do without the
+// locked read-modify-write of fetch_add
+inline void Segment3Stats::Add
+(
+    std::atomic<std::uint64_t>& counter,
+    std::uint64_t value
+)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3StatsSnapshot Segment3Stats::Total() const
+{
+    Segment3StatsSnapshot total;
+    total.Threads      = Count;
+    total.SamplePeriod = Mask + 1;
+
+    for (std::size_t slot = 0; slot < Count; ++slot)
+        for (std::size_t i = 0; i < Steps; ++i) {
+            total.Counts[i] += Slots[slot].Counts[i].load(std::memory_order_relaxed);
+            total.Ticks [i] += Slots[slot].Ticks [i].load(std::memory_order_relaxed);
+            for (std::size_t bucket = 0; bucket < Buckets; ++bucket)
+                total.Histogram[i][bucket] += Slots[slot].Histogram[i][bucket].load(std::memory_order_relaxed);
+        }
+
+    return total;
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3StatsTracer::Segment3StatsTracer
+(
+    Segment3Stats::Slot& slot,
+    std::uint32_t mask
+) :
+    Target(&slot),
+    Mask(mask)
+{}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3StatsTracer::operator()
+(
+    Segment3Step step
+)
+{
+    const std::size_t index = static_cast<std::size_t>(step);
+    Segment3Stats::Add(Target->Counts[index], 1);
+
+    if (!Active) {
+        Active  = true;
+        Sampled = (Target->Calls++ & Mask) == 0;
+        if (Sampled)
+            Start = Segment3Stats::Now();
+        return;
+    }
+
+    if (!IsFinal(step))
+        return;
+
+    Active = false;
+    if (!Sampled)
+        return;
+
+    const std::uint64_t ticks = Segment3Stats::Now() - Start;
+
+    std::size_t bucket = 0;
+    while (bucket + 1 < Segment3Stats::Buckets && (ticks >> bucket) != 0)
+        ++bucket;
+
+    Segment3Stats::Add(Target->Ticks[index], ticks);
+    Segment3Stats::Add(Target->Histogram[index][bucket], 1);
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3StatsTracer::operator()
+(
+    Segment3Step step,
+    char,
+    char,
+    double,
+    double
+)
+{
+    (*this)(step);
+}
+
+//---------------------------------------------------------------------------------------
+inline bool Segment3StatsTracer::IsFinal
+(
+    Segment3Step step
+)
+{
+    switch (step)
+    {
+    case Segment3Step::PointOutsideAABB:
+    case Segment3Step::PointOffLine:
+    case Segment3Step::PointOnSegment:
+    case Segment3Step::AABBReject:
+    case Segment3Step::Skew:
+    case Segment3Step::Parallel:
+    case Segment3Step::SameLine:
+    case Segment3Step::Solved:
+    case Segment3Step::OutOfRange:
+        return true;
+    default:
+        return false;
+    }
+}
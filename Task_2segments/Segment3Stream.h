@@ -0,0 +1,239 @@
+#pragma once
+#include "Segment3.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+enum class Segment3Format
+{
+    Text,   // whitespace separated numbers, six per segment
+    Binary, // raw array of six TFloat per segment, native byte order
+};
+
+//---------------------------------------------------------------------------------------
+// Reads segments from a stdio stream a chunk at a time, so inputs of any size
+// are processed in constant memory. Seek needs a seekable stream (a file,
+// not a pipe); text input is re-parsed from the start to get there.
+template <typename TFloat>
+class Segment3Reader
+{
+public:
+    Segment3Reader(
+        std::FILE* file,
+        Segment3Format format
+    );
+
+    // Reads up to count segments, returns how many were read
+    std::size_t Read(
+        Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    // Positions the stream before the segment with the given index
+    bool Seek(std::size_t index);
+
+    // Index of the next segment to be read
+    std::size_t Position() const;
+
+    // Set when the text input has something that is not a number or ends
+    // in the middle of a segment
+    bool Failed() const;
+
+private:
+    bool ReadNumber(TFloat& value);
+
+    bool Fill();
+
+    static bool IsSeparator(char symbol);
+
+private:
+    static constexpr std::size_t BufferSize = 1 << 20;
+
+    std::FILE*        File;
+    Segment3Format    Format;
+    std::size_t       Next  = 0;
+    bool              Error = false;
+    std::vector<char> Buffer;
+    std::size_t       Begin = 0;
+    std::size_t       End   = 0;
+    bool              Eof   = false;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3Reader<TFloat>::Segment3Reader
+(
+    std::FILE* file,
+    Segment3Format format
+) :
+    File(file),
+    Format(format)
+{
+    if (Format == Segment3Format::Text)
+        Buffer.resize(BufferSize + 1);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Reader<TFloat>::Read
+(
+    Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    static_assert(sizeof(Segment3<TFloat>) == 6 * sizeof(TFloat), "Segment3 must be six packed TFloat");
+
+    std::size_t read = 0;
+
+    if (Format == Segment3Format::Binary)
+        read = std::fread(segments, sizeof(Segment3<TFloat>), count, File);
+    else
+        for (; read < count; ++read) {
+            Segment3<TFloat>& segment = segments[read];
+            if (!ReadNumber(segment.Start.X))
+                break;
+
+            // Input ends in the middle of a segment
+            if (!ReadNumber(segment.Start.Y) || !ReadNumber(segment.Start.Z) ||
+                !ReadNumber(segment.End  .X) || !ReadNumber(segment.End  .Y) ||
+                !ReadNumber(segment.End  .Z))
+            {
+                Error = true;
+                break;
+            }
+        }
+
+    Next += read;
+    return read;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Reader<TFloat>::Seek
+(
+    std::size_t index
+)
+{
+    if (Format == Segment3Format::Binary)
+    {
+        const std::int64_t offset = static_cast<std::int64_t>(index * sizeof(Segment3<TFloat>));
+#ifdef _WIN32
+        if (_fseeki64(File, offset, SEEK_SET) != 0)
+#else
+        if (fseeko(File, static_cast<off_t>(offset), SEEK_SET) != 0)
+#endif // _WIN32
+            return false;
+
+        Next = index;
+        return true;
+    }
+
+    if (index < Next) {
+        if (std::fseek(File, 0, SEEK_SET) != 0)
+            return false;
+
+        Next  = 0;
+        Begin = End = 0;
+        Eof   = false;
+        Error = false;
+    }
+
+    Segment3<TFloat> skipped[256];
+    while (Next < index)
+        if (Read(skipped, std::min<std::size_t>(256, index - Next)) == 0)
+            return false;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3Reader<TFloat>::Position() const
+{
+    return Next;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Reader<TFloat>::Failed() const
+{
+    return Error;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Reader<TFloat>::ReadNumber
+(
+    TFloat& value
+)
+{
+    for (;;)
+    {
+        while (Begin < End && IsSeparator(Buffer[Begin]))
+            ++Begin;
+
+        // A number must be followed by a separator inside the buffer, so that
+        // one cut by the buffer end is never parsed in two halves
+        std::size_t stop = Begin;
+        while (stop < End && !IsSeparator(Buffer[stop]))
+            ++stop;
+
+        if (stop < End || (Eof && Begin < End))
+        {
+            Buffer[stop] = '\0';
+            char* parsed = nullptr;
+            const double number = std::strtod(&Buffer[Begin], &parsed);
+
+            if (parsed != &Buffer[stop]) {
+                Error = true;
+                return false;
+            }
+
+            value = static_cast<TFloat>(number);
+            Begin = stop < End ? stop + 1 : stop;
+            return true;
+        }
+
+        if (Eof || !Fill())
+            return false;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Reader<TFloat>::Fill()
+{
+    std::memmove(Buffer.data(), Buffer.data() + Begin, End - Begin);
+    End  -= Begin;
+    Begin = 0;
+
+    // A single token longer than the whole buffer is not a number
+    if (End == BufferSize) {
+        Error = true;
+        return false;
+    }
+
+    End += std::fread(Buffer.data() + End, 1, BufferSize - End, File);
+    Eof  = End < BufferSize;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline bool Segment3Reader<TFloat>::IsSeparator
+(
+    char symbol
+)
+{
+    return symbol == ' ' || symbol == '\t' || symbol == '\r' || symbol == '\n' ||
+           symbol == ',' || symbol == ';';
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3ReaderF = Segment3Reader<float>;
+using Segment3ReaderD = Segment3Reader<double>;
@@ -0,0 +1,323 @@
+#pragma once
+#include "Segment3.h"
+#include "Segment3Hit.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Sweep-and-prune broad phase over Segment3::ToAABB() extents along one axis.
+// Box endpoints stay sorted between updates, so a frame in which segments
+// barely moved costs an almost linear insertion sort instead of a rebuild.
+// The structure keeps a pointer to the segments, they must outlive it.
+template <typename TFloat>
+class Segment3SweepAndPrune
+{
+public:
+    using Axis = TFloat Vector3<TFloat>::*;
+
+public:
+    Segment3SweepAndPrune() = default;
+
+    Segment3SweepAndPrune(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        Axis axis = &Vector3<TFloat>::X
+    );
+
+    // Full rebuild, also used when the number of segments changes
+    void Build(
+        const Segment3<TFloat>* segments,
+        std::size_t count,
+        Axis axis = &Vector3<TFloat>::X
+    );
+
+    // Refreshes the boxes and re-sorts the endpoints incrementally
+    void Update(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+    std::size_t Size() const;
+
+    // Number of endpoint swaps done by the last insertion sort
+    std::size_t Swaps() const;
+
+    // Pairs whose boxes overlap on all three axes, sorted
+    std::vector<Segment3Pair> CandidatePairs() const;
+
+    std::vector<Segment3Hit<TFloat>> SelfIntersections() const;
+
+    // Same results written over the contents of the vectors, temporaries are
+    // taken from the same allocator. With ArenaVector outputs repeated queries
+    // make no heap allocations once the arena is large enough.
+    template<typename TAllocator>
+    void CandidatePairs(std::vector<Segment3Pair, TAllocator>& pairs) const;
+
+    template<typename TAllocator>
+    void SelfIntersections(std::vector<Segment3Hit<TFloat>, TAllocator>& hits) const;
+
+    // Axis with the largest spread of box centers
+    static Axis BestAxis(
+        const Segment3<TFloat>* segments,
+        std::size_t count
+    );
+
+private:
+    struct Endpoint {
+        TFloat        Value;
+        std::uint32_t Index;
+        std::uint32_t IsEnd;
+
+        bool operator<(const Endpoint& other) const;
+    };
+
+    void InsertionSort();
+
+private:
+    const Segment3<TFloat>*       Segments = nullptr;
+    std::size_t                   Count    = 0;
+    std::size_t                   Moves    = 0;
+    Axis                          Along    = &Vector3<TFloat>::X;
+    std::vector<Segment3<TFloat>> Boxes;
+    std::vector<Endpoint>         Endpoints;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Segment3SweepAndPrune<TFloat>::Segment3SweepAndPrune
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    Axis axis
+)
+{
+    Build(segments, count, axis);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3SweepAndPrune<TFloat>::Build
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count,
+    Axis axis
+)
+{
+    Segments = segments;
+    Count    = count;
+    Along    = axis;
+
+    Boxes.resize(count);
+    Endpoints.resize(2 * count);
+    for (std::size_t i = 0; i < count; ++i) {
+        Boxes[i] = segments[i].ToAABB();
+
+        const std::uint32_t index = static_cast<std::uint32_t>(i);
+        Endpoints[2 * i]     = { Boxes[i].Start.*Along, index, 0 };
+        Endpoints[2 * i + 1] = { Boxes[i].End  .*Along, index, 1 };
+    }
+
+    std::sort(Endpoints.begin(), Endpoints.end());
+    Moves = 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3SweepAndPrune<TFloat>::Update
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    if (count != Count) {
+        Build(segments, count, Along);
+        return;
+    }
+
+    Segments = segments;
+    for (std::size_t i = 0; i < count; ++i)
+        Boxes[i] = segments[i].ToAABB();
+
+    for (Endpoint& endpoint : Endpoints)
+        endpoint.Value = endpoint.IsEnd ?
+            Boxes[endpoint.Index].End  .*Along :
+            Boxes[endpoint.Index].Start.*Along;
+
+    InsertionSort();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3SweepAndPrune<TFloat>::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Segment3SweepAndPrune<TFloat>::Swaps() const
+{
+    return Moves;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Pair> Segment3SweepAndPrune<TFloat>::CandidatePairs() const
+{
+    std::vector<Segment3Pair> pairs;
+    CandidatePairs(pairs);
+    return pairs;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::vector<Segment3Hit<TFloat>> Segment3SweepAndPrune<TFloat>::SelfIntersections() const
+{
+    std::vector<Segment3Hit<TFloat>> hits;
+    SelfIntersections(hits);
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3SweepAndPrune<TFloat>::CandidatePairs
+(
+    std::vector<Segment3Pair, TAllocator>& pairs
+)
+const
+{
+    using Indices = std::vector<std::uint32_t, typename std::allocator_traits<TAllocator>::template rebind_alloc<std::uint32_t>>;
+
+    Indices active(pairs.get_allocator());
+    Indices slot(Count, 0, pairs.get_allocator());
+
+    pairs.clear();
+
+    for (const Endpoint& endpoint : Endpoints)
+    {
+        if (endpoint.IsEnd) {
+            // Swap-remove from the active list
+            const std::uint32_t position = slot[endpoint.Index];
+            active[position] = active.back();
+            slot[active[position]] = position;
+            active.pop_back();
+            continue;
+        }
+
+        for (std::uint32_t other : active)
+            if (Segment3<TFloat>::BoxesOverlap(Boxes[endpoint.Index], Boxes[other]))
+                pairs.push_back({
+                    std::min<std::size_t>(endpoint.Index, other),
+                    std::max<std::size_t>(endpoint.Index, other)
+                });
+
+        slot[endpoint.Index] = static_cast<std::uint32_t>(active.size());
+        active.push_back(endpoint.Index);
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+    template<typename TAllocator>
+inline void Segment3SweepAndPrune<TFloat>::SelfIntersections
+(
+    std::vector<Segment3Hit<TFloat>, TAllocator>& hits
+)
+const
+{
+    using Pairs = std::vector<Segment3Pair, typename std::allocator_traits<TAllocator>::template rebind_alloc<Segment3Pair>>;
+
+    Pairs pairs(hits.get_allocator());
+    CandidatePairs(pairs);
+
+    hits.clear();
+    for (const Segment3Pair& pair : pairs) {
+        const Vector3<TFloat> point = Segments[pair.First].Intersection(Segments[pair.Second]);
+        if (point.IsValid())
+            hits.push_back({ pair.First, pair.Second, point });
+    }
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline typename Segment3SweepAndPrune<TFloat>::Axis Segment3SweepAndPrune<TFloat>::BestAxis
+(
+    const Segment3<TFloat>* segments,
+    std::size_t count
+)
+{
+    Vector3<TFloat> sum;
+    Vector3<TFloat> sumSquared;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const Vector3<TFloat> center = segments[i].Start + segments[i].End;
+
+        sum += center;
+        sumSquared += Vector3<TFloat>(
+            center.X * center.X,
+            center.Y * center.Y,
+            center.Z * center.Z
+        );
+    }
+
+    // Variance up to the common 1 / count factor
+    const TFloat scale = count > 0 ? static_cast<TFloat>(1) / count : 0;
+    const Vector3<TFloat> spread(
+        sumSquared.X - sum.X * sum.X * scale,
+        sumSquared.Y - sum.Y * sum.Y * scale,
+        sumSquared.Z - sum.Z * sum.Z * scale
+    );
+
+    Axis axis = &Vector3<TFloat>::X;
+    if (spread.Y > spread.*axis) axis = &Vector3<TFloat>::Y;
+    if (spread.Z > spread.*axis) axis = &Vector3<TFloat>::Z;
+
+    return axis;
+}
+
+//---------------------------------------------------------------------------------------
+// Starts go before ends at equal values, boxes touching on the axis overlap
+// exactly as in Segment3::BoxesOverlap
+template<typename TFloat>
+inline bool Segment3SweepAndPrune<TFloat>::Endpoint::operator<
+(
+    const Endpoint& other
+)
+const
+{
+    return Value < other.Value || (Value == other.Value && IsEnd < other.IsEnd);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Segment3SweepAndPrune<TFloat>::InsertionSort()
+{
+    Moves = 0;
+
+    for (std::size_t i = 1; i < Endpoints.size(); ++i)
+    {
+        const Endpoint endpoint = Endpoints[i];
+
+        std::size_t j = i;
+        for (; j > 0 && endpoint < Endpoints[j - 1]; --j)
+            Endpoints[j] = Endpoints[j - 1];
+
+        Endpoints[j] = endpoint;
+        Moves += i - j;
+
+        // The set was reshuffled rather than nudged, finish with a full sort
+        if (Moves > 32 * Endpoints.size()) {
+            std::sort(Endpoints.begin(), Endpoints.end());
+            return;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+using Segment3SweepAndPruneF = Segment3SweepAndPrune<float>;
+using Segment3SweepAndPruneD = Segment3SweepAndPrune<double>;
@@ -0,0 +1,171 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//---------------------------------------------------------------------------------------
+// Decisions taken by Segment3::Intersect and Segment3::Intersection
+enum class Segment3Step : std::uint8_t
+{
+    SegmentPoint,     // segment-point test started
+    PointOutsideAABB, // point is outside the bounding box
+    PointOffLine,     // point is not on the line
+    PointOnSegment,   // point lies on the segment
+    Segments,         // segment-segment test started
+    FirstIsPoint,     // this segment is a point
+    SecondIsPoint,    // other segment is a point
+    AABBReject,       // bounding boxes do not overlap
+    Skew,             // skew lines
+    Parallel,         // parallel lines
+    SameLine,         // same line
+    Solved,           // lines intersect inside both segments
+    OutOfRange,       // lines intersect outside of a segment
+};
+
+//---------------------------------------------------------------------------------------
+// One traced decision. U, V, T and K are only set for Solved and OutOfRange:
+// the projection plane axes ('X', 'Y', 'Z') and the line parameters
+struct Segment3TraceRecord
+{
+    Segment3Step Step;
+    char         U;
+    char         V;
+    double       T;
+    double       K;
+};
+
+//---------------------------------------------------------------------------------------
+const char* Segment3StepName(Segment3Step step);
+
+//---------------------------------------------------------------------------------------
+// Default tracer of the intersection routines: every call is empty and
+// inlined, so an untraced Intersection compiles to the same code as before
+struct Segment3NullTracer
+{
+    void operator()(Segment3Step) const {}
+
+    void operator()(Segment3Step, char, char, double, double) const {}
+};
+
+//---------------------------------------------------------------------------------------
+// Writes records into a caller-provided buffer; records past its capacity are
+// counted in Dropped() and lost. Nothing is allocated or printed.
+class Segment3BufferTracer
+{
+public:
+    Segment3BufferTracer(
+        Segment3TraceRecord* buffer,
+        std::size_t capacity
+    );
+
+    void operator()(Segment3Step step);
+
+    void operator()(
+        Segment3Step step,
+        char u,
+        char v,
+        double t,
+        double k
+    );
+
+    const Segment3TraceRecord* Records() const;
+
+    std::size_t Size() const;
+
+    std::size_t Dropped() const;
+
+    void Clear();
+
+private:
+    Segment3TraceRecord* Buffer   = nullptr;
+    std::size_t          Capacity = 0;
+    std::size_t          Count    = 0;
+    std::size_t          Lost     = 0;
+};
+
+//---------------------------------------------------------------------------------------
+inline const char* Segment3StepName
+(
+    Segment3Step step
+)
+{
+    switch (step)
+    {
+    case Segment3Step::SegmentPoint:     return "Segment-point intersection:";
+    case Segment3Step::PointOutsideAABB: return "Point is outside the bounding box";
+    case Segment3Step::PointOffLine:     return "Point is not on the line";
+    case Segment3Step::PointOnSegment:   return "Point is on the segment";
+    case Segment3Step::Segments:         return "Segments intersection:";
+    case Segment3Step::FirstIsPoint:     return "Segment 1 is point";
+    case Segment3Step::SecondIsPoint:    return "Segment 2 is point";
+    case Segment3Step::AABBReject:       return "Bounding boxes do not overlap";
+    case Segment3Step::Skew:             return "Skew lines";
+    case Segment3Step::Parallel:         return "Parallel lines";
+    case Segment3Step::SameLine:         return "Same line";
+    case Segment3Step::Solved:           return "Lines intersect";
+    case Segment3Step::OutOfRange:       return "Intersection is outside the segments";
+    }
+
+    return "";
+}
+
+//---------------------------------------------------------------------------------------
+inline Segment3BufferTracer::Segment3BufferTracer
+(
+    Segment3TraceRecord* buffer,
+    std::size_t capacity
+) :
+    Buffer(buffer),
+    Capacity(capacity)
+{}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3BufferTracer::operator()
+(
+    Segment3Step step
+)
+{
+    (*this)(step, 0, 0, 0., 0.);
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3BufferTracer::operator()
+(
+    Segment3Step step,
+    char u,
+    char v,
+    double t,
+    double k
+)
+{
+    if (Count == Capacity) {
+        ++Lost;
+        return;
+    }
+
+    Buffer[Count++] = { step, u, v, t, k };
+}
+
+//---------------------------------------------------------------------------------------
+inline const Segment3TraceRecord* Segment3BufferTracer::Records() const
+{
+    return Buffer;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t Segment3BufferTracer::Size() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t Segment3BufferTracer::Dropped() const
+{
+    return Lost;
+}
+
+//---------------------------------------------------------------------------------------
+inline void Segment3BufferTracer::Clear()
+{
+    Count = 0;
+    Lost  = 0;
+}
@@ -0,0 +1,349 @@
+#pragma once
+#include "Unfused.h"
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif // __AVX2__ || __AVX512F__
+
+//---------------------------------------------------------------------------------------
+// Lane-wise wrappers used by the batch kernels. Every pack exposes the same
+// arithmetic, comparison and blend operations, so one kernel template is
+// instantiated for scalar tails, AVX2 and AVX-512 alike.
+// Comparisons are ordered and quiet: a NaN lane compares false exactly as
+// the scalar operators do.
+//---------------------------------------------------------------------------------------
+class ScalarMask
+{
+public:
+    bool Value;
+
+public:
+    ScalarMask() = default;
+    ScalarMask(bool value) : Value(value) {}
+
+    ScalarMask operator&(ScalarMask other) const { return Value && other.Value; }
+    ScalarMask operator|(ScalarMask other) const { return Value || other.Value; }
+    ScalarMask operator~() const { return !Value; }
+};
+
+inline bool Any(ScalarMask mask) { return mask.Value; }
+inline bool All(ScalarMask mask) { return mask.Value; }
+inline unsigned Bits(ScalarMask mask) { return mask.Value ? 1u : 0u; }
+
+//---------------------------------------------------------------------------------------
+template <typename TFloat>
+class ScalarPack
+{
+public:
+    using Scalar = TFloat;
+    using Mask   = ScalarMask;
+    using Wide   = ScalarPack<double>;
+
+    static constexpr std::size_t Width = 1;
+
+public:
+    TFloat Value;
+
+public:
+    ScalarPack() = default;
+    ScalarPack(TFloat value) : Value(value) {}
+
+    static ScalarPack Load(const TFloat* source) { return *source; }
+    void Store(TFloat* destination) const { *destination = Value; }
+
+    Wide Widen() const { return static_cast<double>(Value); }
+    static ScalarPack Narrow(Wide wide) { return static_cast<TFloat>(wide.Value); }
+
+    ScalarPack operator+(ScalarPack other) const { return Value + other.Value; }
+    ScalarPack operator-(ScalarPack other) const { return Value - other.Value; }
+    ScalarPack operator*(ScalarPack other) const { return Unfused(Value * other.Value); }
+    ScalarPack operator/(ScalarPack other) const { return Value / other.Value; }
+
+    Mask operator< (ScalarPack other) const { return Value <  other.Value; }
+    Mask operator> (ScalarPack other) const { return Value >  other.Value; }
+    Mask operator<=(ScalarPack other) const { return Value <= other.Value; }
+    Mask operator>=(ScalarPack other) const { return Value >= other.Value; }
+};
+
+template<typename TFloat>
+inline ScalarPack<TFloat> Abs(ScalarPack<TFloat> pack) { return std::abs(pack.Value); }
+
+// Same operand order as std::minmax, which returns the first argument on ties
+template<typename TFloat>
+inline ScalarPack<TFloat> Min(ScalarPack<TFloat> a, ScalarPack<TFloat> b) { return b.Value < a.Value ? b : a; }
+
+template<typename TFloat>
+inline ScalarPack<TFloat> Max(ScalarPack<TFloat> a, ScalarPack<TFloat> b) { return b.Value < a.Value ? a : b; }
+
+template<typename TFloat>
+inline ScalarPack<TFloat> Select(ScalarMask mask, ScalarPack<TFloat> a, ScalarPack<TFloat> b) { return mask.Value ? a : b; }
+
+#ifdef __AVX2__
+//---------------------------------------------------------------------------------------
+class MaskAVX2D
+{
+public:
+    __m256d Value;
+
+public:
+    MaskAVX2D() = default;
+    MaskAVX2D(__m256d value) : Value(value) {}
+
+    MaskAVX2D operator&(MaskAVX2D other) const { return _mm256_and_pd(Value, other.Value); }
+    MaskAVX2D operator|(MaskAVX2D other) const { return _mm256_or_pd (Value, other.Value); }
+    MaskAVX2D operator~() const { return _mm256_xor_pd(Value, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+};
+
+inline bool Any(MaskAVX2D mask) { return _mm256_movemask_pd(mask.Value) != 0; }
+inline bool All(MaskAVX2D mask) { return _mm256_movemask_pd(mask.Value) == 0xF; }
+inline unsigned Bits(MaskAVX2D mask) { return static_cast<unsigned>(_mm256_movemask_pd(mask.Value)); }
+
+//---------------------------------------------------------------------------------------
+class PackAVX2D
+{
+public:
+    using Scalar = double;
+    using Mask   = MaskAVX2D;
+    using Wide   = PackAVX2D;
+
+    static constexpr std::size_t Width = 4;
+
+public:
+    __m256d Value;
+
+public:
+    PackAVX2D() = default;
+    PackAVX2D(__m256d value) : Value(value) {}
+    PackAVX2D(double value) : Value(_mm256_set1_pd(value)) {}
+
+    static PackAVX2D Load(const double* source) { return _mm256_loadu_pd(source); }
+    void Store(double* destination) const { _mm256_storeu_pd(destination, Value); }
+
+    Wide Widen() const { return *this; }
+    static PackAVX2D Narrow(Wide wide) { return wide; }
+
+    PackAVX2D operator+(PackAVX2D other) const { return _mm256_add_pd(Value, other.Value); }
+    PackAVX2D operator-(PackAVX2D other) const { return _mm256_sub_pd(Value, other.Value); }
+    PackAVX2D operator*(PackAVX2D other) const { return Unfused(_mm256_mul_pd(Value, other.Value)); }
+    PackAVX2D operator/(PackAVX2D other) const { return _mm256_div_pd(Value, other.Value); }
+
+    Mask operator< (PackAVX2D other) const { return _mm256_cmp_pd(Value, other.Value, _CMP_LT_OQ); }
+    Mask operator> (PackAVX2D other) const { return _mm256_cmp_pd(Value, other.Value, _CMP_GT_OQ); }
+    Mask operator<=(PackAVX2D other) const { return _mm256_cmp_pd(Value, other.Value, _CMP_LE_OQ); }
+    Mask operator>=(PackAVX2D other) const { return _mm256_cmp_pd(Value, other.Value, _CMP_GE_OQ); }
+};
+
+inline PackAVX2D Abs(PackAVX2D pack) { return _mm256_andnot_pd(_mm256_set1_pd(-0.), pack.Value); }
+inline PackAVX2D Min(PackAVX2D a, PackAVX2D b) { return _mm256_blendv_pd(a.Value, b.Value, (b < a).Value); }
+inline PackAVX2D Max(PackAVX2D a, PackAVX2D b) { return _mm256_blendv_pd(b.Value, a.Value, (b < a).Value); }
+inline PackAVX2D Select(MaskAVX2D mask, PackAVX2D a, PackAVX2D b) { return _mm256_blendv_pd(b.Value, a.Value, mask.Value); }
+
+//---------------------------------------------------------------------------------------
+class MaskAVX2F
+{
+public:
+    __m256 Value;
+
+public:
+    MaskAVX2F() = default;
+    MaskAVX2F(__m256 value) : Value(value) {}
+
+    MaskAVX2F operator&(MaskAVX2F other) const { return _mm256_and_ps(Value, other.Value); }
+    MaskAVX2F operator|(MaskAVX2F other) const { return _mm256_or_ps (Value, other.Value); }
+    MaskAVX2F operator~() const { return _mm256_xor_ps(Value, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+};
+
+inline bool Any(MaskAVX2F mask) { return _mm256_movemask_ps(mask.Value) != 0; }
+inline bool All(MaskAVX2F mask) { return _mm256_movemask_ps(mask.Value) == 0xFF; }
+inline unsigned Bits(MaskAVX2F mask) { return static_cast<unsigned>(_mm256_movemask_ps(mask.Value)); }
+
+//---------------------------------------------------------------------------------------
+// Single precision packs have no Wide type, kernels using them stay in float
+class PackAVX2F
+{
+public:
+    using Scalar = float;
+    using Mask   = MaskAVX2F;
+
+    static constexpr std::size_t Width = 8;
+
+public:
+    __m256 Value;
+
+public:
+    PackAVX2F() = default;
+    PackAVX2F(__m256 value) : Value(value) {}
+    PackAVX2F(float value) : Value(_mm256_set1_ps(value)) {}
+
+    static PackAVX2F Load(const float* source) { return _mm256_loadu_ps(source); }
+    void Store(float* destination) const { _mm256_storeu_ps(destination, Value); }
+
+    PackAVX2F operator+(PackAVX2F other) const { return _mm256_add_ps(Value, other.Value); }
+    PackAVX2F operator-(PackAVX2F other) const { return _mm256_sub_ps(Value, other.Value); }
+    PackAVX2F operator*(PackAVX2F other) const { return Unfused(_mm256_mul_ps(Value, other.Value)); }
+    PackAVX2F operator/(PackAVX2F other) const { return _mm256_div_ps(Value, other.Value); }
+
+    Mask operator< (PackAVX2F other) const { return _mm256_cmp_ps(Value, other.Value, _CMP_LT_OQ); }
+    Mask operator> (PackAVX2F other) const { return _mm256_cmp_ps(Value, other.Value, _CMP_GT_OQ); }
+    Mask operator<=(PackAVX2F other) const { return _mm256_cmp_ps(Value, other.Value, _CMP_LE_OQ); }
+    Mask operator>=(PackAVX2F other) const { return _mm256_cmp_ps(Value, other.Value, _CMP_GE_OQ); }
+};
+
+inline PackAVX2F Abs(PackAVX2F pack) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), pack.Value); }
+inline PackAVX2F Min(PackAVX2F a, PackAVX2F b) { return _mm256_blendv_ps(a.Value, b.Value, (b < a).Value); }
+inline PackAVX2F Max(PackAVX2F a, PackAVX2F b) { return _mm256_blendv_ps(b.Value, a.Value, (b < a).Value); }
+inline PackAVX2F Select(MaskAVX2F mask, PackAVX2F a, PackAVX2F b) { return _mm256_blendv_ps(b.Value, a.Value, mask.Value); }
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+//---------------------------------------------------------------------------------------
+class MaskAVX512D
+{
+public:
+    __mmask8 Value;
+
+public:
+    MaskAVX512D() = default;
+    MaskAVX512D(__mmask8 value) : Value(value) {}
+
+    MaskAVX512D operator&(MaskAVX512D other) const { return static_cast<__mmask8>(Value & other.Value); }
+    MaskAVX512D operator|(MaskAVX512D other) const { return static_cast<__mmask8>(Value | other.Value); }
+    MaskAVX512D operator~() const { return static_cast<__mmask8>(~Value); }
+};
+
+inline bool Any(MaskAVX512D mask) { return mask.Value != 0; }
+inline bool All(MaskAVX512D mask) { return mask.Value == 0xFF; }
+inline unsigned Bits(MaskAVX512D mask) { return mask.Value; }
+
+//---------------------------------------------------------------------------------------
+class PackAVX512D
+{
+public:
+    using Scalar = double;
+    using Mask   = MaskAVX512D;
+    using Wide   = PackAVX512D;
+
+    static constexpr std::size_t Width = 8;
+
+public:
+    __m512d Value;
+
+public:
+    PackAVX512D() = default;
+    PackAVX512D(__m512d value) : Value(value) {}
+    PackAVX512D(double value) : Value(_mm512_set1_pd(value)) {}
+
+    static PackAVX512D Load(const double* source) { return _mm512_loadu_pd(source); }
+    void Store(double* destination) const { _mm512_storeu_pd(destination, Value); }
+
+    Wide Widen() const { return *this; }
+    static PackAVX512D Narrow(Wide wide) { return wide; }
+
+    PackAVX512D operator+(PackAVX512D other) const { return _mm512_add_pd(Value, other.Value); }
+    PackAVX512D operator-(PackAVX512D other) const { return _mm512_sub_pd(Value, other.Value); }
+    PackAVX512D operator*(PackAVX512D other) const { return Unfused(_mm512_mul_pd(Value, other.Value)); }
+    PackAVX512D operator/(PackAVX512D other) const { return _mm512_div_pd(Value, other.Value); }
+
+    Mask operator< (PackAVX512D other) const { return _mm512_cmp_pd_mask(Value, other.Value, _CMP_LT_OQ); }
+    Mask operator> (PackAVX512D other) const { return _mm512_cmp_pd_mask(Value, other.Value, _CMP_GT_OQ); }
+    Mask operator<=(PackAVX512D other) const { return _mm512_cmp_pd_mask(Value, other.Value, _CMP_LE_OQ); }
+    Mask operator>=(PackAVX512D other) const { return _mm512_cmp_pd_mask(Value, other.Value, _CMP_GE_OQ); }
+};
+
+inline PackAVX512D Abs(PackAVX512D pack) { return _mm512_abs_pd(pack.Value); }
+inline PackAVX512D Min(PackAVX512D a, PackAVX512D b) { return _mm512_mask_blend_pd((b < a).Value, a.Value, b.Value); }
+inline PackAVX512D Max(PackAVX512D a, PackAVX512D b) { return _mm512_mask_blend_pd((b < a).Value, b.Value, a.Value); }
+inline PackAVX512D Select(MaskAVX512D mask, PackAVX512D a, PackAVX512D b) { return _mm512_mask_blend_pd(mask.Value, b.Value, a.Value); }
+
+//---------------------------------------------------------------------------------------
+class MaskAVX512F
+{
+public:
+    __mmask16 Value;
+
+public:
+    MaskAVX512F() = default;
+    MaskAVX512F(__mmask16 value) : Value(value) {}
+
+    MaskAVX512F operator&(MaskAVX512F other) const { return static_cast<__mmask16>(Value & other.Value); }
+    MaskAVX512F operator|(MaskAVX512F other) const { return static_cast<__mmask16>(Value | other.Value); }
+    MaskAVX512F operator~() const { return static_cast<__mmask16>(~Value); }
+};
+
+inline bool Any(MaskAVX512F mask) { return mask.Value != 0; }
+inline bool All(MaskAVX512F mask) { return mask.Value == 0xFFFF; }
+inline unsigned Bits(MaskAVX512F mask) { return mask.Value; }
+
+//---------------------------------------------------------------------------------------
+class PackAVX512F
+{
+public:
+    using Scalar = float;
+    using Mask   = MaskAVX512F;
+
+    static constexpr std::size_t Width = 16;
+
+public:
+    __m512 Value;
+
+public:
+    PackAVX512F() = default;
+    PackAVX512F(__m512 value) : Value(value) {}
+    PackAVX512F(float value) : Value(_mm512_set1_ps(value)) {}
+
+    static PackAVX512F Load(const float* source) { return _mm512_loadu_ps(source); }
+    void Store(float* destination) const { _mm512_storeu_ps(destination, Value); }
+
+    PackAVX512F operator+(PackAVX512F other) const { return _mm512_add_ps(Value, other.Value); }
+    PackAVX512F operator-(PackAVX512F other) const { return _mm512_sub_ps(Value, other.Value); }
+    PackAVX512F operator*(PackAVX512F other) const { return Unfused(_mm512_mul_ps(Value, other.Value)); }
+    PackAVX512F operator/(PackAVX512F other) const { return _mm512_div_ps(Value, other.Value); }
+
+    Mask operator< (PackAVX512F other) const { return _mm512_cmp_ps_mask(Value, other.Value, _CMP_LT_OQ); }
+    Mask operator> (PackAVX512F other) const { return _mm512_cmp_ps_mask(Value, other.Value, _CMP_GT_OQ); }
+    Mask operator<=(PackAVX512F other) const { return _mm512_cmp_ps_mask(Value, other.Value, _CMP_LE_OQ); }
+    Mask operator>=(PackAVX512F other) const { return _mm512_cmp_ps_mask(Value, other.Value, _CMP_GE_OQ); }
+};
+
+inline PackAVX512F Abs(PackAVX512F pack) { return _mm512_abs_ps(pack.Value); }
+inline PackAVX512F Min(PackAVX512F a, PackAVX512F b) { return _mm512_mask_blend_ps((b < a).Value, a.Value, b.Value); }
+inline PackAVX512F Max(PackAVX512F a, PackAVX512F b) { return _mm512_mask_blend_ps((b < a).Value, b.Value, a.Value); }
+inline PackAVX512F Select(MaskAVX512F mask, PackAVX512F a, PackAVX512F b) { return _mm512_mask_blend_ps(mask.Value, b.Value, a.Value); }
+#endif // __AVX512F__
+
+//---------------------------------------------------------------------------------------
+// Widest pack the translation unit was compiled for
+template <typename TFloat>
+struct NativePack
+{
+    using Type = ScalarPack<TFloat>;
+};
+
+#if defined(__AVX512F__)
+template <>
+struct NativePack<double>
+{
+    using Type = PackAVX512D;
+};
+#elif defined(__AVX2__)
+template <>
+struct NativePack<double>
+{
+    using Type = PackAVX2D;
+};
+#endif // __AVX512F__
+
+//---------------------------------------------------------------------------------------
+// Widest single precision pack, for kernels that stay in float throughout
+struct NativeFloatPack
+{
+#if defined(__AVX512F__)
+    using Type = PackAVX512F;
+#elif defined(__AVX2__)
+    using Type = PackAVX2F;
+#else
+    using Type = ScalarPack<float>;
+#endif // __AVX512F__
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+//---------------------------------------------------------------------------------------
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+// Each side owns one index and keeps a cached copy of the other, so a push or
+// pop touches the shared cache line of the other side only when its copy
+// says the ring is full or empty. Push() and Pop() wait for room or an item
+// by yielding, which is the backpressure between pipeline stages.
+template <typename T>
+class SpscQueue
+{
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(std::size_t capacity);
+
+    SpscQueue(const SpscQueue&) = delete;
+
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    std::size_t Capacity() const;
+
+    bool TryPush(const T& value);
+
+    bool TryPop(T& value);
+
+    void Push(const T& value);
+
+    T Pop();
+
+private:
+    std::unique_ptr<T[]> Items;
+    std::size_t          Mask = 0;
+
+    alignas(64) std::atomic<std::size_t> Tail{ 0 }; // written by the producer
+    std::size_t                          HeadCache = 0;
+
+    alignas(64) std::atomic<std::size_t> Head{ 0 }; // written by the consumer
+    std::size_t                          TailCache = 0;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline SpscQueue<T>::SpscQueue
+(
+    std::size_t capacity
+)
+{
+    std::size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+
+    Items.reset(new T[size]);
+    Mask = size - 1;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline std::size_t SpscQueue<T>::Capacity() const
+{
+    return Mask + 1;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline bool SpscQueue<T>::TryPush
+(
+    const T& value
+)
+{
+    const std::size_t tail = Tail.load(std::memory_order_relaxed);
+    if (tail - HeadCache > Mask) {
+        HeadCache = Head.load(std::memory_order_acquire);
+        if (tail - HeadCache > Mask)
+            return false;
+    }
+
+    Items[tail & Mask] = value;
+    Tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline bool SpscQueue<T>::TryPop
+(
+    T& value
+)
+{
+    const std::size_t head = Head.load(std::memory_order_relaxed);
+    if (head == TailCache) {
+        TailCache = Tail.load(std::memory_order_acquire);
+        if (head == TailCache)
+            return false;
+    }
+
+    value = Items[head & Mask];
+    Head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline void SpscQueue<T>::Push
+(
+    const T& value
+)
+{
+    while (!TryPush(value))
+        std::this_thread::yield();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline T SpscQueue<T>::Pop()
+{
+    T value;
+    while (!TryPop(value))
+        std::this_thread::yield();
+
+    return value;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <type_traits>
+
+//---------------------------------------------------------------------------------------
+// A product the compiler may not fuse with the sum or difference it feeds.
+// With FMA enabled (-mfma, -march=native, any AArch64) GCC contracts a * b + c
+// into one fused operation, in ISO mode too, and does it differently in the
+// scalar and the batch code, so the eps decisions of Segment3::Intersection
+// would depend on the build. Every product of the scalar and batch paths goes
+// through here, which gives the rounding of -ffp-contract=off with any flags.
+// An empty asm statement pins the product to a register; GCC's own
+// __builtin_assoc_barrier is lost once the SLP vectorizer merges two products.
+// MSVC does not contract under /fp:precise and needs nothing.
+namespace UnfusedDetail
+{
+#if defined(__GNUC__) && \
+    (((defined(__x86_64__) || defined(__i386__)) && defined(__FMA__)) || defined(__aarch64__))
+    template<typename T>
+    inline T Barrier(T product)
+    {
+#if defined(__aarch64__)
+        __asm__("" : "+w"(product));
+#else
+        __asm__("" : "+v"(product));
+#endif
+        return product;
+    }
+
+    constexpr bool Enabled = true;
+#else
+    template<typename T>
+    inline T Barrier(T product)
+    {
+        return product;
+    }
+
+    constexpr bool Enabled = false;
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+template<typename T>
+inline constexpr T Unfused(T product)
+{
+    if constexpr (UnfusedDetail::Enabled &&
+                  !std::is_integral_v<T> && !std::is_same_v<T, long double>)
+    {
+        if (!__builtin_is_constant_evaluated())
+            return UnfusedDetail::Barrier(product);
+    }
+
+    return product;
+}
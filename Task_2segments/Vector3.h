@@ -1,89 +1,103 @@
 #pragma once
+#include "Unfused.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <type_traits>
 
 //---------------------------------------------------------------------------------------
+// Integer coordinates compare exactly and are meant for the exact predicates
+// and Segment3::IntersectionRational, see Vector3Rational.h
 template <typename TFloat>
 class Vector3
 {
     static_assert(
-        std::is_floating_point_v<TFloat>,
-        "Vector3 requires floating point type"
+        std::is_floating_point_v<TFloat> ||
+        std::is_same_v<TFloat, std::int32_t> ||
+        std::is_same_v<TFloat, std::int64_t>,
+        "Vector3 requires floating point, int32 or int64 type"
     );
 
 public:
-    static const TFloat eps;
+    static constexpr TFloat eps =
+        std::is_integral_v<TFloat>       ? TFloat(0)     :
+        std::is_same_v<TFloat, float>    ? TFloat(1e-7f) : TFloat(1e-15);
 
 public:
-    struct {
-        TFloat X;
-        TFloat Y;
-        TFloat Z;
-    };
+    TFloat X;
+    TFloat Y;
+    TFloat Z;
 
 public:
-    Vector3();
+    constexpr Vector3();
 
-    Vector3(TFloat value);
+    constexpr Vector3(TFloat value);
 
-    Vector3(TFloat x, TFloat y, TFloat z);
+    constexpr Vector3(TFloat x, TFloat y, TFloat z);
 
-    bool operator==(const Vector3<TFloat>& other) const;
+    constexpr bool operator==(const Vector3<TFloat>& other) const;
 
-    bool operator!=(const Vector3<TFloat>& other) const;
+    constexpr bool operator!=(const Vector3<TFloat>& other) const;
 
-    Vector3<TFloat> operator+(const Vector3<TFloat>& other) const;
+    constexpr Vector3<TFloat> operator+(const Vector3<TFloat>& other) const;
 
-    Vector3<TFloat> operator-(const Vector3<TFloat>& other) const;
+    constexpr Vector3<TFloat> operator-(const Vector3<TFloat>& other) const;
 
-    Vector3<TFloat>& operator+=(const Vector3<TFloat>& other);
+    constexpr Vector3<TFloat>& operator+=(const Vector3<TFloat>& other);
 
-    Vector3<TFloat>& operator-=(const Vector3<TFloat>& other);
+    constexpr Vector3<TFloat>& operator-=(const Vector3<TFloat>& other);
 
     template<typename TArg>
-    Vector3<TFloat> operator*(TArg scale) const;
+    constexpr Vector3<TFloat> operator*(TArg scale) const;
 
     template<typename TArg>
-    Vector3<TFloat> operator/(TArg scale) const;
+    constexpr Vector3<TFloat> operator/(TArg scale) const;
 
     template<typename TArg>
-    Vector3<TFloat>& operator*=(TArg scale);
+    constexpr Vector3<TFloat>& operator*=(TArg scale);
 
     template<typename TArg>
-    Vector3<TFloat>& operator/=(TArg scale);
+    constexpr Vector3<TFloat>& operator/=(TArg scale);
 
-    bool IsValid() const;
+    constexpr bool IsValid() const;
 
     TFloat Size() const;
 
+    // Not constexpr, which would make it inline: inlined into Segment3::Intersection
+    // it slows the scalar path down clearly, most on the disjoint, skew and
+    // point classes of the benchmark, whose pairs leave early
     TFloat SizeSquared() const;
 
     Vector3<TFloat>& Normalize();
 
-    TFloat Dot(const Vector3<TFloat>& other) const;
+    constexpr TFloat Dot(const Vector3<TFloat>& other) const;
 
-    Vector3<TFloat> Cross(const Vector3<TFloat>& other) const;
+    constexpr Vector3<TFloat> Cross(const Vector3<TFloat>& other) const;
 
 public:
-    static TFloat DotProduct(
+    static constexpr TFloat DotProduct(
         const Vector3<TFloat>& first,
         const Vector3<TFloat>& second
     );
 
-    static Vector3<TFloat> CrossProduct(
+    static constexpr Vector3<TFloat> CrossProduct(
         const Vector3<TFloat>& first,
         const Vector3<TFloat>& second
     );
 
-    static TFloat TripleProduct(
+    static constexpr TFloat TripleProduct(
         const Vector3<TFloat>& first,
         const Vector3<TFloat>& second,
         const Vector3<TFloat>& third
     );
+
+private:
+    static constexpr TFloat Abs(TFloat value);
 };
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat>::Vector3()
+inline constexpr Vector3<TFloat>::Vector3()
   :
     X(0.),
     Y(0.),
@@ -92,7 +106,7 @@ inline Vector3<TFloat>::Vector3()
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat>::Vector3
+inline constexpr Vector3<TFloat>::Vector3
 (
     TFloat value
 ) :
@@ -103,7 +117,7 @@ inline Vector3<TFloat>::Vector3
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat>::Vector3
+inline constexpr Vector3<TFloat>::Vector3
 (
     TFloat x,
     TFloat y,
@@ -116,37 +130,43 @@ inline Vector3<TFloat>::Vector3
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline bool Vector3<TFloat>::operator==
+inline constexpr bool Vector3<TFloat>::operator==
 (
     const Vector3<TFloat>& other
 )
 const
 {
+    if constexpr (std::is_integral_v<TFloat>)
+        return X == other.X && Y == other.Y && Z == other.Z;
+
     return (
-        std::abs(X - other.X) < eps &&
-        std::abs(Y - other.Y) < eps &&
-        std::abs(Z - other.Z) < eps
+        Abs(X - other.X) < eps &&
+        Abs(Y - other.Y) < eps &&
+        Abs(Z - other.Z) < eps
     );
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline bool Vector3<TFloat>::operator!=
+inline constexpr bool Vector3<TFloat>::operator!=
 (
     const Vector3<TFloat>& other
 )
 const
 {
+    if constexpr (std::is_integral_v<TFloat>)
+        return X != other.X || Y != other.Y || Z != other.Z;
+
     return (
-        std::abs(X - other.X) >= eps ||
-        std::abs(Y - other.Y) >= eps ||
-        std::abs(Z - other.Z) >= eps
+        Abs(X - other.X) >= eps ||
+        Abs(Y - other.Y) >= eps ||
+        Abs(Z - other.Z) >= eps
     );
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat> Vector3<TFloat>::operator+
+inline constexpr Vector3<TFloat> Vector3<TFloat>::operator+
 (
     const Vector3<TFloat>& other
 )
@@ -161,7 +181,7 @@ const
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat> Vector3<TFloat>::operator-
+inline constexpr Vector3<TFloat> Vector3<TFloat>::operator-
 (
     const Vector3<TFloat>& other
 )
@@ -176,7 +196,7 @@ const
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat>& Vector3<TFloat>::operator+=
+inline constexpr Vector3<TFloat>& Vector3<TFloat>::operator+=
 (
     const Vector3<TFloat>& other
 )
@@ -190,7 +210,7 @@ inline Vector3<TFloat>& Vector3<TFloat>::operator+=
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat>& Vector3<TFloat>::operator-=
+inline constexpr Vector3<TFloat>& Vector3<TFloat>::operator-=
 (
     const Vector3<TFloat>& other
 )
@@ -205,7 +225,7 @@ inline Vector3<TFloat>& Vector3<TFloat>::operator-=
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
     template<typename TArg>
-Vector3<TFloat> Vector3<TFloat>::operator*
+inline constexpr Vector3<TFloat> Vector3<TFloat>::operator*
 (
     TArg scale
 )
@@ -217,15 +237,15 @@ const
     );
 
     return {
-        X * scale,
-        Y * scale,
-        Z * scale
+        static_cast<TFloat>(Unfused(X * scale)),
+        static_cast<TFloat>(Unfused(Y * scale)),
+        static_cast<TFloat>(Unfused(Z * scale))
     };
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat, typename TArg>
-Vector3<TFloat> operator*
+inline constexpr Vector3<TFloat> operator*
 (
     TArg scale,
     Vector3<TFloat> vector
@@ -237,16 +257,16 @@ Vector3<TFloat> operator*
     );
 
     return {
-        vector.X * scale,
-        vector.Y * scale,
-        vector.Z * scale
+        static_cast<TFloat>(Unfused(vector.X * scale)),
+        static_cast<TFloat>(Unfused(vector.Y * scale)),
+        static_cast<TFloat>(Unfused(vector.Z * scale))
     };
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
     template<typename TArg>
-Vector3<TFloat> Vector3<TFloat>::operator/
+inline constexpr Vector3<TFloat> Vector3<TFloat>::operator/
 (
     TArg scale
 )
@@ -258,15 +278,15 @@ const
     );
 
     return {
-        X / scale,
-        Y / scale,
-        Z / scale
+        static_cast<TFloat>(X / scale),
+        static_cast<TFloat>(Y / scale),
+        static_cast<TFloat>(Z / scale)
     };
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat, typename TArg>
-Vector3<TFloat> operator/
+inline constexpr Vector3<TFloat> operator/
 (
     TArg scale,
     Vector3<TFloat> vector
@@ -278,16 +298,16 @@ Vector3<TFloat> operator/
         );
 
     return {
-        vector.X / scale,
-        vector.Y / scale,
-        vector.Z / scale
+        static_cast<TFloat>(vector.X / scale),
+        static_cast<TFloat>(vector.Y / scale),
+        static_cast<TFloat>(vector.Z / scale)
     };
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
     template<typename TArg>
-Vector3<TFloat>& Vector3<TFloat>::operator*=
+inline constexpr Vector3<TFloat>& Vector3<TFloat>::operator*=
 (
     TArg scale
 )
@@ -297,9 +317,9 @@ Vector3<TFloat>& Vector3<TFloat>::operator*=
         "Vector3 scaling requires arithmetic type"
     );
 
-    X *= scale;
-    Y *= scale;
-    Z *= scale;
+    X = static_cast<TFloat>(Unfused(X * scale));
+    Y = static_cast<TFloat>(Unfused(Y * scale));
+    Z = static_cast<TFloat>(Unfused(Z * scale));
 
     return *this;
 }
@@ -307,7 +327,7 @@ Vector3<TFloat>& Vector3<TFloat>::operator*=
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
     template<typename TArg>
-Vector3<TFloat>& Vector3<TFloat>::operator/=
+inline constexpr Vector3<TFloat>& Vector3<TFloat>::operator/=
 (
     TArg scale
 )
@@ -325,24 +345,29 @@ Vector3<TFloat>& Vector3<TFloat>::operator/=
 }
 
 //---------------------------------------------------------------------------------------
+// Comparisons with NaN are false and infinities are out of range, so the
+// check works in constant expressions where std::isnan does not. Every
+// integer vector is valid.
 template<typename TFloat>
-bool Vector3<TFloat>::IsValid() const
+inline constexpr bool Vector3<TFloat>::IsValid() const
 {
+    if constexpr (std::is_integral_v<TFloat>)
+        return true;
+
+    constexpr TFloat largest = std::numeric_limits<TFloat>::max();
+
     return (
-        !isnan(X) &&
-        !isnan(Y) &&
-        !isnan(Z) &&
-        !isinf(X) &&
-        !isinf(Y) &&
-        !isinf(Z)
+        -largest <= X && X <= largest &&
+        -largest <= Y && Y <= largest &&
+        -largest <= Z && Z <= largest
     );
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-TFloat Vector3<TFloat>::Size() const
+inline TFloat Vector3<TFloat>::Size() const
 {
-    return sqrt(SizeSquared());
+    return std::sqrt(SizeSquared());
 }
 
 //---------------------------------------------------------------------------------------
@@ -350,55 +375,55 @@ template<typename TFloat>
 TFloat Vector3<TFloat>::SizeSquared() const
 {
     if (!IsValid())
-        return NAN;
+        return std::numeric_limits<TFloat>::quiet_NaN();
 
     return (
-        X * X +
-        Y * Y +
-        Z * Z
+        Unfused(X * X) +
+        Unfused(Y * Y) +
+        Unfused(Z * Z)
     );
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-Vector3<TFloat>& Vector3<TFloat>::Normalize()
+inline Vector3<TFloat>& Vector3<TFloat>::Normalize()
 {
     return *this /= Size();
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline TFloat Vector3<TFloat>::Dot
+inline constexpr TFloat Vector3<TFloat>::Dot
 (
     const Vector3<TFloat>& other
 )
 const
 {
     return (
-        X * other.X +
-        Y * other.Y +
-        Z * other.Z
+        Unfused(X * other.X) +
+        Unfused(Y * other.Y) +
+        Unfused(Z * other.Z)
     );
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat> Vector3<TFloat>::Cross
+inline constexpr Vector3<TFloat> Vector3<TFloat>::Cross
 (
     const Vector3<TFloat>& other
 )
 const
 {
     return {
-        Y * other.Z - Z * other.Y,
-        Z * other.X - X * other.Z,
-        X * other.Y - Y * other.X
+        Unfused(Y * other.Z) - Unfused(Z * other.Y),
+        Unfused(Z * other.X) - Unfused(X * other.Z),
+        Unfused(X * other.Y) - Unfused(Y * other.X)
     };
 }
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline TFloat Vector3<TFloat>::DotProduct
+inline constexpr TFloat Vector3<TFloat>::DotProduct
 (
     const Vector3<TFloat>& first,
     const Vector3<TFloat>& second
@@ -409,7 +434,7 @@ inline TFloat Vector3<TFloat>::DotProduct
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline Vector3<TFloat> Vector3<TFloat>::CrossProduct
+inline constexpr Vector3<TFloat> Vector3<TFloat>::CrossProduct
 (
     const Vector3<TFloat>& first,
     const Vector3<TFloat>& second
@@ -420,7 +445,7 @@ inline Vector3<TFloat> Vector3<TFloat>::CrossProduct
 
 //---------------------------------------------------------------------------------------
 template<typename TFloat>
-inline TFloat Vector3<TFloat>::TripleProduct
+inline constexpr TFloat Vector3<TFloat>::TripleProduct
 (
     const Vector3<TFloat>& first,
     const Vector3<TFloat>& second,
@@ -431,9 +456,25 @@ inline TFloat Vector3<TFloat>::TripleProduct
 }
 
 //---------------------------------------------------------------------------------------
-using Vector3F = Vector3<float>;
-using Vector3D = Vector3<double>;
+// std::abs is not constexpr before C++23. The comparison is only used in
+// constant evaluation, at run time it compiles to branches where std::abs is
+// a single mask and makes the eps comparisons in Segment3 noticeably slower.
+template<typename TFloat>
+inline constexpr TFloat Vector3<TFloat>::Abs
+(
+    TFloat value
+)
+{
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+    if (!__builtin_is_constant_evaluated())
+        return std::abs(value);
+#endif
+
+    return value < 0 ? -value : value;
+}
 
 //---------------------------------------------------------------------------------------
-const float  Vector3F::eps = 1e-7f;
-const double Vector3D::eps = 1e-15;
+using Vector3F = Vector3<float>;
+using Vector3D = Vector3<double>;
+using Vector3I = Vector3<std::int32_t>;
+using Vector3L = Vector3<std::int64_t>;
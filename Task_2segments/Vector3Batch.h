@@ -0,0 +1,280 @@
+#pragma once
+#include "Vector3.h"
+#include "AlignedAllocator.h"
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Structure-of-arrays storage for Vector3: separate X, Y and Z arrays
+template <typename TFloat>
+class Vector3Batch
+{
+public:
+    using Array = std::vector<TFloat, AlignedAllocator<TFloat>>;
+
+public:
+    Array X;
+    Array Y;
+    Array Z;
+
+public:
+    Vector3Batch() = default;
+
+    Vector3Batch(std::size_t size);
+
+    std::size_t Size() const;
+
+    void Resize(std::size_t size);
+
+    void Reserve(std::size_t capacity);
+
+    void Clear();
+
+    void PushBack(const Vector3<TFloat>& vector);
+
+    Vector3<TFloat> Get(std::size_t index) const;
+
+    void Set(std::size_t index, const Vector3<TFloat>& vector);
+};
+
+//---------------------------------------------------------------------------------------
+// Three lanes-wide packs viewed as one Vector3 per lane
+template <typename TPack>
+class Vector3Pack
+{
+public:
+    using TFloat = typename TPack::Scalar;
+
+public:
+    TPack X;
+    TPack Y;
+    TPack Z;
+
+public:
+    Vector3Pack() = default;
+
+    Vector3Pack(TPack x, TPack y, TPack z);
+
+    static Vector3Pack<TPack> Load(
+        const Vector3Batch<TFloat>& batch,
+        std::size_t index
+    );
+
+    void Store(
+        Vector3Batch<TFloat>& batch,
+        std::size_t index
+    ) const;
+
+    Vector3Pack<TPack> operator+(const Vector3Pack<TPack>& other) const;
+
+    Vector3Pack<TPack> operator-(const Vector3Pack<TPack>& other) const;
+
+    TPack SizeSquared() const;
+
+    TPack Dot(const Vector3Pack<TPack>& other) const;
+
+    Vector3Pack<TPack> Cross(const Vector3Pack<TPack>& other) const;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Vector3Batch<TFloat>::Vector3Batch
+(
+    std::size_t size
+) :
+    X(size),
+    Y(size),
+    Z(size)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline std::size_t Vector3Batch<TFloat>::Size() const
+{
+    return X.size();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Vector3Batch<TFloat>::Resize
+(
+    std::size_t size
+)
+{
+    X.resize(size);
+    Y.resize(size);
+    Z.resize(size);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Vector3Batch<TFloat>::Reserve
+(
+    std::size_t capacity
+)
+{
+    X.reserve(capacity);
+    Y.reserve(capacity);
+    Z.reserve(capacity);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Vector3Batch<TFloat>::Clear()
+{
+    X.clear();
+    Y.clear();
+    Z.clear();
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Vector3Batch<TFloat>::PushBack
+(
+    const Vector3<TFloat>& vector
+)
+{
+    X.push_back(vector.X);
+    Y.push_back(vector.Y);
+    Z.push_back(vector.Z);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline Vector3<TFloat> Vector3Batch<TFloat>::Get
+(
+    std::size_t index
+)
+const
+{
+    return { X[index], Y[index], Z[index] };
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+inline void Vector3Batch<TFloat>::Set
+(
+    std::size_t index,
+    const Vector3<TFloat>& vector
+)
+{
+    X[index] = vector.X;
+    Y[index] = vector.Y;
+    Z[index] = vector.Z;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline Vector3Pack<TPack>::Vector3Pack
+(
+    TPack x,
+    TPack y,
+    TPack z
+) :
+    X(x),
+    Y(y),
+    Z(z)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline Vector3Pack<TPack> Vector3Pack<TPack>::Load
+(
+    const Vector3Batch<TFloat>& batch,
+    std::size_t index
+)
+{
+    return {
+        TPack::Load(batch.X.data() + index),
+        TPack::Load(batch.Y.data() + index),
+        TPack::Load(batch.Z.data() + index)
+    };
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline void Vector3Pack<TPack>::Store
+(
+    Vector3Batch<TFloat>& batch,
+    std::size_t index
+)
+const
+{
+    X.Store(batch.X.data() + index);
+    Y.Store(batch.Y.data() + index);
+    Z.Store(batch.Z.data() + index);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline Vector3Pack<TPack> Vector3Pack<TPack>::operator+
+(
+    const Vector3Pack<TPack>& other
+)
+const
+{
+    return {
+        X + other.X,
+        Y + other.Y,
+        Z + other.Z
+    };
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline Vector3Pack<TPack> Vector3Pack<TPack>::operator-
+(
+    const Vector3Pack<TPack>& other
+)
+const
+{
+    return {
+        X - other.X,
+        Y - other.Y,
+        Z - other.Z
+    };
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline TPack Vector3Pack<TPack>::SizeSquared() const
+{
+    return (
+        X * X +
+        Y * Y +
+        Z * Z
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline TPack Vector3Pack<TPack>::Dot
+(
+    const Vector3Pack<TPack>& other
+)
+const
+{
+    return (
+        X * other.X +
+        Y * other.Y +
+        Z * other.Z
+    );
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TPack>
+inline Vector3Pack<TPack> Vector3Pack<TPack>::Cross
+(
+    const Vector3Pack<TPack>& other
+)
+const
+{
+    return {
+        Y * other.Z - Z * other.Y,
+        Z * other.X - X * other.Z,
+        X * other.Y - Y * other.X
+    };
+}
+
+//---------------------------------------------------------------------------------------
+using Vector3BatchF = Vector3Batch<float>;
+using Vector3BatchD = Vector3Batch<double>;
@@ -0,0 +1,126 @@
+#pragma once
+#include "Vector3.h"
+#include "WideInteger.h"
+#include <cmath>
+#include <type_traits>
+
+//---------------------------------------------------------------------------------------
+// Exact point with rational coordinates X / Denominator, Y / Denominator,
+// Z / Denominator over integer coordinates of type TInt, as returned by
+// Segment3::IntersectionRational. The denominator is positive, zero marks
+// the absence of a point like the NaN vector of the floating point versions.
+// Nothing is rounded until ToVector().
+template <typename TInt>
+struct Vector3Rational
+{
+    static_assert(
+        std::is_integral_v<TInt>,
+        "Vector3Rational requires integer type"
+    );
+
+    using Wide = WideIntegerFor<TInt>;
+
+    Wide X;
+    Wide Y;
+    Wide Z;
+    Wide Denominator;
+
+    // No point
+    constexpr Vector3Rational();
+
+    constexpr Vector3Rational(const Vector3<TInt>& point);
+
+    // The sign of the denominator is moved to the numerators
+    constexpr Vector3Rational(
+        const Wide& x,
+        const Wide& y,
+        const Wide& z,
+        const Wide& denominator
+    );
+
+    constexpr bool IsValid() const;
+
+    // Denominator 1, as for the endpoints; fractions are not reduced
+    constexpr bool IsInteger() const;
+
+    // Every coordinate within two ulps of the exact value, NaN without a point
+    template<typename TFloat>
+    Vector3<TFloat> ToVector() const;
+};
+
+//---------------------------------------------------------------------------------------
+template<typename TInt>
+inline constexpr Vector3Rational<TInt>::Vector3Rational()
+  :
+    X(),
+    Y(),
+    Z(),
+    Denominator()
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TInt>
+inline constexpr Vector3Rational<TInt>::Vector3Rational
+(
+    const Vector3<TInt>& point
+) :
+    X(point.X),
+    Y(point.Y),
+    Z(point.Z),
+    Denominator(1)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TInt>
+inline constexpr Vector3Rational<TInt>::Vector3Rational
+(
+    const Wide& x,
+    const Wide& y,
+    const Wide& z,
+    const Wide& denominator
+) :
+    X(denominator.IsNegative() ? -x : x),
+    Y(denominator.IsNegative() ? -y : y),
+    Z(denominator.IsNegative() ? -z : z),
+    Denominator(denominator.IsNegative() ? -denominator : denominator)
+{}
+
+//---------------------------------------------------------------------------------------
+template<typename TInt>
+inline constexpr bool Vector3Rational<TInt>::IsValid() const
+{
+    return Denominator.Sign() > 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TInt>
+inline constexpr bool Vector3Rational<TInt>::IsInteger() const
+{
+    return Denominator == Wide(1);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TInt>
+    template<typename TFloat>
+inline Vector3<TFloat> Vector3Rational<TInt>::ToVector() const
+{
+    static_assert(
+        std::is_floating_point_v<TFloat>,
+        "Vector3Rational converts to floating point type"
+    );
+
+    if (!IsValid())
+        return Vector3<TFloat>(NAN);
+
+    const double denominator = Denominator.ToDouble();
+
+    return {
+        static_cast<TFloat>(X.ToDouble() / denominator),
+        static_cast<TFloat>(Y.ToDouble() / denominator),
+        static_cast<TFloat>(Z.ToDouble() / denominator)
+    };
+}
+
+//---------------------------------------------------------------------------------------
+using Vector3RationalI = Vector3Rational<std::int32_t>;
+using Vector3RationalL = Vector3Rational<std::int64_t>;
@@ -0,0 +1,233 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//---------------------------------------------------------------------------------------
+// Fixed width two's complement integer of 32-bit limbs for exact predicates
+// on integer coordinates. Arithmetic wraps modulo 2^Bits like the built-in
+// unsigned types; callers pick a width the values provably fit in.
+template <std::size_t Bits>
+class WideInteger
+{
+    static_assert(
+        Bits >= 64 && Bits % 32 == 0,
+        "WideInteger requires a multiple of 32 bits, at least 64"
+    );
+
+public:
+    static constexpr std::size_t Limbs = Bits / 32;
+
+public:
+    constexpr WideInteger();
+
+    constexpr WideInteger(std::int64_t value);
+
+    constexpr WideInteger<Bits> operator+(const WideInteger<Bits>& other) const;
+
+    constexpr WideInteger<Bits> operator-(const WideInteger<Bits>& other) const;
+
+    constexpr WideInteger<Bits> operator-() const;
+
+    constexpr WideInteger<Bits> operator*(const WideInteger<Bits>& other) const;
+
+    constexpr bool operator==(const WideInteger<Bits>& other) const;
+
+    constexpr bool operator!=(const WideInteger<Bits>& other) const;
+
+    constexpr bool operator<(const WideInteger<Bits>& other) const;
+
+    constexpr int Sign() const;
+
+    constexpr bool IsNegative() const;
+
+    // Rounded to the nearest double up to one ulp
+    double ToDouble() const;
+
+private:
+    std::uint32_t Limb[Limbs]; // least significant first
+};
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr WideInteger<Bits>::WideInteger()
+  :
+    Limb()
+{}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr WideInteger<Bits>::WideInteger
+(
+    std::int64_t value
+) :
+    Limb()
+{
+    const std::uint64_t bits = static_cast<std::uint64_t>(value);
+    const std::uint32_t fill = value < 0 ? 0xFFFFFFFFu : 0u;
+
+    Limb[0] = static_cast<std::uint32_t>(bits);
+    Limb[1] = static_cast<std::uint32_t>(bits >> 32);
+    for (std::size_t i = 2; i < Limbs; ++i)
+        Limb[i] = fill;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr WideInteger<Bits> WideInteger<Bits>::operator+
+(
+    const WideInteger<Bits>& other
+)
+const
+{
+    WideInteger<Bits> result;
+
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < Limbs; ++i) {
+        carry += static_cast<std::uint64_t>(Limb[i]) + other.Limb[i];
+        result.Limb[i] = static_cast<std::uint32_t>(carry);
+        carry >>= 32;
+    }
+
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr WideInteger<Bits> WideInteger<Bits>::operator-
+(
+    const WideInteger<Bits>& other
+)
+const
+{
+    return *this + -other;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr WideInteger<Bits> WideInteger<Bits>::operator-() const
+{
+    WideInteger<Bits> result;
+
+    std::uint64_t carry = 1;
+    for (std::size_t i = 0; i < Limbs; ++i) {
+        carry += static_cast<std::uint32_t>(~Limb[i]);
+        result.Limb[i] = static_cast<std::uint32_t>(carry);
+        carry >>= 32;
+    }
+
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+// Schoolbook product of the low limbs, truncated: modulo 2^Bits the product
+// of two's complement numbers is the product of their unsigned bit patterns
+template<std::size_t Bits>
+inline constexpr WideInteger<Bits> WideInteger<Bits>::operator*
+(
+    const WideInteger<Bits>& other
+)
+const
+{
+    WideInteger<Bits> result;
+
+    for (std::size_t i = 0; i < Limbs; ++i) {
+        if (Limb[i] == 0)
+            continue;
+
+        std::uint64_t carry = 0;
+        for (std::size_t j = 0; i + j < Limbs; ++j) {
+            carry += static_cast<std::uint64_t>(Limb[i]) * other.Limb[j] + result.Limb[i + j];
+            result.Limb[i + j] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+    }
+
+    return result;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr bool WideInteger<Bits>::operator==
+(
+    const WideInteger<Bits>& other
+)
+const
+{
+    for (std::size_t i = 0; i < Limbs; ++i)
+        if (Limb[i] != other.Limb[i])
+            return false;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr bool WideInteger<Bits>::operator!=
+(
+    const WideInteger<Bits>& other
+)
+const
+{
+    return !(*this == other);
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr bool WideInteger<Bits>::operator<
+(
+    const WideInteger<Bits>& other
+)
+const
+{
+    if (IsNegative() != other.IsNegative())
+        return IsNegative();
+
+    for (std::size_t i = Limbs; i-- > 0;)
+        if (Limb[i] != other.Limb[i])
+            return Limb[i] < other.Limb[i];
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr int WideInteger<Bits>::Sign() const
+{
+    if (IsNegative())
+        return -1;
+
+    for (std::size_t i = 0; i < Limbs; ++i)
+        if (Limb[i] != 0)
+            return 1;
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline constexpr bool WideInteger<Bits>::IsNegative() const
+{
+    return (Limb[Limbs - 1] >> 31) != 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<std::size_t Bits>
+inline double WideInteger<Bits>::ToDouble() const
+{
+    if (IsNegative())
+        return -(-*this).ToDouble();
+
+    double value = 0.;
+    for (std::size_t i = Limbs; i-- > 0;)
+        value = value * 4294967296. + Limb[i];
+
+    return value;
+}
+
+//---------------------------------------------------------------------------------------
+// Width for the exact arithmetic on TInt coordinates: 128 bits for int32 and
+// 256 for int64. The largest values are the Orient3D determinant, three
+// coordinate differences multiplied, and the numerators of the points of
+// Segment3::IntersectionRational, about 3 * (bits + 1) + 3 bits either way.
+template<typename TInt>
+using WideIntegerFor = WideInteger<32 * sizeof(TInt)>;
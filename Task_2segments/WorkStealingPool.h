@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Fixed set of worker threads running index-space loops. Every worker owns a
+// contiguous range of task indices and takes tasks from its front; a worker
+// that runs dry steals the upper half of the largest remaining range of
+// another worker, so uneven per-task costs even out without a central queue.
+// The calling thread takes part as worker 0. ParallelFor is not reentrant.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(std::size_t threads = 0);
+
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Number of workers including the calling thread
+    std::size_t Threads() const;
+
+    // Number of successful steals during the last ParallelFor
+    std::size_t Steals() const;
+
+    // Runs task(index, worker) for every index in [0, count) and waits
+    template<typename TTask>
+    void ParallelFor(std::size_t count, TTask&& task);
+
+private:
+    struct alignas(64) Queue {
+        std::mutex  Lock;
+        std::size_t Begin = 0;
+        std::size_t End   = 0;
+    };
+
+    bool Pop(std::size_t worker, std::size_t& index);
+
+    bool Steal(std::size_t worker, std::size_t& index);
+
+    void Work(std::size_t worker);
+
+    void Loop(std::size_t worker);
+
+private:
+    std::vector<std::thread>  Workers;
+    std::unique_ptr<Queue[]>  Queues;
+    std::size_t               Count = 1;
+
+    std::mutex                Lock;
+    std::condition_variable   Wake;
+    std::condition_variable   Done;
+    std::size_t               Generation = 0;
+    std::size_t               Busy       = 0;
+    bool                      Stop       = false;
+
+    void (*Invoke)(void*, std::size_t, std::size_t) = nullptr;
+    void*                     Context = nullptr;
+    std::atomic<std::size_t>  Stolen{ 0 };
+};
+
+//---------------------------------------------------------------------------------------
+inline WorkStealingPool::WorkStealingPool
+(
+    std::size_t threads
+) :
+    Count(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    Queues.reset(new Queue[Count]);
+
+    Workers.reserve(Count - 1);
+    for (std::size_t worker = 1; worker < Count; ++worker)
+        Workers.emplace_back(&WorkStealingPool::Loop, this, worker);
+}
+
+//---------------------------------------------------------------------------------------
+inline WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(Lock);
+        Stop = true;
+    }
+    Wake.notify_all();
+
+    for (std::thread& worker : Workers)
+        worker.join();
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t WorkStealingPool::Threads() const
+{
+    return Count;
+}
+
+//---------------------------------------------------------------------------------------
+inline std::size_t WorkStealingPool::Steals() const
+{
+    return Stolen.load(std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TTask>
+inline void WorkStealingPool::ParallelFor
+(
+    std::size_t count,
+    TTask&& task
+)
+{
+    if (count == 0)
+        return;
+
+    if (Count == 1 || count == 1) {
+        for (std::size_t index = 0; index < count; ++index)
+            task(index, static_cast<std::size_t>(0));
+        return;
+    }
+
+    for (std::size_t worker = 0; worker < Count; ++worker) {
+        std::lock_guard<std::mutex> guard(Queues[worker].Lock);
+        Queues[worker].Begin = count *  worker      / Count;
+        Queues[worker].End   = count * (worker + 1) / Count;
+    }
+
+    using TFunction = typename std::remove_reference<TTask>::type;
+    Context = const_cast<void*>(static_cast<const void*>(&task));
+    Invoke  = [](void* context, std::size_t index, std::size_t worker) {
+        (*static_cast<TFunction*>(context))(index, worker);
+    };
+    Stolen.store(0, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> guard(Lock);
+        Busy = Count - 1;
+        ++Generation;
+    }
+    Wake.notify_all();
+
+    Work(0);
+
+    std::unique_lock<std::mutex> guard(Lock);
+    Done.wait(guard, [this] { return Busy == 0; });
+}
+
+//---------------------------------------------------------------------------------------
+inline bool WorkStealingPool::Pop
+(
+    std::size_t worker,
+    std::size_t& index
+)
+{
+    Queue& queue = Queues[worker];
+    std::lock_guard<std::mutex> guard(queue.Lock);
+
+    if (queue.Begin == queue.End)
+        return false;
+
+    index = queue.Begin++;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+inline bool WorkStealingPool::Steal
+(
+    std::size_t worker,
+    std::size_t& index
+)
+{
+    std::size_t begin;
+    std::size_t end;
+
+    for (;;)
+    {
+        // Victim with the most work left
+        std::size_t victim = Count;
+        std::size_t most   = 0;
+        for (std::size_t offset = 1; offset < Count; ++offset) {
+            const std::size_t other = (worker + offset) % Count;
+            std::lock_guard<std::mutex> guard(Queues[other].Lock);
+
+            const std::size_t left = Queues[other].End - Queues[other].Begin;
+            if (left > most) {
+                most   = left;
+                victim = other;
+            }
+        }
+
+        if (victim == Count)
+            return false;
+
+        Queue& queue = Queues[victim];
+        std::lock_guard<std::mutex> guard(queue.Lock);
+
+        // Drained by its owner or another thief meanwhile
+        if (queue.Begin == queue.End)
+            continue;
+
+        end   = queue.End;
+        begin = queue.Begin + (queue.End - queue.Begin) / 2;
+        queue.End = begin;
+        break;
+    }
+
+    {
+        Queue& queue = Queues[worker];
+        std::lock_guard<std::mutex> guard(queue.Lock);
+        queue.Begin = begin + 1;
+        queue.End   = end;
+    }
+
+    Stolen.fetch_add(1, std::memory_order_relaxed);
+    index = begin;
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+inline void WorkStealingPool::Work
+(
+    std::size_t worker
+)
+{
+    std::size_t index;
+    while (Pop(worker, index) || Steal(worker, index))
+        Invoke(Context, index, worker);
+}
+
+//---------------------------------------------------------------------------------------
+inline void WorkStealingPool::Loop
+(
+    std::size_t worker
+)
+{
+    std::size_t seen = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(Lock);
+            Wake.wait(guard, [&] { return Stop || Generation != seen; });
+
+            if (Stop)
+                return;
+
+            seen = Generation;
+        }
+
+        Work(worker);
+
+        {
+            std::lock_guard<std::mutex> guard(Lock);
+            if (--Busy == 0)
+                Done.notify_one();
+        }
+    }
+}
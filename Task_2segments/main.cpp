@@ -4,14 +4,556 @@
 //---------------------------------------------------------------------------------------
 #include "Vector3.h"
 #include "Segment3.h"
+#include "Segment3Batch.h"
+#include "Segment3BVH.h"
+#include "Segment3File.h"
+#include "Segment3Hit.h"
+#include "Segment3Pipeline.h"
+#include "Segment3Server.h"
+#include "Segment3Shards.h"
+#include "Segment3Span.h"
+#include "Segment3Stats.h"
+#include "Segment3Stream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
 
-#ifdef _PROFILE
-#include <chrono>
-#endif // _PROFILE
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif // _WIN32
+
+//---------------------------------------------------------------------------------------
+// Command line driver:
+//
+//     Task_2segments pairs|all|convert|serve [--input file] [--output file]
+//                                      [--format text|binary|seg3]
+//                                      [--precision float|double] [--chunk N]
+//                                      [--stats file] [--pipeline depth]
+//                                      [--shards N] [--socket path]
+//
+// pairs: consecutive segments form pairs, every hit is written as
+//        "pair x y z". all: every two segments of the set are intersected,
+//        hits are written as "first second x y z", first < second.
+// convert: writes the input as a SEG3 file with boxes (see Segment3File.h).
+// serve: keeps the input indexed in memory and answers Segment3Client requests
+//        on the Unix domain socket path until a Stop request (Segment3Server.h).
+// Input is stdin unless --input is given, output is stdout. Both modes read
+// chunk segments at a time and never hold more than two chunks in memory;
+// all-pairs re-reads the input once per chunk, so it needs a file.
+// SEG3 input is memory-mapped and takes its precision from the file header.
+// --stats writes the Segment3Stats counters and timings of the run as JSON;
+// pairs then runs the traced scalar Intersection instead of the batch.
+// --pipeline runs pairs without --stats as Segment3Pipeline: reading, intersection
+// and output overlap on three threads with up to depth chunks in flight.
+// --shards runs all as Segment3Shards over the whole input held in memory,
+// one worker process per shard where fork is available.
+// Without arguments the program runs the built-in example.
+//---------------------------------------------------------------------------------------
+enum class Mode
+{
+    Pairs,
+    AllPairs,
+    Convert,
+    Serve,
+};
+
+//---------------------------------------------------------------------------------------
+struct Options
+{
+    Mode           Action    = Mode::Pairs;
+    bool           Float     = false;
+    bool           Mapped    = false;
+    Segment3Format Format    = Segment3Format::Text;
+    std::size_t    Chunk     = 1 << 16;
+    const char*    Input     = nullptr;
+    const char*    Output    = nullptr;
+    const char*    Stats     = nullptr;
+    std::size_t    Pipeline  = 0;
+    std::size_t    Shards    = 0;
+    const char*    Socket    = nullptr;
+};
+
+//---------------------------------------------------------------------------------------
+// Segment3Reader interface over a mapped SEG3 file
+template <typename TFloat>
+class MappedReader
+{
+public:
+    MappedReader(
+        const Segment3Span<TFloat>& segments,
+        const Segment3Span<TFloat>& boxes
+    ) :
+        Segments(segments),
+        StoredBoxes(boxes)
+    {}
+
+    std::size_t Read(Segment3<TFloat>* segments, std::size_t count)
+    {
+        const Segment3Span<TFloat> chunk = Segments.Subspan(Next, count);
+        std::copy(chunk.begin(), chunk.end(), segments);
+
+        Next += chunk.Size();
+        return chunk.Size();
+    }
+
+    bool Seek(std::size_t index)
+    {
+        Next = std::min(index, Segments.Size());
+        return true;
+    }
+
+    std::size_t Position() const
+    {
+        return Next;
+    }
+
+    bool Failed() const
+    {
+        return false;
+    }
+
+    // Boxes of the segments from index on, nullptr if the file has none
+    const Segment3<TFloat>* Boxes(std::size_t index) const
+    {
+        return StoredBoxes.Empty() ? nullptr : StoredBoxes.Data() + index;
+    }
+
+private:
+    Segment3Span<TFloat> Segments;
+    Segment3Span<TFloat> StoredBoxes;
+    std::size_t          Next = 0;
+};
+
+//---------------------------------------------------------------------------------------
+// Boxes stored with the input, a stream has none and the BVH computes its own
+template<typename TFloat>
+static const Segment3<TFloat>* StoredBoxes
+(
+    const Segment3Reader<TFloat>&,
+    std::size_t
+)
+{
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+static const Segment3<TFloat>* StoredBoxes
+(
+    const MappedReader<TFloat>& reader,
+    std::size_t index
+)
+{
+    return reader.Boxes(index);
+}
+
+//---------------------------------------------------------------------------------------
+static bool Parse
+(
+    int argc,
+    char* argv[],
+    Options& options
+)
+{
+    if (std::strcmp(argv[1], "pairs") == 0)
+        options.Action = Mode::Pairs;
+    else if (std::strcmp(argv[1], "all") == 0)
+        options.Action = Mode::AllPairs;
+    else if (std::strcmp(argv[1], "convert") == 0)
+        options.Action = Mode::Convert;
+    else if (std::strcmp(argv[1], "serve") == 0)
+        options.Action = Mode::Serve;
+    else
+        return false;
+
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        const char* arg   = argv[i];
+        const char* value = argv[i + 1];
+
+        if (std::strcmp(arg, "--input") == 0)
+            options.Input = value;
+        else if (std::strcmp(arg, "--output") == 0)
+            options.Output = value;
+        else if (std::strcmp(arg, "--format") == 0 && std::strcmp(value, "text") == 0)
+            options.Format = Segment3Format::Text;
+        else if (std::strcmp(arg, "--format") == 0 && std::strcmp(value, "binary") == 0)
+            options.Format = Segment3Format::Binary;
+        else if (std::strcmp(arg, "--format") == 0 && std::strcmp(value, "seg3") == 0)
+            options.Mapped = true;
+        else if (std::strcmp(arg, "--precision") == 0 && std::strcmp(value, "float") == 0)
+            options.Float = true;
+        else if (std::strcmp(arg, "--precision") == 0 && std::strcmp(value, "double") == 0)
+            options.Float = false;
+        else if (std::strcmp(arg, "--stats") == 0)
+            options.Stats = value;
+        else if (std::strcmp(arg, "--pipeline") == 0)
+            options.Pipeline = std::max<std::size_t>(2, std::strtoull(value, nullptr, 10));
+        else if (std::strcmp(arg, "--shards") == 0)
+            options.Shards = std::max<std::size_t>(1, std::strtoull(value, nullptr, 10));
+        else if (std::strcmp(arg, "--socket") == 0)
+            options.Socket = value;
+        else if (std::strcmp(arg, "--chunk") == 0)
+            options.Chunk = std::max<std::size_t>(1, std::strtoull(value, nullptr, 10));
+        else
+            return false;
+    }
+
+    return argc % 2 == 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+static void WritePoint
+(
+    std::FILE* output,
+    const Vector3<TFloat>& point
+)
+{
+    const int digits = std::numeric_limits<TFloat>::max_digits10;
+    std::fprintf(output, " %.*g %.*g %.*g\n", digits, point.X, digits, point.Y, digits, point.Z);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat, typename TReader>
+static std::size_t IntersectPairs
+(
+    TReader& reader,
+    std::FILE* output,
+    std::size_t chunk,
+    Segment3Stats* stats
+)
+{
+    std::vector<Segment3<TFloat>> segments(2 * chunk);
+    Segment3Batch<TFloat> first;
+    Segment3Batch<TFloat> second;
+    Vector3Batch<TFloat>  points;
+
+    std::size_t hits = 0;
+
+    for (std::size_t base = 0;; )
+    {
+        const std::size_t read  = reader.Read(segments.data(), 2 * chunk);
+        const std::size_t count = read / 2;
+
+        first .Resize(count);
+        second.Resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            first .Set(i, segments[2 * i]);
+            second.Set(i, segments[2 * i + 1]);
+        }
+
+        if (stats == nullptr)
+            first.Intersection(second, points);
+        else {
+            points.Resize(count);
+            for (std::size_t i = 0; i < count; ++i)
+                points.Set(i, segments[2 * i].Intersection(segments[2 * i + 1], stats->Tracer(0)));
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const Vector3<TFloat> point = points.Get(i);
+            if (!point.IsValid())
+                continue;
+
+            std::fprintf(output, "%zu", base + i);
+            WritePoint(output, point);
+            ++hits;
+        }
+
+        base += count;
+        if (read < 2 * chunk) {
+            if (read % 2 != 0)
+                std::fprintf(stderr, "Odd number of segments, the last one is ignored\n");
+            break;
+        }
+    }
+
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat, typename TReader>
+static std::size_t IntersectPairsPipelined
+(
+    TReader& reader,
+    std::FILE* output,
+    std::size_t chunk,
+    std::size_t depth
+)
+{
+    Segment3Pipeline<TFloat> pipeline(chunk, depth);
+
+    const std::size_t hits = pipeline.Pairs(reader, [output](std::size_t pair, const Vector3<TFloat>& point) {
+        std::fprintf(output, "%zu", pair);
+        WritePoint(output, point);
+    });
+
+    if (pipeline.Segments() % 2 != 0)
+        std::fprintf(stderr, "Odd number of segments, the last one is ignored\n");
+
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+// Block nested loop: every chunk is indexed with a BVH, intersected with
+// itself and then with the rest of the input streamed past it
+template<typename TFloat, typename TReader>
+static std::size_t IntersectAllPairs
+(
+    TReader& reader,
+    std::FILE* output,
+    std::size_t chunk,
+    Segment3Stats* stats
+)
+{
+    std::vector<Segment3<TFloat>>    block(chunk);
+    std::vector<Segment3<TFloat>>    other(chunk);
+    std::vector<Segment3Hit<TFloat>> found;
+    Segment3BVH<TFloat>              bvh;
+
+    std::size_t hits = 0;
+
+    auto write = [&]() {
+        for (const Segment3Hit<TFloat>& hit : found) {
+            std::fprintf(output, "%zu %zu", hit.First, hit.Second);
+            WritePoint(output, hit.Point);
+        }
+        hits += found.size();
+    };
+
+    for (std::size_t begin = 0; reader.Seek(begin); begin += chunk)
+    {
+        const std::size_t size = reader.Read(block.data(), chunk);
+        if (size == 0)
+            break;
+
+        bvh.Build(block.data(), StoredBoxes(reader, begin), size);
+
+        if (stats == nullptr)
+            found = bvh.SelfIntersections();
+        else
+            bvh.SelfIntersections(found, stats->Tracer(0));
+        for (Segment3Hit<TFloat>& hit : found) {
+            hit.First  += begin;
+            hit.Second += begin;
+        }
+        write();
+
+        if (size < chunk)
+            break;
+
+        for (;;)
+        {
+            const std::size_t otherBegin = reader.Position();
+            const std::size_t otherSize  = reader.Read(other.data(), chunk);
+            const Segment3<TFloat>* otherBoxes = StoredBoxes(reader, otherBegin);
+
+            found.clear();
+            for (std::size_t j = 0; j < otherSize; ++j)
+                bvh.Query(otherBoxes ? otherBoxes[j] : other[j].ToAABB(), [&](std::size_t i) {
+                    const Vector3<TFloat> point = stats == nullptr ?
+                        block[i].Intersection(other[j]) :
+                        block[i].Intersection(other[j], stats->Tracer(0));
+                    if (point.IsValid())
+                        found.push_back({ begin + i, otherBegin + j, point });
+                });
+
+            std::sort(found.begin(), found.end());
+            write();
+
+            if (otherSize < chunk)
+                break;
+        }
+    }
+
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat, typename TReader>
+static std::size_t IntersectAllPairsSharded
+(
+    TReader& reader,
+    std::FILE* output,
+    std::size_t chunk,
+    std::size_t shards
+)
+{
+    std::vector<Segment3<TFloat>> segments;
+    for (std::size_t read = chunk; read == chunk; ) {
+        const std::size_t size = segments.size();
+        segments.resize(size + chunk);
+        read = reader.Read(segments.data() + size, chunk);
+        segments.resize(size + read);
+    }
+
+    std::vector<Segment3Hit<TFloat>> found;
+    const Segment3Shards<TFloat> sharded(segments.data(), segments.size(), shards);
+    if (!sharded.SelfIntersections(found))
+        std::fprintf(stderr, "A shard worker failed, the output is incomplete\n");
+
+    for (const Segment3Hit<TFloat>& hit : found) {
+        std::fprintf(output, "%zu %zu", hit.First, hit.Second);
+        WritePoint(output, hit.Point);
+    }
+
+    return found.size();
+}
 
 //---------------------------------------------------------------------------------------
-int main()
+template<typename TFloat, typename TReader>
+static int ServeSegments
+(
+    const Options& options,
+    TReader& reader
+)
+{
+#ifdef _WIN32
+    (void)options;
+    (void)reader;
+    std::fprintf(stderr, "Serve needs Unix domain sockets\n");
+    return 1;
+#else
+    std::vector<Segment3<TFloat>> chunk(options.Chunk);
+    std::vector<Segment3D>        segments;
+    for (std::size_t read = options.Chunk; read == options.Chunk; ) {
+        read = reader.Read(chunk.data(), options.Chunk);
+        for (std::size_t i = 0; i < read; ++i)
+            segments.push_back(Segment3D(
+                { chunk[i].Start.X, chunk[i].Start.Y, chunk[i].Start.Z },
+                { chunk[i].End  .X, chunk[i].End  .Y, chunk[i].End  .Z }
+            ));
+    }
+
+    if (reader.Failed()) {
+        std::fprintf(stderr, "Malformed input near segment %zu\n", reader.Position());
+        return 1;
+    }
+
+    Segment3Server server(segments.data(), segments.size());
+    if (!server.Listen(options.Socket)) {
+        std::fprintf(stderr, "Cannot listen on %s\n", options.Socket);
+        return 1;
+    }
+
+    std::fprintf(stderr, "Serving %zu segments on %s\n", segments.size(), options.Socket);
+    if (!server.Serve())
+        return 1;
+
+    std::fputs(server.StatsJson().c_str(), stderr);
+    return 0;
+#endif // _WIN32
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat, typename TReader>
+static int Run
+(
+    const Options& options,
+    TReader& reader,
+    std::FILE* output
+)
+{
+    if (options.Action == Mode::Serve)
+        return ServeSegments<TFloat>(options, reader);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::size_t count = 0;
+
+    std::unique_ptr<Segment3Stats> stats;
+    if (options.Stats != nullptr)
+        stats.reset(new Segment3Stats());
+
+    if (options.Action == Mode::Convert)
+    {
+        Segment3FileWriter<TFloat> writer;
+        std::vector<Segment3<TFloat>> segments(options.Chunk);
+
+        bool written = writer.Open(options.Output, true);
+        for (std::size_t read = options.Chunk; written && read == options.Chunk; count += read) {
+            read = reader.Read(segments.data(), options.Chunk);
+            written = writer.Write(segments.data(), read);
+        }
+
+        if (!writer.Close() || !written) {
+            std::fprintf(stderr, "Cannot write %s\n", options.Output);
+            return 1;
+        }
+    }
+    else if (options.Action == Mode::AllPairs && options.Shards > 0 && stats == nullptr)
+        count = IntersectAllPairsSharded<TFloat>(reader, output, options.Chunk, options.Shards);
+    else if (options.Action == Mode::Pairs && options.Pipeline > 0 && stats == nullptr)
+        count = IntersectPairsPipelined<TFloat>(reader, output, options.Chunk, options.Pipeline);
+    else
+        count = options.Action == Mode::AllPairs ?
+            IntersectAllPairs<TFloat>(reader, output, options.Chunk, stats.get()) :
+            IntersectPairs   <TFloat>(reader, output, options.Chunk, stats.get());
+
+    const std::chrono::duration<double, std::milli> duration =
+        std::chrono::steady_clock::now() - start;
+
+    if (reader.Failed()) {
+        std::fprintf(stderr, "Malformed input near segment %zu\n", reader.Position());
+        return 1;
+    }
+
+    if (stats != nullptr) {
+        std::ofstream file(options.Stats);
+        stats->Snapshot().WriteJson(file);
+        if (!file) {
+            std::fprintf(stderr, "Cannot write %s\n", options.Stats);
+            return 1;
+        }
+    }
+
+    std::fprintf(stderr, "%s: %zu\nTime ms: %.1f\n",
+        options.Action == Mode::Convert ? "Segments" : "Intersections", count, duration.count());
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+static int RunStream
+(
+    const Options& options,
+    std::FILE* input,
+    std::FILE* output
+)
+{
+    Segment3Reader<TFloat> reader(input, options.Format);
+    return Run<TFloat>(options, reader, output);
+}
+
+//---------------------------------------------------------------------------------------
+template<typename TFloat>
+static int RunMapped
+(
+    const Options& options,
+    std::FILE* output
+)
+{
+    Segment3MappedFile<TFloat> file;
+    if (!file.Open(options.Input)) {
+        std::fprintf(stderr, "%s is not a valid SEG3 file\n", options.Input);
+        return 1;
+    }
+
+    MappedReader<TFloat> reader(file.Segments(), file.Boxes());
+    return Run<TFloat>(options, reader, output);
+}
+
+//---------------------------------------------------------------------------------------
+static int Example()
 {
 #ifdef _PROFILE
     const size_t repeats = 1e3;
@@ -54,15 +596,137 @@ int main()
     std::cout << "Time ns: " << duration.count() / repeats << '\n'
               << "Intersections: " << intersections << '\n';
 
+    Segment3BatchD batch1(seg1, repeats);
+    Segment3BatchD batch2(seg2, repeats);
+    Vector3BatchD batchResult(repeats);
+
+    start = std::chrono::high_resolution_clock::now();
+
+    batch1.Intersection(batch2, batchResult);
+
+    duration = std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << "Batch time ns: " << duration.count() / repeats << '\n';
+
 #else
     Segment3D seg1({ 0, 0, 0 }, { 0, 2, 2 });
     Segment3D seg2({ 0, 0, 2 }, { 0, 2, 0 });
     Vector3D result;
 
+#ifdef _LOG
+    Segment3TraceRecord records[16];
+    Segment3BufferTracer tracer(records, 16);
+
+    result = seg1.Intersection(seg2, tracer);
+
+    for (size_t i = 0; i < tracer.Size(); ++i) {
+        if (records[i].Step != Segment3Step::Solved &&
+            records[i].Step != Segment3Step::OutOfRange &&
+            records[i].Step != Segment3Step::PointOnSegment)
+        {
+            std::cout << Segment3StepName(records[i].Step) << '\n';
+            continue;
+        }
+
+        if (records[i].Step != Segment3Step::PointOnSegment)
+            std::cout << "U: " << records[i].U << '\n'
+                      << "V: " << records[i].V << '\n'
+                      << "t: " << records[i].T << " k: " << records[i].K << '\n';
+    }
+#else
     result = seg1.Intersection(seg2);
+#endif // _LOG
+
     std::cout << "Intersection: " << result.X << " " <<
                                      result.Y << " " << 
                                      result.Z << '\n';
 
 #endif // _PROFILE
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    if (argc == 1)
+        return Example();
+
+    Options options;
+    if (!Parse(argc, argv, options)) {
+        std::fprintf(stderr,
+            "Usage: Task_2segments pairs|all|convert|serve [--input file] [--output file]\n"
+            "                      [--format text|binary|seg3] [--precision float|double] [--chunk N]\n"
+            "                      [--stats file] [--pipeline depth] [--shards N] [--socket path]\n");
+        return 1;
+    }
+
+    if (((options.Action == Mode::AllPairs && options.Shards == 0) || options.Mapped) && !options.Input) {
+        std::fprintf(stderr, "This mode needs a file, use --input\n");
+        return 1;
+    }
+
+    if (options.Action == Mode::Serve && !options.Socket) {
+        std::fprintf(stderr, "Serve listens on a socket, use --socket\n");
+        return 1;
+    }
+
+    if (options.Action == Mode::Convert && !options.Output) {
+        std::fprintf(stderr, "Convert writes a file, use --output\n");
+        return 1;
+    }
+
+    std::FILE* output = stdout;
+    if (options.Output && options.Action != Mode::Convert)
+        output = std::fopen(options.Output, "w");
+
+    if (!output) {
+        std::fprintf(stderr, "Cannot open %s\n", options.Output);
+        return 1;
+    }
+
+    static char buffer[1 << 20];
+    std::setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+
+    int status = 1;
+
+    if (options.Mapped)
+    {
+        Segment3FileHeader header;
+        if (!Segment3MappedFile<float>::ReadHeader(options.Input, header))
+            std::fprintf(stderr, "%s is not a valid SEG3 file\n", options.Input);
+        else if (header.Type != Segment3FileHeader::FloatingPoint)
+            std::fprintf(stderr, "%s has integer coordinates\n", options.Input);
+        else
+            status = header.Precision == sizeof(float) ?
+                RunMapped<float> (options, output) :
+                RunMapped<double>(options, output);
+    }
+    else
+    {
+        const bool binary = options.Format == Segment3Format::Binary;
+
+        std::FILE* input = stdin;
+        if (options.Input)
+            input = std::fopen(options.Input, binary ? "rb" : "r");
+#ifdef _WIN32
+        else if (binary)
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif // _WIN32
+
+        if (!input)
+            std::fprintf(stderr, "Cannot open %s\n", options.Input);
+        else
+            status = options.Float ?
+                RunStream<float> (options, input, output) :
+                RunStream<double>(options, input, output);
+
+        if (input && input != stdin)
+            std::fclose(input);
+    }
+
+    if (output != stdout)
+        std::fclose(output);
+
+    return status;
 }
@@ -0,0 +1,732 @@
+//---------------------------------------------------------------------------------------
+// Regression checks for the headers of Task_2segments.
+//
+//     Tests
+//
+// Every check prints its name when it fails; the exit code is the number of
+// failed checks, so 0 means everything passed.
+//---------------------------------------------------------------------------------------
+#include "Segment3.h"
+#include "Segment3Batch.h"
+#include "Segment3BVH.h"
+#include "Segment3DynamicBVH.h"
+#include "Segment3File.h"
+#include "Segment3Mixed.h"
+#include "Segment3PairCache.h"
+#include "Segment3Pipeline.h"
+#include "Segment3PlaneSweep.h"
+#include "Segment3Server.h"
+#include "Segment3SpatialOrder.h"
+#include "WideInteger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+static int Failures = 0;
+
+//---------------------------------------------------------------------------------------
+static void Check
+(
+    bool condition,
+    const char* name
+)
+{
+    if (condition)
+        return;
+
+    std::cerr << "FAILED: " << name << '\n';
+    ++Failures;
+}
+
+//---------------------------------------------------------------------------------------
+// A tree built without stored boxes computes its own and finds the same hits
+static void TestBVHWithoutBoxes()
+{
+    std::vector<Segment3D> segments;
+    for (int i = 0; i < 16; ++i) {
+        segments.push_back(Segment3D({ double(i), 0, 0 }, { double(i), 16, 0 }));
+        segments.push_back(Segment3D({ 0, i + 0.5, 0 }, { 16, i + 0.5, 0 }));
+    }
+
+    std::vector<Segment3D> boxes;
+    for (const Segment3D& segment : segments)
+        boxes.push_back(segment.ToAABB());
+
+    const Segment3BVHD computed(segments.data(), nullptr, segments.size());
+    const Segment3BVHD stored  (segments.data(), boxes.data(), segments.size());
+    const Segment3BVHD plain   (segments.data(), segments.size());
+
+    for (std::size_t i = 0; i < segments.size(); ++i)
+        Check(computed.Box(i).Start == boxes[i].Start && computed.Box(i).End == boxes[i].End,
+            "BVH with nullptr boxes computes Segment3::ToAABB()");
+
+    const std::vector<Segment3Hit<double>> hits = computed.SelfIntersections();
+    Check(hits.size() == 16 * 16, "BVH with nullptr boxes finds every crossing");
+    Check(hits.size() == stored.SelfIntersections().size(), "BVH with nullptr boxes matches stored boxes");
+    Check(hits.size() == plain .SelfIntersections().size(), "BVH with nullptr boxes matches Build(segments, count)");
+}
+
+//---------------------------------------------------------------------------------------
+// A cached frame with another narrow phase recomputes exactly the touched pairs
+static void TestBVHCachedNarrowPhase()
+{
+    std::vector<Segment3D> segments;
+    for (int i = 0; i < 8; ++i) {
+        segments.push_back(Segment3D({ double(i), 0, 0 }, { double(i), 8, 0 }));
+        segments.push_back(Segment3D({ 0, i + 0.5, 0 }, { 8, i + 0.5, 0 }));
+    }
+
+    const Segment3BVHD bvh(segments.data(), segments.size());
+    Segment3PairCacheD cache;
+    std::size_t calls = 0;
+    auto exact = [&calls](const Segment3D& first, const Segment3D& second) {
+        ++calls;
+        return first.IntersectionExact(second);
+    };
+
+    const std::size_t hits = SelfIntersections(bvh, cache, exact).size();
+    const std::size_t first = calls;
+    cache.Touch(0);
+    Check(SelfIntersections(bvh, cache, exact).size() == hits && hits == 8 * 8,
+        "cached SelfIntersections with IntersectionExact finds every crossing");
+    Check(calls - first > 0 && calls - first < first, "cached SelfIntersections recomputes only touched pairs");
+}
+
+//---------------------------------------------------------------------------------------
+// A SEG3 file only maps as the number type it was written with
+static void TestFileType()
+{
+    const char* path = "Tests.seg3";
+    const Segment3F segment({ 0, 0, 0 }, { 1, 1, 1 });
+
+    Check(Segment3FileWriter<float>::Save(path, &segment, 1, true), "SEG3 float file is written");
+
+    Segment3MappedFile<float> floats;
+    Check(floats.Open(path), "SEG3 float file maps as float");
+    floats.Close();
+
+    Segment3MappedFile<std::int32_t> integers;
+    Check(!integers.Open(path), "SEG3 float file does not map as int32");
+    integers.Close();
+
+    std::remove(path);
+}
+
+//---------------------------------------------------------------------------------------
+// IntersectionResult makes the decisions of Intersection, also for a pair
+// whose projections on the plane chosen by Intersection are parallel
+static void TestResultMatchesIntersection()
+{
+    const Segment3D first ({ 2, 3, 1 }, { 4, 1, 2 });
+    const Segment3D second({ 2, 3, 4 }, { 3, 2, 1 });
+
+    const Segment3Result<double> result = first.IntersectionResult(second);
+    Check(!first.Intersection(second).IsValid(), "degenerate projection is a miss of Intersection");
+    Check(!result.IsHit(), "degenerate projection is a miss of IntersectionResult");
+
+    std::mt19937 engine(16);
+    std::uniform_int_distribution<int> coordinate(0, 8);
+    auto segment = [&]() {
+        return Segment3D(
+            { double(coordinate(engine)), double(coordinate(engine)), double(coordinate(engine)) },
+            { double(coordinate(engine)), double(coordinate(engine)), double(coordinate(engine)) }
+        );
+    };
+
+    std::size_t mismatches = 0;
+    for (int i = 0; i < 100000; ++i) {
+        const Segment3D a = segment();
+        const Segment3D b = segment();
+        const Segment3Result<double> outcome = a.IntersectionResult(b);
+        mismatches += outcome.IsHit() != a.Intersection(b).IsValid() ||
+            (outcome.IsHit() && !outcome.Point.IsValid());
+    }
+    Check(mismatches == 0, "IntersectionResult hits are the hits of Intersection");
+}
+
+//---------------------------------------------------------------------------------------
+// Segment3Batch gives the points of Segment3::Intersection bit for bit, also
+// for near-coplanar pairs whose eps decisions a fused multiply-add would flip
+template <typename TFloat>
+static void TestBatchMatchesIntersection(const char* name)
+{
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<TFloat> unit(0, 1);
+    std::uniform_real_distribution<TFloat> tiny(-4 * Vector3<TFloat>::eps, 4 * Vector3<TFloat>::eps);
+
+    std::vector<Segment3<TFloat>> first;
+    std::vector<Segment3<TFloat>> second;
+    for (int i = 0; i < 1003; ++i) {
+        const Vector3<TFloat> a(unit(engine), unit(engine), unit(engine));
+        const Vector3<TFloat> b(unit(engine), unit(engine), unit(engine));
+        const Vector3<TFloat> c = a + (b - a) * unit(engine);
+        const Vector3<TFloat> d(unit(engine), unit(engine), unit(engine));
+        const Vector3<TFloat> shift(tiny(engine), tiny(engine), tiny(engine));
+        first.push_back(Segment3<TFloat>(a, b));
+        second.push_back(Segment3<TFloat>(d, c * TFloat(2) - d + shift));
+    }
+
+    const Segment3Batch<TFloat> batchFirst (first .data(), first .size());
+    const Segment3Batch<TFloat> batchSecond(second.data(), second.size());
+    Vector3Batch<TFloat> points;
+    batchFirst.Intersection(batchSecond, points);
+
+    std::size_t mismatches = 0;
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < first.size(); ++i) {
+        const Vector3<TFloat> expected = first[i].Intersection(second[i]);
+        const Vector3<TFloat> actual   = points.Get(i);
+        hits += expected.IsValid();
+        mismatches += expected.IsValid() != actual.IsValid() ||
+            (expected.IsValid() && std::memcmp(&expected, &actual, sizeof(expected)) != 0);
+    }
+    Check(hits != 0, name);
+    Check(mismatches == 0, name);
+}
+
+//---------------------------------------------------------------------------------------
+// The float prefilter of Segment3MixedBatch leaves every point of the double
+// path as it is, bit for bit, with misses, hits and a tail shorter than a pack.
+// Segment3BatchD of the same translation unit is the reference next to the
+// scalar path; neither needs -ffp-contract=off, see Unfused.h
+static void TestMixedMatchesDouble()
+{
+    std::mt19937 engine(12);
+    std::uniform_real_distribution<double> unit(0., 1.);
+    std::uniform_int_distribution<int> kind(0, 2);
+
+    std::vector<Segment3D> first;
+    std::vector<Segment3D> second;
+    for (int i = 0; i < 1003; ++i) {
+        const Vector3D a(unit(engine), unit(engine), unit(engine));
+        const Vector3D b(unit(engine), unit(engine), unit(engine));
+        const Vector3D c(unit(engine), unit(engine), unit(engine));
+        first.push_back(Segment3D(a, b));
+        switch (kind(engine)) {
+        case 0:  second.push_back(Segment3D(c, c + Vector3D(0.1, 0.1, 0.1))); break;
+        case 1:  second.push_back(Segment3D(c, a * 2. - c)); break;
+        default: second.push_back(Segment3D(a, b)); break;
+        }
+    }
+
+    const Segment3MixedBatch mixedFirst (first .data(), first .size());
+    const Segment3MixedBatch mixedSecond(second.data(), second.size());
+    Vector3Batch<double> points;
+    mixedFirst.Intersection(mixedSecond, points);
+
+    const Segment3BatchD batchFirst (first .data(), first .size());
+    const Segment3BatchD batchSecond(second.data(), second.size());
+    Vector3Batch<double> batchPoints;
+    batchFirst.Intersection(batchSecond, batchPoints);
+
+    auto differ = [](const Vector3D& expected, const Vector3D& actual) {
+        return expected.IsValid() != actual.IsValid() ||
+            (expected.IsValid() && std::memcmp(&expected, &actual, sizeof(Vector3D)) != 0);
+    };
+
+    std::size_t mismatches = 0;
+    std::size_t batchMismatches = 0;
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < first.size(); ++i) {
+        const Vector3D expected = first[i].Intersection(second[i]);
+        hits += expected.IsValid();
+        mismatches += differ(expected, points.Get(i));
+        batchMismatches += differ(batchPoints.Get(i), points.Get(i));
+    }
+    Check(hits != 0, "Segment3MixedBatch test set has hits");
+    Check(mismatches == 0, "Segment3MixedBatch matches Segment3D::Intersection");
+    Check(batchMismatches == 0, "Segment3MixedBatch matches Segment3BatchD");
+}
+
+//---------------------------------------------------------------------------------------
+// Every pair of a coplanar set, each with segments[First].Intersection
+static std::vector<Segment3Hit<double>> BruteForceHits(const std::vector<Segment3D>& segments)
+{
+    std::vector<Segment3Hit<double>> hits;
+    for (std::size_t i = 0; i < segments.size(); ++i)
+        for (std::size_t j = i + 1; j < segments.size(); ++j) {
+            const Vector3D point = segments[i].Intersection(segments[j]);
+            if (point.IsValid())
+                hits.push_back({ i, j, point });
+        }
+
+    return hits;
+}
+
+//---------------------------------------------------------------------------------------
+static bool SameHits
+(
+    std::vector<Segment3Hit<double>> first,
+    std::vector<Segment3Hit<double>> second
+)
+{
+    std::sort(first .begin(), first .end());
+    std::sort(second.begin(), second.end());
+    if (first.size() != second.size())
+        return false;
+
+    for (std::size_t i = 0; i < first.size(); ++i)
+        if (first[i].First != second[i].First || first[i].Second != second[i].Second ||
+            std::memcmp(&first[i].Point, &second[i].Point, sizeof(Vector3D)) != 0)
+            return false;
+
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+// The plane sweep finds the pairs of the all-pairs loop on an integer grid,
+// real-valued input, a tilted plane, shared endpoints and collinear overlaps
+static void TestPlaneSweepMatchesBruteForce()
+{
+    std::mt19937 engine(15);
+    std::uniform_int_distribution<int> lattice(0, 12);
+    std::uniform_real_distribution<double> unit(0., 1.);
+
+    auto check = [](const std::vector<Segment3D>& segments, const char* name) {
+        const Segment3PlaneSweepD sweep(segments.data(), segments.size());
+        const std::vector<Segment3Hit<double>> expected = BruteForceHits(segments);
+        Check(sweep.IsPlanar() && !expected.empty() && SameHits(sweep.SelfIntersections(), expected), name);
+    };
+
+    // Grid lines, random lattice segments and points in z = 0
+    std::vector<Segment3D> grid;
+    for (int i = 0; i <= 12; i += 3) {
+        grid.push_back(Segment3D({ double(i), 0, 0 }, { double(i), 12, 0 }));
+        grid.push_back(Segment3D({ 0, double(i), 0 }, { 12, double(i), 0 }));
+    }
+    for (int i = 0; i < 200; ++i)
+        grid.push_back(Segment3D(
+            { double(lattice(engine)), double(lattice(engine)), 0 },
+            { double(lattice(engine)), double(lattice(engine)), 0 }
+        ));
+    check(grid, "plane sweep matches all pairs on an integer grid");
+
+    // Real-valued coordinates
+    std::vector<Segment3D> real;
+    for (int i = 0; i < 300; ++i)
+        real.push_back(Segment3D({ unit(engine), unit(engine), 0 }, { unit(engine), unit(engine), 0 }));
+    check(real, "plane sweep matches all pairs on real-valued input");
+
+    // z = 2 x + y with dyadic x and y stays exact in double; the normal is
+    // closest to X, so the sweep projects onto YZ
+    auto tilted = [](double x, double y) { return Vector3D(x, y, 2 * x + y); };
+    std::vector<Segment3D> plane;
+    for (int i = 0; i < 150; ++i)
+        plane.push_back(Segment3D(
+            tilted(lattice(engine), lattice(engine)),
+            tilted(lattice(engine), lattice(engine))
+        ));
+    for (int i = 0; i < 150; ++i)
+        plane.push_back(Segment3D(
+            tilted(std::ldexp(std::floor(unit(engine) * 4096), -10), std::ldexp(std::floor(unit(engine) * 4096), -10)),
+            tilted(std::ldexp(std::floor(unit(engine) * 4096), -10), std::ldexp(std::floor(unit(engine) * 4096), -10))
+        ));
+    check(plane, "plane sweep matches all pairs on a tilted plane");
+
+    // A star and a closed polygon share endpoints; one fan edge lies on
+    // the polygon, the others end on its corners
+    std::vector<Segment3D> shared;
+    const Vector3D corners[] = { { 0, 0, 0 }, { 8, 0, 0 }, { 8, 8, 0 }, { 0, 8, 0 }, { 4, 12, 0 } };
+    for (int i = 0; i < 5; ++i) {
+        shared.push_back(Segment3D(corners[i], corners[(i + 1) % 5]));
+        shared.push_back(Segment3D({ 4, 4, 0 }, corners[i]));
+    }
+    shared.push_back(Segment3D({ 0, 0, 0 }, { 8, 8, 0 }));
+    shared.push_back(Segment3D({ 4, 4, 0 }, { 4, 4, 0 }));
+    check(shared, "plane sweep matches all pairs with shared endpoints");
+
+    // Overlapping, nested, touching and disjoint pieces of two lines
+    std::vector<Segment3D> collinear;
+    for (int i = 0; i < 6; ++i) {
+        collinear.push_back(Segment3D({ double(2 * i), 0, 0 }, { double(2 * i + 3), 0, 0 }));
+        collinear.push_back(Segment3D({ double(i), double(i), 0 }, { double(i + 2), double(i + 2), 0 }));
+    }
+    collinear.push_back(Segment3D({ 1, 0, 0 }, { 10, 0, 0 }));
+    collinear.push_back(Segment3D({ 5, 0, 0 }, { 5, 0, 0 }));
+    collinear.push_back(Segment3D({ 14, 0, 0 }, { 13, 0, 0 }));
+    collinear.push_back(Segment3D({ 3, 3, 0 }, { 0, 0, 0 }));
+    check(collinear, "plane sweep matches all pairs with collinear overlaps");
+}
+
+//---------------------------------------------------------------------------------------
+// The incremental hits of Segment3DynamicBVH are those of all live pairs after
+// every frame of random inserts, moves, removals and rebuilds, also once the
+// handles of removed segments are handed out again
+static void TestDynamicBVHMatchesBruteForce()
+{
+    std::mt19937 engine(13);
+    std::uniform_int_distribution<int> lattice(0, 10);
+    std::uniform_int_distribution<int> step(-2, 2);
+    std::uniform_int_distribution<int> action(0, 9);
+
+    auto segment = [&]() {
+        return Segment3D(
+            { double(lattice(engine)), double(lattice(engine)), double(lattice(engine) % 3) },
+            { double(lattice(engine)), double(lattice(engine)), double(lattice(engine) % 3) }
+        );
+    };
+
+    Segment3DynamicBVHD bvh(0.5);
+    std::vector<Segment3DynamicBVHD::Handle> live;
+    std::vector<Segment3DynamicBVHD::Handle> removed;
+    std::size_t reused = 0;
+    std::size_t mismatches = 0;
+    std::size_t hits = 0;
+
+    for (int frame = 0; frame < 200; ++frame) {
+        for (int i = 0; i < 8; ++i) {
+            const int kind = live.size() < 16 ? 0 : action(engine);
+            if (kind < 3) {
+                const Segment3DynamicBVHD::Handle handle = bvh.Insert(segment());
+                reused += std::find(removed.begin(), removed.end(), handle) != removed.end();
+                live.push_back(handle);
+            }
+            else if (kind < 8) {
+                const Segment3DynamicBVHD::Handle handle = live[engine() % live.size()];
+                // Moves by a quarter stay within the margin, others leave the box
+                const Vector3D shift(step(engine) * 0.25, step(engine) * 0.25, 0);
+                const Segment3D& old = bvh.Segment(handle);
+                bvh.Update(handle, kind < 6 ? Segment3D(old.Start + shift, old.End + shift) : segment());
+            }
+            else {
+                const std::size_t index = engine() % live.size();
+                bvh.Remove(live[index]);
+                removed.push_back(live[index]);
+                live.erase(live.begin() + index);
+            }
+        }
+        if (frame % 50 == 49)
+            bvh.Rebuild();
+
+        std::vector<Segment3Hit<double>> expected;
+        std::vector<Segment3DynamicBVHD::Handle> sorted = live;
+        std::sort(sorted.begin(), sorted.end());
+        for (std::size_t i = 0; i < sorted.size(); ++i)
+            for (std::size_t j = i + 1; j < sorted.size(); ++j) {
+                const Vector3D point = bvh.Segment(sorted[i]).Intersection(bvh.Segment(sorted[j]));
+                if (point.IsValid())
+                    expected.push_back({ sorted[i], sorted[j], point });
+            }
+
+        hits += expected.size();
+        mismatches += !SameHits(bvh.Intersections(), expected);
+        mismatches += bvh.Size() != live.size();
+    }
+
+    Check(hits != 0 && reused != 0, "Segment3DynamicBVH test sequence has hits and reused handles");
+    Check(mismatches == 0, "Segment3DynamicBVH::Intersections matches all live pairs in every frame");
+}
+
+//---------------------------------------------------------------------------------------
+// Carries across limbs, signs and ToDouble of WideInteger around +-2^62, the
+// range of int64 coordinates and their differences
+static void TestWideIntegerExtremes()
+{
+    using Wide128 = WideInteger<128>;
+    using Wide256 = WideInteger<256>;
+
+    const std::int64_t big = std::int64_t(1) << 62;
+    const std::int64_t low = std::numeric_limits<std::int64_t>::min();
+    const std::int64_t top = std::numeric_limits<std::int64_t>::max();
+
+    Check((Wide128(-1) + Wide128(1)).Sign() == 0, "WideInteger -1 + 1 carries through every limb");
+    Check(Wide128(0xFFFFFFFFll) + Wide128(1) == Wide128(0x100000000ll), "WideInteger carries into the next limb");
+    Check((Wide128(big) + Wide128(big)).ToDouble() == std::ldexp(1., 63), "WideInteger 2^62 + 2^62 is 2^63");
+    Check(!(Wide128(big) + Wide128(big)).IsNegative(), "WideInteger 2^63 is positive in 128 bits");
+    Check(Wide128(top) + Wide128(1) == -Wide128(low), "WideInteger int64 max + 1 is -int64 min");
+    Check(Wide128(low).ToDouble() == -std::ldexp(1., 63), "WideInteger int64 min converts to -2^63");
+    Check(Wide128(low) - Wide128(1) < Wide128(low), "WideInteger goes below int64 min");
+
+    const Wide128 square = Wide128(big) * Wide128(big);
+    Check(square.ToDouble() == std::ldexp(1., 124), "WideInteger 2^62 * 2^62 is 2^124");
+    Check((Wide128(-big) * Wide128(big)).ToDouble() == -std::ldexp(1., 124), "WideInteger -2^62 * 2^62 is -2^124");
+    Check((Wide128(-big) * Wide128(-big)) == square, "WideInteger -2^62 * -2^62 is 2^124");
+    Check(Wide128(-big) * Wide128(big) < Wide128(low), "WideInteger -2^124 orders below int64 min");
+
+    // (2^62 - 1)^2 = 2^124 - 2^63 + 1
+    const Wide128 almost = Wide128(big - 1) * Wide128(big - 1);
+    Check(almost - square + Wide128(big) + Wide128(big) == Wide128(1), "WideInteger (2^62 - 1)^2 is exact");
+    Check((-almost).Sign() < 0 && (-almost - Wide128(1)) < -almost, "WideInteger negates 124-bit values");
+
+    // Three factors, the Orient3D range of int64 differences, need 256 bits
+    const Wide256 cube = Wide256(low) * Wide256(low) * Wide256(low);
+    Check(cube.IsNegative() && cube.ToDouble() == -std::ldexp(1., 189), "WideInteger (-2^63)^3 is -2^189");
+    Check(cube * Wide256(-1) == Wide256(low) * Wide256(low) * -Wide256(low), "WideInteger (-2^63)^3 changes sign");
+
+    std::mt19937_64 engine(20);
+    std::uniform_int_distribution<std::int64_t> value(-big, big);
+    std::size_t mismatches = 0;
+    for (int i = 0; i < 10000; ++i) {
+        const std::int64_t a = value(engine);
+        const std::int64_t b = value(engine);
+        mismatches += Wide256(a).ToDouble() != static_cast<double>(a);
+        mismatches += (Wide256(a) + Wide256(b)) * (Wide256(a) - Wide256(b)) !=
+            Wide256(a) * Wide256(a) - Wide256(b) * Wide256(b);
+        mismatches += (Wide256(a) * Wide256(b)).Sign() != ((a > 0) - (a < 0)) * ((b > 0) - (b < 0));
+
+        const double product = double(a) * double(b);
+        mismatches += std::abs((Wide256(a) * Wide256(b)).ToDouble() - product) >
+            4 * std::numeric_limits<double>::epsilon() * std::abs(product);
+    }
+    Check(mismatches == 0, "WideInteger matches int64 arithmetic around +-2^62");
+}
+
+//---------------------------------------------------------------------------------------
+// IntersectionRational and IntersectionExact decide alike on lattice input,
+// where double holds the coordinates exactly, and give the same points up to
+// the rounding of the double version
+static void TestRationalMatchesExact()
+{
+    std::mt19937 engine(20);
+    std::uniform_int_distribution<int> lattice(-4, 4);
+    std::uniform_int_distribution<int> scale(0, 40);
+
+    std::size_t mismatches = 0;
+    std::size_t hits = 0;
+    for (int i = 0; i < 100000; ++i) {
+        const std::int64_t factor = std::int64_t(1) << scale(engine);
+        std::int64_t coordinates[12];
+        for (std::int64_t& coordinate : coordinates)
+            coordinate = lattice(engine) * factor;
+
+        // Every other pair lies in z = 0, where most pairs are coplanar
+        if (i % 2 == 0)
+            coordinates[2] = coordinates[5] = coordinates[8] = coordinates[11] = 0;
+
+        auto integer = [&](int i) {
+            return Vector3L(coordinates[i], coordinates[i + 1], coordinates[i + 2]);
+        };
+        auto real = [&](int i) {
+            return Vector3D(double(coordinates[i]), double(coordinates[i + 1]), double(coordinates[i + 2]));
+        };
+
+        const Segment3L first  (integer(0), integer(3));
+        const Segment3L second (integer(6), integer(9));
+        const Segment3D firstD (real(0), real(3));
+        const Segment3D secondD(real(6), real(9));
+
+        const Vector3Rational<std::int64_t> rational = first.IntersectionRational(second);
+        const Vector3D exact = firstD.IntersectionExact(secondD);
+        hits += rational.IsValid();
+        if (rational.IsValid() != exact.IsValid()) {
+            ++mismatches;
+            continue;
+        }
+        if (!rational.IsValid())
+            continue;
+
+        const Vector3D point = rational.ToVector<double>();
+        const double tolerance = 1e-12 * double(factor);
+        mismatches += std::abs(point.X - exact.X) > tolerance ||
+            std::abs(point.Y - exact.Y) > tolerance ||
+            std::abs(point.Z - exact.Z) > tolerance;
+    }
+    Check(hits != 0, "IntersectionRational test set has hits");
+    Check(mismatches == 0, "IntersectionRational matches IntersectionExact on lattice input");
+
+    // Segments spanning almost all of int64 cross in a fraction
+    const std::int64_t big = std::int64_t(1) << 62;
+    const Segment3L across({ -big, 0, 0 }, { big - 1, 0, 0 });
+    const Segment3L steep ({ 1, -big, 0 }, { 4, big - 1, 0 });
+    const Vector3Rational<std::int64_t> point = across.IntersectionRational(steep);
+    Check(point.IsValid() && !point.IsInteger() && point.Y.Sign() == 0 && point.Z.Sign() == 0,
+        "IntersectionRational crosses segments near +-2^62");
+    Check(std::abs(point.ToVector<double>().X - 2.5) < 1e-12, "IntersectionRational point near +-2^62");
+}
+
+//---------------------------------------------------------------------------------------
+// Reader over a vector, the interface of Segment3Reader
+struct VectorReader
+{
+    const std::vector<Segment3D>& Source;
+    std::size_t                   Next = 0;
+
+    std::size_t Read(Segment3D* segments, std::size_t count)
+    {
+        count = std::min(count, Source.size() - Next);
+        std::copy(Source.begin() + Next, Source.begin() + Next + count, segments);
+        Next += count;
+        return count;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+// A pipeline reused for several runs, with chunks left in its queues by a
+// short run, emits the hits of the sequential loop every time
+static void TestPipelineReuse()
+{
+    std::mt19937 engine(22);
+    std::uniform_int_distribution<int> lattice(0, 4);
+    std::vector<Segment3D> segments;
+    for (int i = 0; i < 2001; ++i)
+        segments.push_back(Segment3D(
+            { double(lattice(engine)), double(lattice(engine)), 0 },
+            { double(lattice(engine)), double(lattice(engine)), 0 }
+        ));
+
+    Segment3PipelineD pipeline(64, 3);
+    std::size_t mismatches = 0;
+    for (const std::size_t count : { std::size_t(2001), std::size_t(10), std::size_t(2001), std::size_t(0), std::size_t(1000) }) {
+        const std::vector<Segment3D> input(segments.begin(), segments.begin() + count);
+        VectorReader reader = { input };
+
+        std::vector<Segment3Hit<double>> hits;
+        pipeline.Pairs(reader, [&hits](std::size_t pair, const Vector3D& point) {
+            hits.push_back({ 2 * pair, 2 * pair + 1, point });
+        });
+
+        std::vector<Segment3Hit<double>> expected;
+        for (std::size_t i = 0; i + 1 < count; i += 2) {
+            const Vector3D point = input[i].Intersection(input[i + 1]);
+            if (point.IsValid())
+                expected.push_back({ i, i + 1, point });
+        }
+
+        mismatches += !SameHits(hits, expected) || pipeline.Segments() != count;
+    }
+    Check(mismatches == 0, "reused Segment3Pipeline matches the sequential loop on every run");
+}
+
+//---------------------------------------------------------------------------------------
+// Hits restored from curve order are hits of the input order with its points,
+// also for pairs whose Intersection is a hit one way round only
+static void TestRestoreInputOrder()
+{
+    std::vector<Segment3D> segments = {
+        Segment3D({ 3, 5, 4 }, { 3, 3, 6 }),
+        Segment3D({ 0, 6, 3 }, { 6, 3, 6 }),
+    };
+    Check(!segments[0].Intersection(segments[1]).IsValid() && segments[1].Intersection(segments[0]).IsValid(),
+        "Intersection of the Restore test pair is not symmetric");
+
+    std::mt19937 engine(18);
+    std::uniform_int_distribution<int> coordinate(0, 8);
+    for (int i = 0; i < 400; ++i)
+        segments.push_back(Segment3D(
+            { double(coordinate(engine)), double(coordinate(engine)), double(coordinate(engine)) },
+            { double(coordinate(engine)), double(coordinate(engine)), double(coordinate(engine)) }
+        ));
+
+    // Both orders of the asymmetric pair, so one of them flips in curve order
+    for (int pass = 0; pass < 2; ++pass) {
+        std::swap(segments[0], segments[1]);
+
+        const Segment3SpatialOrderD order(segments.data(), segments.size());
+        const Segment3D* sorted = order.Segments();
+
+        std::vector<Segment3Hit<double>> hits;
+        for (std::size_t i = 0; i < segments.size(); ++i)
+            for (std::size_t j = i + 1; j < segments.size(); ++j) {
+                const Vector3D point = sorted[i].Intersection(sorted[j]);
+                if (point.IsValid())
+                    hits.push_back({ i, j, point });
+            }
+
+        order.Restore(hits);
+
+        std::size_t mismatches = 0;
+        for (const Segment3Hit<double>& hit : hits)
+            mismatches += !(hit.First < hit.Second) ||
+                !(segments[hit.First].Intersection(segments[hit.Second]) == hit.Point);
+        Check(mismatches == 0, "Restore gives the hits and points of the input order");
+    }
+}
+
+#ifndef _WIN32
+//---------------------------------------------------------------------------------------
+// Raw connection to the server, for requests Segment3Client does not send
+static int ConnectRaw
+(
+    const char* path
+)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path);
+
+    const int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket >= 0 && ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(socket);
+        return -1;
+    }
+
+    return socket;
+}
+
+//---------------------------------------------------------------------------------------
+// A client stalled in the middle of its header does not hold up the others,
+// and a request above MaxRequestBytes is refused before anything is allocated
+static void TestServerStalledClient()
+{
+    const char* path = "Tests.sock";
+    const std::vector<Segment3D> segments = {
+        Segment3D({ 0, 0, 0 }, { 2, 2, 0 }),
+        Segment3D({ 0, 2, 0 }, { 2, 0, 0 }),
+    };
+
+    Segment3Server server(segments.data(), segments.size());
+    Check(server.Listen(path), "server listens");
+    std::thread serving([&server] { server.Serve(); });
+
+    const int stalled = ConnectRaw(path);
+    const Segment3RequestHeader header = {
+        Segment3RequestHeader::Signature,
+        static_cast<std::uint32_t>(Segment3RequestKind::Pairs),
+        Segment3Server::MaxRequestBytes / (2 * sizeof(Segment3D)) + 1
+    };
+    Check(stalled >= 0 && Segment3Server::WriteAll(stalled, &header, sizeof(header) / 2),
+        "stalled client sends half a header");
+
+    Segment3Client client;
+    std::vector<Vector3D> points;
+    Check(client.Connect(path), "client connects next to a stalled one");
+    Check(client.Pairs(&segments[0], &segments[1], 1, points) && points.size() == 1 && points[0] == Vector3D(1, 1, 0),
+        "client is served while another one stalls");
+
+    Segment3ResponseHeader response = {};
+    Check(Segment3Server::WriteAll(stalled, reinterpret_cast<const char*>(&header) + sizeof(header) / 2, sizeof(header) / 2) &&
+        Segment3Server::ReadAll(stalled, &response, sizeof(response)) && response.Status == 1,
+        "Pairs request above MaxRequestBytes is refused");
+
+    Check(client.Stop(), "server stops");
+    serving.join();
+    ::close(stalled);
+}
+#endif // _WIN32
+
+//---------------------------------------------------------------------------------------
+int main()
+{
+    TestBVHWithoutBoxes();
+    TestBVHCachedNarrowPhase();
+    TestFileType();
+    TestResultMatchesIntersection();
+    TestBatchMatchesIntersection<float>("Segment3BatchF matches Segment3F::Intersection");
+    TestBatchMatchesIntersection<double>("Segment3BatchD matches Segment3D::Intersection");
+    TestMixedMatchesDouble();
+    TestRestoreInputOrder();
+    TestPlaneSweepMatchesBruteForce();
+    TestDynamicBVHMatchesBruteForce();
+    TestWideIntegerExtremes();
+    TestRationalMatchesExact();
+    TestPipelineReuse();
+#ifndef _WIN32
+    TestServerStalledClient();
+#endif // _WIN32
+
+    if (Failures != 0)
+        std::cerr << Failures << " checks failed\n";
+    else
+        std::cout << "All checks passed\n";
+
+    return Failures;
+}